@@ -120,6 +120,37 @@ scandepot(void)
   return queue;
 }
 
+/*
+ * Look up the parts of the same package as refi in the depot.
+ *
+ * As the part names are derived from the fields partmatches() checks, we
+ * can open them directly by name, instead of going through every file in
+ * the depot, which might contain parts from many other packages.
+ */
+static void
+lookupdepot(struct partinfo **partlist, struct partinfo *refi)
+{
+  unsigned int i;
+
+  for (i = 0; i < refi->maxpartn; i++) {
+    struct partinfo *pi;
+    char *filename;
+
+    filename = str_fmt("%s/%s.%jx.%x.%x", opt_depotdir, refi->md5sum,
+                       (intmax_t)refi->maxpartlen, i + 1, refi->maxpartn);
+    if (access(filename, F_OK) < 0) {
+      if (errno != ENOENT)
+        ohshite(_("unable to stat '%.250s'"), filename);
+      free(filename);
+      continue;
+    }
+
+    pi = nfmalloc(sizeof(struct partinfo));
+    mustgetpartinfo(filename, pi);
+    addtopartlist(partlist, pi, refi);
+  }
+}
+
 static bool
 partmatches(struct partinfo *pi, struct partinfo *refi)
 {
@@ -134,8 +165,6 @@ do_auto(const char *const *argv)
 {
   const char *partfile;
   struct partinfo *refi, **partlist, *otherthispart;
-  struct partqueue *queue;
-  struct partqueue *pq;
   unsigned int i;
   int j;
   FILE *part;
@@ -158,18 +187,10 @@ do_auto(const char *const *argv)
   }
   fclose(part);
 
-  queue = scandepot();
   partlist= nfmalloc(sizeof(struct partinfo*)*refi->maxpartn);
   for (i = 0; i < refi->maxpartn; i++)
     partlist[i] = NULL;
-  for (pq= queue; pq; pq= pq->nextinqueue) {
-    struct partinfo *npi, *pi = &pq->info;
-
-    if (!partmatches(pi,refi)) continue;
-    npi= nfmalloc(sizeof(struct partinfo));
-    mustgetpartinfo(pi->filename,npi);
-    addtopartlist(partlist,npi,refi);
-  }
+  lookupdepot(partlist, refi);
   /* If we already have a copy of this version we ignore it and prefer the
    * new one, but we still want to delete the one in the depot, so we
    * save its partinfo (with the filename) for later. This also prevents
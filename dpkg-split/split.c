@@ -51,13 +51,14 @@
 #include "dpkg-split.h"
 
 /**
- * Parse the control file from a .deb package into a struct pkginfo.
+ * Start extracting the control file from a .deb package.
+ *
+ * The extraction runs in the background, so that the caller can do other
+ * work meanwhile, and then get the result with deb_parse_control().
  */
-static struct pkginfo *
-deb_parse_control(const char *filename)
+static pid_t
+deb_extract_control(const char *filename, int *fd)
 {
-	struct parsedb_state *ps;
-	struct pkginfo *pkg;
 	pid_t pid;
 	int p[2];
 
@@ -76,13 +77,27 @@ deb_parse_control(const char *filename)
 	}
 	close(p[1]);
 
+	*fd = p[0];
+
+	return pid;
+}
+
+/**
+ * Parse the control file from a .deb package into a struct pkginfo.
+ */
+static struct pkginfo *
+deb_parse_control(pid_t pid, int fd)
+{
+	struct parsedb_state *ps;
+	struct pkginfo *pkg;
+
 	/* Parent reads from pipe. */
-	ps = parsedb_new(_("<dpkg-deb --info pipe>"), p[0], pdb_parse_binary);
+	ps = parsedb_new(_("<dpkg-deb --info pipe>"), fd, pdb_parse_binary);
 	parsedb_load(ps);
 	parsedb_parse(ps, &pkg);
 	parsedb_close(ps);
 
-	close(p[0]);
+	close(fd);
 
 	subproc_reap(pid, _("package field value extraction"), SUBPROC_NOPIPE);
 
@@ -115,7 +130,8 @@ mksplit(const char *file_src, const char *prefix, off_t maxpartsize,
 {
 	struct pkginfo *pkg;
 	struct dpkg_error err;
-	int fd_src;
+	int fd_src, fd_control;
+	pid_t pid_control;
 	struct stat st;
 	const char *version;
 	char hash[MD5HASHLEN + 1];
@@ -135,12 +151,15 @@ mksplit(const char *file_src, const char *prefix, off_t maxpartsize,
 	if (!S_ISREG(st.st_mode))
 		ohshit(_("source file '%.250s' not a plain file"), file_src);
 
+	/* Let the control file get extracted while we hash the package. */
+	pid_control = deb_extract_control(file_src, &fd_control);
+
 	if (fd_md5(fd_src, hash, -1, &err) < 0)
 		ohshit(_("cannot compute MD5 hash for file '%s': %s"),
 		       file_src, err.str);
 	lseek(fd_src, 0, SEEK_SET);
 
-	pkg  = deb_parse_control(file_src);
+	pkg = deb_parse_control(pid_control, fd_control);
 	version = versiondescribe(&pkg->available.version, vdew_always);
 
 	partsize = maxpartsize - HEADERALLOWANCE;
@@ -32,6 +32,7 @@
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/pkg.h>
 #include <dpkg/string.h>
 
 #include "dselect.h"
@@ -463,7 +464,7 @@ perpackagestate::free(bool recursive)
         assert(!recursive);
         if (pkg->want != selected &&
             !(pkg->want == PKG_WANT_UNKNOWN && selected == PKG_WANT_PURGE)) {
-          pkg->want= selected;
+          pkg_set_want(pkg, selected);
         }
         pkg->clientdata = nullptr;
       }
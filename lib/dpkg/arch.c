@@ -108,14 +108,21 @@ static struct dpkg_arch *arch_head = &arch_item_native;
 static struct dpkg_arch *arch_builtin_tail = &arch_item_any;
 static bool arch_list_dirty;
 
+/* The architectures are shared by all the package databases, so they
+ * cannot be allocated from the selected one. */
+static struct nfarena *arch_arena;
+
 static struct dpkg_arch *
 dpkg_arch_new(const char *name, enum dpkg_arch_type type)
 {
 	struct dpkg_arch *new;
 
-	new = nfmalloc(sizeof(*new));
+	if (arch_arena == NULL)
+		arch_arena = nfarena_new("arch");
+
+	new = nfarena_alloc(arch_arena, sizeof(*new));
 	new->next = NULL;
-	new->name = nfstrsave(name);
+	new->name = nfarena_strsave(arch_arena, name);
 	new->type = type;
 
 	return new;
@@ -204,14 +211,16 @@ dpkg_arch_get_list(void)
 /**
  * Reset the list of architectures.
  *
- * Must be called before nffreeall() to ensure we don't point to
- * unallocated memory.
+ * Must only be called when nothing refers anymore to the architectures
+ * not built-in, such as when resetting the package database.
  */
 void
 dpkg_arch_reset_list(void)
 {
 	arch_builtin_tail->next = NULL;
 	arch_list_dirty = false;
+	if (arch_arena)
+		nfarena_reset(arch_arena);
 }
 
 void
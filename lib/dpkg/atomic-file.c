@@ -30,6 +30,7 @@
 
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
+#include <dpkg/perf.h>
 #include <dpkg/atomic-file.h>
 
 #define ATOMIC_FILE_NEW_EXT "-new"
@@ -68,6 +69,7 @@ atomic_file_sync(struct atomic_file *file)
 		ohshite(_("unable to write new file '%.250s'"), file->name_new);
 	if (fflush(file->fp))
 		ohshite(_("unable to flush new file '%.250s'"), file->name_new);
+	perf_count("fsync", 1);
 	if (fsync(fileno(file->fp)))
 		ohshite(_("unable to sync new file '%.250s'"), file->name_new);
 }
@@ -111,6 +113,7 @@ atomic_file_commit(struct atomic_file *file)
 	if (file->flags & ATOMIC_FILE_BACKUP)
 		atomic_file_backup(file);
 
+	perf_count("rename", 1);
 	if (rename(file->name_new, file->name))
 		ohshite(_("error installing new file '%s'"), file->name);
 }
@@ -0,0 +1,176 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * bench.h - benchmark suite support
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBDPKG_BENCH_H
+#define LIBDPKG_BENCH_H
+
+#include <sys/time.h>
+
+#include <time.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifndef BENCH_MAIN_PROVIDED
+#include <dpkg/ehandle.h>
+#endif
+
+/**
+ * @defgroup dpkg_bench Benchmark suite support
+ * @ingroup dpkg-internal
+ * @{
+ */
+
+#define bench_bail(reason) \
+	do { \
+		printf("Bail out! %s\n", (reason)); \
+		exit(255); \
+	} while (0)
+
+/*
+ * The allocations are counted by interposing the malloc family, which is
+ * only possible when we know how to call into the real allocator.
+ */
+#ifdef __GLIBC__
+#define BENCH_HAVE_ALLOC_COUNT 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+#endif
+
+static size_t bench_allocs;
+static size_t bench_alloc_bytes;
+
+#ifdef BENCH_HAVE_ALLOC_COUNT
+void *
+malloc(size_t size)
+{
+	bench_allocs++;
+	bench_alloc_bytes += size;
+
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	bench_allocs++;
+	bench_alloc_bytes += nmemb * size;
+
+	return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	bench_allocs++;
+	bench_alloc_bytes += size;
+
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+struct bench {
+	const char *name;
+	struct timespec start;
+	size_t allocs;
+	size_t alloc_bytes;
+};
+
+static inline long
+bench_param(const char *name, long defval)
+{
+	const char *str;
+	char *endp;
+	long val;
+
+	str = getenv(name);
+	if (str == NULL || str[0] == '\0')
+		return defval;
+
+	val = strtol(str, &endp, 10);
+	if (*endp != '\0' || val <= 0)
+		bench_bail("invalid benchmark parameter value");
+
+	return val;
+}
+
+static inline void
+bench_start(struct bench *b, const char *name)
+{
+	b->name = name;
+	b->allocs = bench_allocs;
+	b->alloc_bytes = bench_alloc_bytes;
+	clock_gettime(CLOCK_MONOTONIC, &b->start);
+}
+
+/**
+ * Stop the benchmark, and report on it.
+ *
+ * The ops are the number of operations done, which are used to compute
+ * the throughput and the allocations per operation, and the bytes are
+ * the amount of data processed, or 0 if that does not make sense.
+ */
+static inline void
+bench_stop(struct bench *b, long ops, long long bytes)
+{
+	struct timespec end;
+	double elapsed;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	elapsed = (end.tv_sec - b->start.tv_sec) +
+	          (end.tv_nsec - b->start.tv_nsec) / 1e9;
+	if (elapsed <= 0)
+		elapsed = 1e-9;
+	if (ops <= 0)
+		ops = 1;
+
+	printf("%s: ops=%ld time=%.3fs ops/s=%.1f", b->name, ops, elapsed,
+	       ops / elapsed);
+	if (bytes > 0)
+		printf(" MiB/s=%.1f", bytes / elapsed / (1024 * 1024));
+#ifdef BENCH_HAVE_ALLOC_COUNT
+	printf(" allocs/op=%.2f bytes/op=%.0f",
+	       (double)(bench_allocs - b->allocs) / ops,
+	       (double)(bench_alloc_bytes - b->alloc_bytes) / ops);
+#endif
+	printf("\n");
+}
+
+/** @} */
+
+#ifndef BENCH_MAIN_PROVIDED
+static void bench(void);
+
+int
+main(int argc, char **argv)
+{
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	push_error_context();
+
+	bench();
+
+	pop_error_context(ehflag_normaltidy);
+
+	return 0;
+}
+#endif
+
+#endif
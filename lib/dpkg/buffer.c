@@ -24,8 +24,12 @@
 #include <compat.h>
 
 #include <sys/types.h>
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
 
 #include <errno.h>
+#include <limits.h>
 #include <md5.h>
 #include <string.h>
 #include <unistd.h>
@@ -231,6 +235,40 @@ buffer_copy(struct buffer_data *read_data,
 	return totalread;
 }
 
+#if defined(SYS_copy_file_range) && defined(__linux__)
+/*
+ * Copy data between two file descriptors inside the kernel, so that it does
+ * not need to go through a userland buffer, and can even end up sharing the
+ * extents on file systems supporting it.
+ *
+ * This stops at the first error, or at end of file when nothing has been
+ * copied (as some pseudo-files report their size as zero), and returns the
+ * amount of data copied so far, so that the caller can copy the rest with
+ * the generic code, which will take care of any error reporting.
+ */
+static off_t
+buffer_copy_range(int fd_in, int fd_out, off_t limit)
+{
+	off_t total = 0;
+
+	while (limit == -1 || total < limit) {
+		size_t len = SSIZE_MAX & ~(size_t)0xfffff;
+		ssize_t n;
+
+		if (limit != -1 && (off_t)len > limit - total)
+			len = limit - total;
+
+		n = syscall(SYS_copy_file_range, fd_in, NULL, fd_out, NULL, len, 0);
+		if (n <= 0)
+			break;
+
+		total += n;
+	}
+
+	return total;
+}
+#endif
+
 off_t
 buffer_copy_IntInt(int Iin, int Tin,
                    void *Pdigest, int Tdigest,
@@ -240,8 +278,26 @@ buffer_copy_IntInt(int Iin, int Tin,
 	struct buffer_data read_data = { .type = Tin, .arg.i = Iin };
 	struct buffer_data digest = { .type = Tdigest, .arg.ptr = Pdigest };
 	struct buffer_data write_data = { .type = Tout, .arg.i = Iout };
+	off_t copied = 0;
+	off_t ret;
 
-	return buffer_copy(&read_data, &digest, &write_data, limit, err);
+#if defined(SYS_copy_file_range) && defined(__linux__)
+	if (Tin == BUFFER_READ_FD && Tout == BUFFER_WRITE_FD &&
+	    Tdigest == BUFFER_DIGEST_NULL) {
+		copied = buffer_copy_range(Iin, Iout, limit);
+		if (limit != -1) {
+			if (copied == limit)
+				return copied;
+			limit -= copied;
+		}
+	}
+#endif
+
+	ret = buffer_copy(&read_data, &digest, &write_data, limit, err);
+	if (ret < 0)
+		return ret;
+
+	return copied + ret;
 }
 
 off_t
@@ -43,9 +43,11 @@
 #include <dpkg/c-ctype.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/pkg.h>
 #include <dpkg/file.h>
 #include <dpkg/dir.h>
 #include <dpkg/triglib.h>
+#include <dpkg/perf.h>
 
 static bool db_initialized;
 
@@ -76,11 +78,22 @@ static int ulist_select(const struct dirent *de) {
   return 1;
 }
 
+static enum parsedbflags
+modstatdb_parse_flags(void)
+{
+  if (cstatus == msdbrw_readonly && (cflags & msdbrw_lazy_fields))
+    return pdb_lazy_fields;
+  else
+    return 0;
+}
+
 static void cleanupdates(void) {
   struct dirent **cdlist;
   int cdn, i;
 
-  parsedb(statusfile, pdb_parse_status, NULL);
+  if (cstatus != msdbrw_readonly || !(cflags & msdbrw_snapshot) ||
+      !db_snapshot_load(statusfile))
+    parsedb(statusfile, pdb_parse_status | modstatdb_parse_flags(), NULL);
 
   *updatefnrest = '\0';
   updateslength= -1;
@@ -91,11 +104,11 @@ static void cleanupdates(void) {
   if (cdn) {
     for (i=0; i<cdn; i++) {
       strcpy(updatefnrest, cdlist[i]->d_name);
-      parsedb(updatefnbuf, pdb_parse_update, NULL);
+      parsedb(updatefnbuf, pdb_parse_update | modstatdb_parse_flags(), NULL);
     }
 
     if (cstatus >= msdbrw_write) {
-      writedb(statusfile, wdb_must_sync);
+      writedb(statusfile, wdb_must_sync | wdb_dump_snapshot);
 
       for (i=0; i<cdn; i++) {
         strcpy(updatefnrest, cdlist[i]->d_name);
@@ -283,8 +296,9 @@ modstatdb_open(enum modstatdb_rw readwritereq)
 
   if (cstatus != msdbrw_needsuperuserlockonly) {
     cleanupdates();
-    if (cflags >= msdbrw_available_readonly)
-      parsedb(availablefile, pdb_parse_available, NULL);
+    if (cflags & (msdbrw_available_readonly | msdbrw_available_write))
+      parsedb(availablefile, pdb_parse_available | modstatdb_parse_flags(),
+              NULL);
   }
 
   if (cstatus >= msdbrw_write) {
@@ -305,10 +319,14 @@ modstatdb_get_status(void)
 }
 
 void modstatdb_checkpoint(void) {
+  struct perf_phase *phase;
   int i;
 
   assert(cstatus >= msdbrw_write);
-  writedb(statusfile, wdb_must_sync);
+
+  phase = perf_phase_start("db-checkpoint");
+
+  writedb(statusfile, wdb_must_sync | wdb_dump_snapshot);
 
   for (i=0; i<nextupdate; i++) {
     sprintf(updatefnrest, IMPORTANTFMT, i);
@@ -321,10 +339,12 @@ void modstatdb_checkpoint(void) {
   dir_sync_path(updatesdir);
 
   nextupdate= 0;
+
+  perf_phase_stop(phase);
 }
 
 void modstatdb_shutdown(void) {
-  if (cflags >= msdbrw_available_write)
+  if (cflags & msdbrw_available_write)
     writedb(availablefile, wdb_dump_available);
 
   switch (cstatus) {
@@ -361,6 +381,7 @@ modstatdb_note_core(struct pkginfo *pkg)
   if (ftruncate(fileno(importanttmp), uvb.used))
     ohshite(_("unable to truncate for updated status of '%.250s'"),
             pkg_name(pkg, pnaw_nonambig));
+  perf_count("fsync", 1);
   if (fsync(fileno(importanttmp)))
     ohshite(_("unable to fsync updated status of '%.250s'"),
             pkg_name(pkg, pnaw_nonambig));
@@ -368,6 +389,7 @@ modstatdb_note_core(struct pkginfo *pkg)
     ohshite(_("unable to close updated status of '%.250s'"),
             pkg_name(pkg, pnaw_nonambig));
   sprintf(updatefnrest, IMPORTANTFMT, nextupdate);
+  perf_count("rename", 1);
   if (rename(importanttmpfile, updatefnbuf))
     ohshite(_("unable to install updated status of '%.250s'"),
             pkg_name(pkg, pnaw_nonambig));
@@ -399,6 +421,8 @@ void modstatdb_note(struct pkginfo *pkg) {
 
   onerr_abort++;
 
+  pkg_invalidate_stanza(pkg);
+
   /* Clear pending triggers here so that only code that sets the status
    * to interesting (for triggers) values has to care about triggers. */
   if (pkg->status != PKG_STAT_TRIGGERSPENDING &&
@@ -0,0 +1,545 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * dbsnapshot.c - binary snapshot of the status database
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef USE_MMAP
+#include <sys/mman.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <dpkg/i18n.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/string.h>
+#include <dpkg/arch.h>
+#include <dpkg/pkg.h>
+#include <dpkg/debug.h>
+#include <dpkg/fdio.h>
+#include <dpkg/file.h>
+#include <dpkg/varbuf.h>
+#include <dpkg/perf.h>
+#include <dpkg/parsedump.h>
+
+/*
+ * The status snapshot is a native endian binary image of the package names,
+ * architectures, versions and states in the status file, written next to it
+ * by writedb(), so that read-only consumers only needing those can load the
+ * database without any parsing. Each entry also records where the package
+ * stanza is in the status file, which gets parsed instead for the packages
+ * with state not represented in the snapshot, such as pending triggers.
+ * The names only referenced by dependencies are recorded too, as parsing
+ * the status file would make them known.
+ *
+ * It records the identity of the status file it got written with, and is
+ * ignored whenever they do not match, as the latter is the authoritative
+ * source, and might have been modified by something else.
+ */
+
+#define DB_SNAPSHOT_MAGIC	0x64736e70
+#define DB_SNAPSHOT_VERSION	2
+
+struct db_snapshot_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t file_ino;
+	uint64_t file_size;
+	int64_t file_mtime;
+	int64_t file_mtime_nsec;
+	uint32_t nentries;
+	uint32_t strings_size;
+};
+
+enum db_snapshot_entry_flags {
+	/** The package has no architecture, not even an empty one. */
+	DB_SNAPSHOT_ARCH_NONE	= DPKG_BIT(0),
+	/** The package stanza needs to be parsed from the status file. */
+	DB_SNAPSHOT_PARSE	= DPKG_BIT(1),
+	/** The entry is only a name referenced by some dependency. */
+	DB_SNAPSHOT_REFERENCE	= DPKG_BIT(2),
+};
+
+struct db_snapshot_entry {
+	/* The stanza location in the status file. */
+	uint64_t stanza_offset;
+	uint64_t stanza_size;
+	/* Offsets into the string table. */
+	uint32_t name;
+	uint32_t arch;
+	uint32_t version;
+	uint32_t revision;
+	/* Offset to the version comparison key, or 0 if there is none. */
+	uint32_t version_key;
+	uint32_t epoch;
+	uint32_t flags;
+	uint8_t want;
+	uint8_t eflag;
+	uint8_t status;
+	uint8_t multiarch;
+};
+
+struct db_snapshot {
+	struct varbuf entries;
+	struct varbuf strings;
+	uint32_t nentries;
+};
+
+/* The fields that can be shown from a package loaded from the snapshot. */
+static const char *const db_snapshot_fields[] = {
+	"Package",
+	"Architecture",
+	"Multi-Arch",
+	"Version",
+	"Status",
+	"binary:Package",
+	"db:Status-Abbrev",
+	"db:Status-Want",
+	"db:Status-Status",
+	"db:Status-Eflag",
+	NULL,
+};
+
+/**
+ * Check whether a field is available for packages loaded from a snapshot.
+ *
+ * @param fieldname The field name, including the virtual ones.
+ */
+bool
+db_snapshot_has_field(const char *fieldname)
+{
+	const char *const *field;
+
+	for (field = db_snapshot_fields; *field; field++)
+		if (strcasecmp(fieldname, *field) == 0)
+			return true;
+
+	return false;
+}
+
+static char *
+db_snapshot_get_filename(const char *filename)
+{
+	return str_fmt("%s%s", filename, DBSNAPSHOTEXT);
+}
+
+struct db_snapshot *
+db_snapshot_new(void)
+{
+	struct db_snapshot *snap;
+
+	snap = m_malloc(sizeof(*snap));
+	varbuf_init(&snap->entries, 0);
+	varbuf_init(&snap->strings, 0);
+	snap->nentries = 0;
+
+	/* Keep the offset 0 for the empty string. */
+	varbuf_add_char(&snap->strings, '\0');
+
+	return snap;
+}
+
+void
+db_snapshot_free(struct db_snapshot *snap)
+{
+	varbuf_destroy(&snap->entries);
+	varbuf_destroy(&snap->strings);
+	free(snap);
+}
+
+static uint32_t
+db_snapshot_add_str(struct db_snapshot *snap, const char *str)
+{
+	uint32_t offset;
+
+	if (str == NULL || str[0] == '\0')
+		return 0;
+
+	offset = snap->strings.used;
+	varbuf_add_str(&snap->strings, str);
+	varbuf_add_char(&snap->strings, '\0');
+
+	return offset;
+}
+
+/**
+ * Add a package to the snapshot being built.
+ *
+ * @param snap The snapshot.
+ * @param pkg The package.
+ * @param offset The offset of the package stanza in the status file.
+ * @param size The size of the package stanza.
+ */
+void
+db_snapshot_add(struct db_snapshot *snap, struct pkginfo *pkg,
+                off_t offset, size_t size)
+{
+	struct db_snapshot_entry entry;
+	struct pkgbin *pkgbin = &pkg->installed;
+
+	memset(&entry, 0, sizeof(entry));
+	entry.stanza_offset = offset;
+	entry.stanza_size = size;
+	entry.name = db_snapshot_add_str(snap, pkg->set->name);
+	if (pkgbin->arch->type == DPKG_ARCH_NONE)
+		entry.flags |= DB_SNAPSHOT_ARCH_NONE;
+	else
+		entry.arch = db_snapshot_add_str(snap, pkgbin->arch->name);
+	entry.epoch = pkgbin->version.epoch;
+	entry.version = db_snapshot_add_str(snap, pkgbin->version.version);
+	entry.revision = db_snapshot_add_str(snap, pkgbin->version.revision);
+	entry.version_key = db_snapshot_add_str(snap, pkgbin->version.key);
+	entry.want = pkg->want;
+	entry.eflag = pkg->eflag;
+	entry.status = pkg->status;
+	entry.multiarch = pkgbin->multiarch;
+
+	/* The trigger states link packages together, so leave them to the
+	 * parser. */
+	if (pkg->trigpend_head || pkg->trigaw.head)
+		entry.flags |= DB_SNAPSHOT_PARSE;
+
+	varbuf_add_buf(&snap->entries, &entry, sizeof(entry));
+	snap->nentries++;
+}
+
+/*
+ * Check whether a package set without any entry of its own is referenced
+ * by a dependency from a package written to the status file.
+ */
+static bool
+db_snapshot_set_is_referenced(struct pkgset *set)
+{
+	struct pkginfo *pkg;
+	struct deppossi *dop;
+
+	for (pkg = &set->pkg; pkg; pkg = pkg->arch_next)
+		if (pkg_is_informative(pkg, &pkg->installed))
+			return false;
+
+	for (dop = set->depended.installed; dop; dop = dop->rev_next) {
+		pkg = dop->up->up;
+		if (pkg_is_informative(pkg, &pkg->installed))
+			return true;
+	}
+
+	return false;
+}
+
+static void
+db_snapshot_add_references(struct db_snapshot *snap)
+{
+	struct pkgiterator *iter;
+	struct pkgset *set;
+
+	iter = pkg_db_iter_new();
+	while ((set = pkg_db_iter_next_set(iter))) {
+		struct db_snapshot_entry entry;
+
+		if (!db_snapshot_set_is_referenced(set))
+			continue;
+
+		memset(&entry, 0, sizeof(entry));
+		entry.name = db_snapshot_add_str(snap, set->name);
+		entry.flags = DB_SNAPSHOT_REFERENCE;
+
+		varbuf_add_buf(&snap->entries, &entry, sizeof(entry));
+		snap->nentries++;
+	}
+	pkg_db_iter_free(iter);
+}
+
+static bool
+db_snapshot_write_file(struct db_snapshot *snap,
+                       const struct db_snapshot_header *hdr,
+                       const char *snapfile, enum writedb_flags flags)
+{
+	int fd, e;
+
+	fd = open(snapfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+
+	if (fd_write(fd, hdr, sizeof(*hdr)) < 0 ||
+	    fd_write(fd, snap->entries.buf, snap->entries.used) < 0 ||
+	    fd_write(fd, snap->strings.buf, snap->strings.used) < 0)
+		goto fail;
+
+	if (flags & wdb_must_sync) {
+		perf_count("fsync", 1);
+		if (fsync(fd) < 0)
+			goto fail;
+	}
+
+	return close(fd) == 0;
+
+fail:
+	e = errno;
+	close(fd);
+	errno = e;
+
+	return false;
+}
+
+/**
+ * Write the snapshot for a just written status file.
+ *
+ * The snapshot is only a cache, so any error while writing it is not
+ * fatal, and it just gets removed, to be ignored by the readers.
+ *
+ * @param snap The snapshot.
+ * @param filename The status file the snapshot is for.
+ * @param flags The writedb() flags used to write the status file.
+ */
+void
+db_snapshot_write(struct db_snapshot *snap, const char *filename,
+                  enum writedb_flags flags)
+{
+	struct db_snapshot_header hdr;
+	struct stat st;
+	struct timespec mtime;
+	char *snapfile, *snapfile_new;
+
+	snapfile = db_snapshot_get_filename(filename);
+	snapfile_new = str_fmt("%s%s", snapfile, DPKGNEWEXT);
+
+	if (stat(filename, &st) < 0)
+		goto fail;
+	file_stat_mtime(&st, &mtime);
+
+	db_snapshot_add_references(snap);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = DB_SNAPSHOT_MAGIC;
+	hdr.version = DB_SNAPSHOT_VERSION;
+	hdr.file_ino = st.st_ino;
+	hdr.file_size = st.st_size;
+	hdr.file_mtime = mtime.tv_sec;
+	hdr.file_mtime_nsec = mtime.tv_nsec;
+	hdr.nentries = snap->nentries;
+	hdr.strings_size = snap->strings.used;
+
+	if (!db_snapshot_write_file(snap, &hdr, snapfile_new, flags))
+		goto fail;
+
+	perf_count("rename", 1);
+	if (rename(snapfile_new, snapfile) < 0)
+		goto fail;
+
+	free(snapfile_new);
+	free(snapfile);
+
+	return;
+
+fail:
+	warning(_("unable to write status database snapshot '%.250s': %s"),
+	        snapfile, strerror(errno));
+	unlink(snapfile_new);
+	unlink(snapfile);
+
+	free(snapfile_new);
+	free(snapfile);
+}
+
+static const char *
+db_snapshot_get_str(const char *strings, uint32_t offset)
+{
+	if (offset == 0)
+		return "";
+
+	return nfstrsave(strings + offset);
+}
+
+static void
+db_snapshot_load_entry(const struct db_snapshot_entry *entry,
+                       const char *strings)
+{
+	struct dpkg_arch *arch;
+	struct pkginfo *pkg;
+	struct pkgbin *pkgbin;
+
+	if (entry->flags & DB_SNAPSHOT_ARCH_NONE)
+		arch = dpkg_arch_get(DPKG_ARCH_NONE);
+	else
+		arch = dpkg_arch_find(strings + entry->arch);
+
+	pkg = pkg_db_find_pkg(strings + entry->name, arch);
+	pkgbin = &pkg->installed;
+
+	pkgbin->arch = arch;
+	pkgbin->multiarch = entry->multiarch;
+	pkgbin->version.epoch = entry->epoch;
+	pkgbin->version.version = db_snapshot_get_str(strings, entry->version);
+	pkgbin->version.revision = db_snapshot_get_str(strings, entry->revision);
+	if (entry->version_key)
+		pkgbin->version.key = nfstrsave(strings + entry->version_key);
+	else
+		pkgbin->version.key = NULL;
+
+	pkg_set_want(pkg, entry->want);
+	pkg_reset_eflags(pkg);
+	pkg_set_eflags(pkg, entry->eflag);
+	pkg_set_status(pkg, entry->status);
+}
+
+/**
+ * Load the packages from the status file snapshot.
+ *
+ * Only the fields for which db_snapshot_has_field() returns true get
+ * loaded, except for the packages that need to be parsed anyway.
+ *
+ * @param filename The status file the snapshot is for.
+ *
+ * @retval true If the snapshot has been loaded.
+ * @retval false If there is no current snapshot, and nothing got loaded.
+ */
+bool
+db_snapshot_load(const char *filename)
+{
+	const struct db_snapshot_header *hdr;
+	const struct db_snapshot_entry *entries;
+	const char *strings;
+	struct parsedb_state *ps = NULL;
+	struct stat st, st_file;
+	struct timespec mtime;
+	char *snapfile, *data;
+	char *file_endptr = NULL;
+	size_t size;
+	uint32_t i;
+	bool valid = false;
+	int fd;
+
+	snapfile = db_snapshot_get_filename(filename);
+
+	fd = open(snapfile, O_RDONLY);
+	if (fd < 0) {
+		free(snapfile);
+		return false;
+	}
+	if (fstat(fd, &st) < 0)
+		ohshite(_("unable to stat status database snapshot '%.250s'"),
+		        snapfile);
+	if (stat(filename, &st_file) < 0 ||
+	    st.st_size < (off_t)sizeof(*hdr)) {
+		close(fd);
+		free(snapfile);
+		return false;
+	}
+	file_stat_mtime(&st_file, &mtime);
+
+	size = st.st_size;
+#ifdef USE_MMAP
+	data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+		ohshite(_("cannot mmap status database snapshot '%.250s'"),
+		        snapfile);
+#else
+	data = m_malloc(size);
+	if (fd_read(fd, data, size) < 0)
+		ohshite(_("unable to read status database snapshot '%.250s'"),
+		        snapfile);
+#endif
+	close(fd);
+
+	hdr = (const struct db_snapshot_header *)data;
+	entries = (const struct db_snapshot_entry *)(hdr + 1);
+
+	if (hdr->magic != DB_SNAPSHOT_MAGIC ||
+	    hdr->version != DB_SNAPSHOT_VERSION ||
+	    hdr->file_ino != (uint64_t)st_file.st_ino ||
+	    hdr->file_size != (uint64_t)st_file.st_size ||
+	    hdr->file_mtime != (int64_t)mtime.tv_sec ||
+	    hdr->file_mtime_nsec != (int64_t)mtime.tv_nsec ||
+	    hdr->strings_size == 0 ||
+	    size != sizeof(*hdr) + sizeof(*entries) * hdr->nentries +
+	            hdr->strings_size)
+		goto out;
+
+	strings = (const char *)(entries + hdr->nentries);
+	if (strings[hdr->strings_size - 1] != '\0')
+		goto out;
+
+	for (i = 0; i < hdr->nentries; i++) {
+		const struct db_snapshot_entry *entry = &entries[i];
+
+		if (entry->name == 0 ||
+		    entry->name >= hdr->strings_size ||
+		    entry->arch >= hdr->strings_size ||
+		    entry->version >= hdr->strings_size ||
+		    entry->revision >= hdr->strings_size ||
+		    entry->version_key >= hdr->strings_size ||
+		    entry->stanza_offset + entry->stanza_size > hdr->file_size)
+			goto out;
+	}
+
+	for (i = 0; i < hdr->nentries; i++) {
+		const struct db_snapshot_entry *entry = &entries[i];
+
+		if (entry->flags & DB_SNAPSHOT_REFERENCE) {
+			pkg_db_find_set(strings + entry->name);
+			continue;
+		}
+		if (!(entry->flags & DB_SNAPSHOT_PARSE)) {
+			db_snapshot_load_entry(entry, strings);
+			continue;
+		}
+
+		if (ps == NULL) {
+			ps = parsedb_open(filename, pdb_parse_status);
+			parsedb_load(ps);
+			file_endptr = ps->endptr;
+		}
+
+		ps->dataptr = ps->data + entry->stanza_offset;
+		ps->endptr = ps->dataptr + entry->stanza_size;
+		ps->lno = 0;
+		parsedb_parse(ps, NULL);
+	}
+	valid = true;
+
+	if (ps) {
+		ps->endptr = file_endptr;
+		parsedb_close(ps);
+	}
+
+out:
+#ifdef USE_MMAP
+	munmap(data, size);
+#else
+	free(data);
+#endif
+
+	if (valid)
+		debug(dbg_general, "loaded status database snapshot '%s'",
+		      snapfile);
+	else
+		debug(dbg_general, "ignoring stale status database snapshot '%s'",
+		      snapfile);
+
+	free(snapfile);
+
+	return valid;
+}
@@ -32,6 +32,7 @@
 
 #include <dpkg/dpkg.h>
 #include <dpkg/i18n.h>
+#include <dpkg/perf.h>
 #include <dpkg/dir.h>
 
 /**
@@ -50,6 +51,7 @@ dir_sync(DIR *dir, const char *path)
 		ohshite(_("unable to get file descriptor for directory '%s'"),
 		        path);
 
+	perf_count("fsync", 1);
 	if (fsync(fd))
 		ohshite(_("unable to sync directory '%s'"), path);
 }
@@ -107,6 +109,7 @@ dir_file_sync(const char *dir, const char *filename)
 	fd = open(path, O_WRONLY);
 	if (fd < 0)
 		ohshite(_("unable to open file '%s'"), path);
+	perf_count("fsync", 1);
 	if (fsync(fd))
 		ohshite(_("unable to sync file '%s'"), path);
 	if (close(fd))
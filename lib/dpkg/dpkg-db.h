@@ -122,6 +122,8 @@ struct pkgbin {
   struct dpkg_version version;
   struct conffile *conffiles;
   struct arbitraryfield *arbs;
+  /** The fields with their decoding deferred until first needed. */
+  struct lazyfield *lazyfields;
 };
 
 /**
@@ -217,6 +219,11 @@ struct pkginfo {
   /* ->pend == this, non-NULL for us when Triggers-Pending. */
   struct trigaw *othertrigaw_head;
   struct trigpend *trigpend_head;
+
+  /** The status database stanza cached by writedb(), or NULL if it has
+   * to be serialized again, see pkg_invalidate_stanza(). */
+  const char *stanza;
+  size_t stanza_len;
 };
 
 /**
@@ -225,6 +232,8 @@ struct pkginfo {
 struct pkgset {
   struct pkgset *next;
   const char *name;
+  /** The hash of the name, to not have to compute it when rehashing. */
+  unsigned int hash;
   struct pkginfo pkg;
   struct {
     struct deppossi *available;
@@ -252,6 +261,10 @@ enum modstatdb_rw {
   /* Now some optional flags (starting at bit 8): */
   msdbrw_available_readonly	= DPKG_BIT(8),
   msdbrw_available_write	= DPKG_BIT(9),
+  /** Allow loading the status from its snapshot when read-only. */
+  msdbrw_snapshot		= DPKG_BIT(10),
+  /** Defer decoding the dependency fields when read-only. */
+  msdbrw_lazy_fields		= DPKG_BIT(11),
   msdbrw_available_mask		= 0xff00,
 };
 
@@ -277,6 +290,12 @@ void pkg_blank(struct pkginfo *pp);
 void pkgbin_blank(struct pkgbin *pkgbin);
 bool pkg_is_informative(struct pkginfo *pkg, struct pkgbin *info);
 
+struct pkg_db;
+
+struct pkg_db *pkg_db_new(void);
+struct pkg_db *pkg_db_select(struct pkg_db *db);
+void pkg_db_free(struct pkg_db *db);
+
 struct pkgset *pkg_db_find_set(const char *name);
 struct pkginfo *pkg_db_get_singleton(struct pkgset *set);
 struct pkginfo *pkg_db_find_singleton(const char *name);
@@ -316,6 +335,8 @@ enum parsedbflags {
   pdb_close_fd			= DPKG_BIT(7),
   /** Interpret filename ‘-’ as stdin. */
   pdb_dash_is_stdin		= DPKG_BIT(8),
+  /** Defer decoding the dependency fields until first needed. */
+  pdb_lazy_fields		= DPKG_BIT(9),
 
   /* Standard operations. */
 
@@ -335,6 +356,7 @@ const struct arbitraryfield *
 find_arbfield_info(const struct arbitraryfield *arbs, const char *fieldname);
 
 int parsedb(const char *filename, enum parsedbflags, struct pkginfo **donep);
+void pkgbin_decode_fields(struct pkginfo *pkg, struct pkgbin *pkgbin);
 void copy_dependency_links(struct pkginfo *pkg,
                            struct dependency **updateme,
                            struct dependency *newdepends,
@@ -395,6 +417,8 @@ enum writedb_flags {
   wdb_dump_available		= DPKG_BIT(0),
   /** Must sync the written file. */
   wdb_must_sync			= DPKG_BIT(1),
+  /** Write the status snapshot too. */
+  wdb_dump_snapshot		= DPKG_BIT(2),
 };
 
 void writedb(const char *filename, enum writedb_flags flags);
@@ -405,6 +429,19 @@ void varbufrecord(struct varbuf *, const struct pkginfo *,
                   const struct pkgbin *);
 void varbufdependency(struct varbuf *vb, struct dependency *dep);
 
+/*** from dbsnapshot.c ***/
+
+struct db_snapshot;
+
+bool db_snapshot_has_field(const char *fieldname);
+struct db_snapshot *db_snapshot_new(void);
+void db_snapshot_add(struct db_snapshot *snap, struct pkginfo *pkg,
+                     off_t offset, size_t size);
+void db_snapshot_write(struct db_snapshot *snap, const char *filename,
+                       enum writedb_flags flags);
+void db_snapshot_free(struct db_snapshot *snap);
+bool db_snapshot_load(const char *filename);
+
 /*** from depcon.c ***/
 
 bool versionsatisfied(struct pkgbin *it, struct deppossi *against);
@@ -417,6 +454,17 @@ pkg_virtual_deppossi_satisfied(struct deppossi *dependee,
                                struct deppossi *provider);
 
 /*** from nfmalloc.c ***/
+struct nfarena;
+
+struct nfarena *nfarena_new(const char *name);
+void *nfarena_alloc(struct nfarena *arena, size_t size);
+char *nfarena_strsave(struct nfarena *arena, const char *string);
+char *nfarena_strnsave(struct nfarena *arena, const char *string, size_t size);
+void nfarena_report(struct nfarena *arena);
+void nfarena_reset(struct nfarena *arena);
+void nfarena_free(struct nfarena *arena);
+struct nfarena *nfarena_select(struct nfarena *arena);
+
 void *nfmalloc(size_t);
 char *nfstrsave(const char*);
 char *nfstrnsave(const char*, size_t);
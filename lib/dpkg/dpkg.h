@@ -74,14 +74,18 @@ DPKG_BEGIN_DECLS
 #define TRIGGERSCIFILE     "triggers"
 
 #define STATUSFILE        "status"
+#define DBSNAPSHOTEXT     ".snapshot"
 #define AVAILFILE         "available"
 #define LOCKFILE          "lock"
 #define DIVERSIONSFILE    "diversions"
+#define DIVERSIONSLOCKFILE "diversions-lock"
 #define STATOVERRIDEFILE  "statoverride"
+#define STATOVERRIDELOCKFILE "statoverride-lock"
 #define UPDATESDIR        "updates/"
 #define INFODIR           "info"
 #define TRIGGERSDIR       "triggers"
 #define TRIGGERSFILEFILE  "File"
+#define TRIGGERSFILECACHEFILE "File.cache"
 #define TRIGGERSDEFERREDFILE "Unincorp"
 #define TRIGGERSLOCKFILE  "Lock"
 #define CONTROLDIRTMP     "tmp.ci"
@@ -29,9 +29,11 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -337,6 +339,10 @@ w_dependency(struct varbuf *vb,
   struct dependency *dyp;
   bool dep_found = false;
 
+  /* Decode the dependencies on first use, if this was a C++ class these
+   * members would be mutable. */
+  pkgbin_decode_fields((struct pkginfo *)pkg, (struct pkgbin *)pkgbin);
+
   for (dyp = pkgbin->depends; dyp; dyp = dyp->next) {
     if (dyp->type != fip->integer) continue;
     assert(dyp->up == pkg);
@@ -475,10 +481,65 @@ writerecord(FILE *file, const char *filename,
   varbuf_destroy(&vb);
 }
 
+/* The status stanzas get written in batches of this many. */
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define WRITEDB_IOV_MAX IOV_MAX
+#else
+#define WRITEDB_IOV_MAX 1024
+#endif
+
+static void
+writedb_iov(int fd, struct iovec *iov, int iovcnt, const char *filename)
+{
+  while (iovcnt > 0) {
+    ssize_t n;
+
+    n = writev(fd, iov, iovcnt);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      ohshite(_("failed to write %s database to '%.250s'"),
+              "status", filename);
+    }
+
+    /* Skip over what got written, which might stop mid-stanza. */
+    while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = (char *)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+}
+
+/*
+ * Get the status database stanza for the package, which gets serialized
+ * only if the one cached from a previous dump has been invalidated.
+ */
+static const char *
+writedb_get_stanza(struct pkginfo *pkg, struct varbuf *vb, size_t *len)
+{
+  if (pkg->stanza == NULL) {
+    varbuf_reset(vb);
+    varbufrecord(vb, pkg, &pkg->installed);
+    varbuf_add_char(vb, '\n');
+
+    pkg->stanza = nfstrnsave(vb->buf, vb->used);
+    pkg->stanza_len = vb->used;
+  }
+
+  *len = pkg->stanza_len;
+  return pkg->stanza;
+}
+
 void
 writedb(const char *filename, enum writedb_flags flags)
 {
   static char writebuf[8192];
+  static struct iovec iov[WRITEDB_IOV_MAX];
 
   struct pkgiterator *it;
   struct pkginfo *pkg;
@@ -486,6 +547,10 @@ writedb(const char *filename, enum writedb_flags flags)
   const char *which;
   struct atomic_file *file;
   struct varbuf vb = VARBUF_INIT;
+  struct db_snapshot *snap = NULL;
+  off_t offset = 0;
+  size_t size;
+  int iovcnt = 0;
 
   which = (flags & wdb_dump_available) ? "available" : "status";
 
@@ -494,22 +559,43 @@ writedb(const char *filename, enum writedb_flags flags)
   if (setvbuf(file->fp, writebuf, _IOFBF, sizeof(writebuf)))
     ohshite(_("unable to set buffering on %s database file"), which);
 
+  if (flags & wdb_dump_snapshot)
+    snap = db_snapshot_new();
+
   it = pkg_db_iter_new();
   while ((pkg = pkg_db_iter_next_pkg(it)) != NULL) {
     pkgbin = (flags & wdb_dump_available) ? &pkg->available : &pkg->installed;
     /* Don't dump records which have no useful content. */
     if (!pkg_is_informative(pkg, pkgbin))
       continue;
-    varbufrecord(&vb, pkg, pkgbin);
-    varbuf_add_char(&vb, '\n');
-    varbuf_end_str(&vb);
-    if (fputs(vb.buf, file->fp) < 0)
-      ohshite(_("failed to write %s database record about '%.50s' to '%.250s'"),
-              which, pkgbin_name(pkg, pkgbin, pnaw_nonambig), filename);
-    varbuf_reset(&vb);
+
+    if (flags & wdb_dump_available) {
+      varbufrecord(&vb, pkg, pkgbin);
+      varbuf_add_char(&vb, '\n');
+      varbuf_end_str(&vb);
+      if (fputs(vb.buf, file->fp) < 0)
+        ohshite(_("failed to write %s database record about '%.50s' to '%.250s'"),
+                which, pkgbin_name(pkg, pkgbin, pnaw_nonambig), filename);
+      size = vb.used;
+      varbuf_reset(&vb);
+    } else {
+      /* The cached stanzas stay put until the next dump, so they can
+       * be written directly from there. */
+      iov[iovcnt].iov_base = (void *)writedb_get_stanza(pkg, &vb, &size);
+      iov[iovcnt].iov_len = size;
+      if (++iovcnt == WRITEDB_IOV_MAX) {
+        writedb_iov(fileno(file->fp), iov, iovcnt, filename);
+        iovcnt = 0;
+      }
+    }
+
+    if (snap)
+      db_snapshot_add(snap, pkg, offset, size);
+    offset += size;
   }
   pkg_db_iter_free(it);
   varbuf_destroy(&vb);
+  writedb_iov(fileno(file->fp), iov, iovcnt, filename);
   if (flags & wdb_must_sync)
     atomic_file_sync(file);
 
@@ -517,6 +603,11 @@ writedb(const char *filename, enum writedb_flags flags)
   atomic_file_commit(file);
   atomic_file_free(file);
 
+  if (snap) {
+    db_snapshot_write(snap, filename, flags);
+    db_snapshot_free(snap);
+  }
+
   if (flags & wdb_must_sync)
     dir_sync_path_parent(filename);
 }
@@ -284,6 +284,7 @@ f_revision(struct pkginfo *pkg, struct pkgbin *pkgbin,
     pkgbin->version.version = newversion;
   }
   pkgbin->version.revision = nfstrsave(value);
+  dpkg_version_build_key(&pkgbin->version);
 }
 
 void
@@ -61,6 +61,48 @@ file_copy_perms(const char *src, const char *dst)
 		ohshite(_("unable to set mode of target file '%.250s'"), dst);
 }
 
+/**
+ * Get the modification time from a file status.
+ *
+ * The nanoseconds are zero on systems that only track seconds.
+ *
+ * @param st The file status.
+ * @param ts The modification time.
+ */
+void
+file_stat_mtime(const struct stat *st, struct timespec *ts)
+{
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+	*ts = st->st_mtim;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+	*ts = st->st_mtimespec;
+#else
+	ts->tv_sec = st->st_mtime;
+	ts->tv_nsec = 0;
+#endif
+}
+
+/**
+ * Get the status change time from a file status.
+ *
+ * The nanoseconds are zero on systems that only track seconds.
+ *
+ * @param st The file status.
+ * @param ts The status change time.
+ */
+void
+file_stat_ctime(const struct stat *st, struct timespec *ts)
+{
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+	*ts = st->st_ctim;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+	*ts = st->st_ctimespec;
+#else
+	ts->tv_sec = st->st_ctime;
+	ts->tv_nsec = 0;
+#endif
+}
+
 static void
 file_lock_setup(struct flock *fl, short type)
 {
@@ -22,8 +22,10 @@
 #define LIBDPKG_FILE_H
 
 #include <sys/types.h>
+#include <sys/stat.h>
 
 #include <stdbool.h>
+#include <time.h>
 
 #include <dpkg/macros.h>
 
@@ -48,6 +50,9 @@ struct file_stat {
 
 void file_copy_perms(const char *src, const char *dst);
 
+void file_stat_mtime(const struct stat *st, struct timespec *ts);
+void file_stat_ctime(const struct stat *st, struct timespec *ts);
+
 enum file_lock_flags {
 	FILE_LOCK_NOWAIT,
 	FILE_LOCK_WAIT,
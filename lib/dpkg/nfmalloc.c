@@ -1,6 +1,6 @@
 /*
  * libdpkg - Debian packaging suite library routines
- * nfmalloc.c - non-freeing malloc, used for in-core database
+ * nfmalloc.c - non-freeing malloc arenas, used for in-core database
  *
  * Copyright © 1994,1995 Ian Jackson <ijackson@chiark.greenend.org.uk>
  *
@@ -28,46 +28,169 @@
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/debug.h>
 
 #define obstack_chunk_alloc m_malloc
 #define obstack_chunk_free free
 
-static struct obstack db_obs;
-static bool dbobs_init = false;
-
 /* We use lots of mem, so use a large chunk. */
 #define CHUNK_SIZE 8192
 
-#define OBSTACK_INIT if (!dbobs_init) { nfobstack_init(); }
+/*
+ * An arena groups allocations with the same lifetime, so that they can all
+ * be released at once when their scope ends, f.ex. when reloading the data
+ * they were parsed from.
+ */
+struct nfarena {
+  const char *name;
+  struct obstack obs;
+  bool init;
+
+  /* Usage statistics, reported on debug output. */
+  size_t nallocs;
+  size_t nbytes;
+  size_t peak_nbytes;
+  int nresets;
+};
 
-static void nfobstack_init(void) {
-  obstack_init(&db_obs);
-  dbobs_init = true;
-  obstack_chunk_size(&db_obs) = CHUNK_SIZE;
+/* The default arena, for the default in-core package db. */
+static struct nfarena pkgdb_default_arena = { .name = "pkgdb" };
+
+/* The arena used by nfmalloc(), for the selected in-core package db. */
+static struct nfarena *pkgdb_arena = &pkgdb_default_arena;
+
+struct nfarena *
+nfarena_new(const char *name)
+{
+  struct nfarena *arena;
+
+  arena = m_malloc(sizeof(*arena));
+  arena->name = name;
+  arena->init = false;
+  arena->nallocs = 0;
+  arena->nbytes = 0;
+  arena->peak_nbytes = 0;
+  arena->nresets = 0;
+
+  return arena;
+}
+
+static void
+nfarena_init(struct nfarena *arena)
+{
+  obstack_init(&arena->obs);
+  obstack_chunk_size(&arena->obs) = CHUNK_SIZE;
+  arena->init = true;
+}
+
+void *
+nfarena_alloc(struct nfarena *arena, size_t size)
+{
+  if (!arena->init)
+    nfarena_init(arena);
+
+  arena->nallocs++;
+  arena->nbytes += size;
+  if (arena->nbytes > arena->peak_nbytes)
+    arena->peak_nbytes = arena->nbytes;
+
+  return obstack_alloc(&arena->obs, size);
+}
+
+char *
+nfarena_strnsave(struct nfarena *arena, const char *string, size_t size)
+{
+  char *str;
+
+  str = nfarena_alloc(arena, size + 1);
+  memcpy(str, string, size);
+  str[size] = '\0';
+
+  return str;
+}
+
+char *
+nfarena_strsave(struct nfarena *arena, const char *string)
+{
+  return nfarena_strnsave(arena, string, strlen(string));
+}
+
+/**
+ * Print the arena usage statistics on debug output.
+ */
+void
+nfarena_report(struct nfarena *arena)
+{
+  debug(dbg_general, "arena %s: %zu allocations, %zu bytes in %d bytes "
+        "of chunks, peak %zu bytes, %d resets", arena->name,
+        arena->nallocs, arena->nbytes,
+        arena->init ? obstack_memory_used(&arena->obs) : 0,
+        arena->peak_nbytes, arena->nresets);
+}
+
+/**
+ * Release all the memory allocated from the arena, which can then be
+ * reused for new allocations.
+ */
+void
+nfarena_reset(struct nfarena *arena)
+{
+  nfarena_report(arena);
+
+  if (arena->init) {
+    obstack_free(&arena->obs, NULL);
+    arena->init = false;
+  }
+  arena->nallocs = 0;
+  arena->nbytes = 0;
+  arena->nresets++;
+}
+
+void
+nfarena_free(struct nfarena *arena)
+{
+  if (arena == NULL)
+    return;
+
+  nfarena_reset(arena);
+  free(arena);
+}
+
+/**
+ * Select the arena to use for the nfmalloc() family of functions.
+ *
+ * @param arena The arena to use, or NULL for the default one.
+ *
+ * @return The previously selected arena.
+ */
+struct nfarena *
+nfarena_select(struct nfarena *arena)
+{
+  struct nfarena *old_arena = pkgdb_arena;
+
+  if (arena == NULL)
+    arena = &pkgdb_default_arena;
+  pkgdb_arena = arena;
+
+  return old_arena;
 }
 
 void *
 nfmalloc(size_t size)
 {
-  OBSTACK_INIT;
-  return obstack_alloc(&db_obs, size);
+  return nfarena_alloc(pkgdb_arena, size);
 }
 
 char *nfstrsave(const char *string) {
-  OBSTACK_INIT;
-  return obstack_copy0 (&db_obs, string, strlen(string));
+  return nfarena_strsave(pkgdb_arena, string);
 }
 
 char *
 nfstrnsave(const char *string, size_t size)
 {
-  OBSTACK_INIT;
-  return obstack_copy0(&db_obs, string, size);
+  return nfarena_strnsave(pkgdb_arena, string, size);
 }
 
 void nffreeall(void) {
-  if (dbobs_init) {
-    obstack_free(&db_obs, NULL);
-    dbobs_init = false;
-  }
+  nfarena_reset(pkgdb_arena);
 }
@@ -29,11 +29,13 @@
 #include <dirent.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 #include <dpkg/i18n.h>
 #include <dpkg/c-ctype.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/string.h>
+#include <dpkg/varbuf.h>
 #include <dpkg/options.h>
 
 static const char *printforhelp;
@@ -279,6 +281,113 @@ dpkg_options_parse(const char *const **argvp, const struct cmdinfo *cmdinfos,
   }
 }
 
+static bool
+batch_read_line(FILE *file, const char *fn, struct varbuf *line)
+{
+  int c;
+
+  varbuf_reset(line);
+  while ((c = getc(file)) != EOF && c != '\n')
+    varbuf_add_char(line, c);
+  varbuf_end_str(line);
+
+  if (ferror(file))
+    ohshite(_("read error in batch file '%.255s'"), fn);
+
+  return c != EOF || line->used > 0;
+}
+
+/**
+ * Run the invocations listed in a batch file, one per line.
+ *
+ * Each line holds the options, action and arguments of an invocation as
+ * whitespace separated words, parsed with cmdinfos. Empty lines and lines
+ * starting with ‘#’ are ignored. The reset function gets called before
+ * parsing each line to restore the default option values, and defaction
+ * gets used for lines without an action, if not NULL.
+ *
+ * @param fn The batch filename, or ‘-’ for stdin.
+ * @param cmdinfos The options and actions allowed in the batch file.
+ * @param defaction The default action.
+ * @param reset The function restoring the default option values.
+ *
+ * @return The highest exit code returned by the actions.
+ */
+int
+dpkg_options_run_batch(const char *fn, const struct cmdinfo *cmdinfos,
+                       const struct cmdinfo *defaction, void (*reset)(void))
+{
+  const struct cmdinfo *batchaction = cipaction;
+  struct varbuf line = VARBUF_INIT;
+  const char **args = NULL;
+  int args_max = 0;
+  FILE *file;
+  int ret = 0;
+
+  if (strcmp(fn, "-") == 0) {
+    file = stdin;
+  } else {
+    file = fopen(fn, "r");
+    if (file == NULL)
+      ohshite(_("cannot open batch file '%.255s'"), fn);
+  }
+
+  while (batch_read_line(file, fn, &line)) {
+    const char *const *argv;
+    char *word;
+    int nargs = 0;
+    int rc;
+
+    word = line.buf;
+    for (;;) {
+      while (c_isspace(*word))
+        *word++ = '\0';
+      if (*word == '\0' || (nargs == 0 && *word == '#'))
+        break;
+
+      if (nargs + 3 > args_max) {
+        args_max = args_max * 2 + 16;
+        args = m_realloc(args, sizeof(*args) * args_max);
+      }
+      args[++nargs] = word;
+
+      while (*word && !c_isspace(*word))
+        word++;
+    }
+    if (nargs == 0)
+      continue;
+    /* The program name slot gets skipped when parsing. */
+    args[0] = batchaction->olong;
+    args[nargs + 1] = NULL;
+
+    reset();
+    cipaction = NULL;
+
+    argv = args;
+    dpkg_options_parse(&argv, cmdinfos, printforhelp);
+
+    if (cipaction == NULL) {
+      if (defaction == NULL)
+        badusage(_("need an action option"));
+      setaction(defaction, NULL);
+    }
+
+    rc = cipaction->action(argv);
+    if (rc > ret)
+      ret = rc;
+  }
+
+  cipaction = batchaction;
+
+  if (file != stdin && fclose(file))
+    ohshite(_("error closing batch file '%.255s'"), fn);
+
+  free(args);
+  varbuf_destroy(&line);
+
+  return ret;
+}
+
 long
 dpkg_options_parse_arg_int(const struct cmdinfo *cmd, const char *str)
 {
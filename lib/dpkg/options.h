@@ -64,6 +64,10 @@ void dpkg_options_load(const char *prog, const struct cmdinfo *cmdinfos);
 void dpkg_options_parse(const char *const **argvp,
                         const struct cmdinfo *cmdinfos, const char *help_str);
 
+int dpkg_options_run_batch(const char *fn, const struct cmdinfo *cmdinfos,
+                           const struct cmdinfo *defaction,
+                           void (*reset)(void));
+
 long dpkg_options_parse_arg_int(const struct cmdinfo *cmd, const char *str);
 
 struct pkginfo *
@@ -46,6 +46,7 @@
 #include <dpkg/parsedump.h>
 #include <dpkg/fdio.h>
 #include <dpkg/buffer.h>
+#include <dpkg/perf.h>
 
 /**
  * Fields information.
@@ -109,6 +110,88 @@ struct pkg_parse_object {
   struct pkgbin *pkgbin;
 };
 
+/**
+ * Origin of the fields with their decoding deferred.
+ *
+ * Shared by all the deferred fields from the same parser context, so that
+ * they can get decoded later on as if parsed along their package stanza.
+ */
+struct lazyfield_source {
+  const char *filename;
+  enum parsedbtype type;
+  enum parsedbflags flags;
+};
+
+/**
+ * Field with its decoding deferred until first needed.
+ */
+struct lazyfield {
+  struct lazyfield *next;
+  const struct lazyfield_source *source;
+  const struct fieldinfo *fip;
+  const char *value;
+  int lno;
+};
+
+/**
+ * Defer decoding the field value until first needed.
+ *
+ * The package names referenced get looked up right away though, so that
+ * the package database ends up with the same package sets as if the field
+ * had been decoded.
+ */
+static void
+pkg_parse_defer_field(struct parsedb_state *ps, struct field_state *fs,
+                      struct pkgbin *pkgbin, const struct fieldinfo *fip)
+{
+  static struct varbuf name;
+  struct lazyfield *lf, **lfp;
+  const char *p;
+
+  if (ps->lazy_source == NULL) {
+    ps->lazy_source = nfmalloc(sizeof(*ps->lazy_source));
+    ps->lazy_source->filename = nfstrsave(ps->filename);
+    ps->lazy_source->type = ps->type;
+    ps->lazy_source->flags = ps->flags;
+  }
+
+  lf = nfmalloc(sizeof(*lf));
+  lf->next = NULL;
+  lf->source = ps->lazy_source;
+  lf->fip = fip;
+  lf->value = nfstrnsave(fs->valuestart, fs->valuelen);
+  lf->lno = ps->lno;
+
+  /* Preserve the field order, which the dependencies end up in. */
+  for (lfp = &pkgbin->lazyfields; *lfp; lfp = &(*lfp)->next)
+    ;
+  *lfp = lf;
+
+  p = lf->value;
+  while (*p) {
+    const char *namestart;
+
+    while (c_isspace(*p) || *p == ',' || *p == '|')
+      p++;
+
+    namestart = p;
+    while (*p && !c_isspace(*p) && *p != ':' && *p != '(' && *p != ',' &&
+           *p != '|')
+      p++;
+    if (p > namestart) {
+      varbuf_reset(&name);
+      varbuf_add_buf(&name, namestart, p - namestart);
+      varbuf_end_str(&name);
+
+      pkg_db_find_set(name.buf);
+    }
+
+    /* Skip the architecture qualifier and version relationship. */
+    while (*p && *p != ',' && *p != '|')
+      p++;
+  }
+}
+
 /**
  * Parse the field and value into the package being constructed.
  */
@@ -139,6 +222,13 @@ pkg_parse_field(struct parsedb_state *ps, struct field_state *fs,
       parse_error(ps,
                   _("duplicate value for '%s' field"), fip->name);
 
+    if ((ps->flags & pdb_lazy_fields) && fip->rcall == f_dependency) {
+      /* Empty fields are ignored, as when decoded. */
+      if (fs->valuelen > 0)
+        pkg_parse_defer_field(ps, fs, pkg_obj->pkgbin, fip);
+      return;
+    }
+
     varbuf_reset(&fs->value);
     varbuf_add_buf(&fs->value, fs->valuestart, fs->valuelen);
     varbuf_end_str(&fs->value);
@@ -472,6 +562,7 @@ pkg_parse_copy(struct parsedb_state *ps,
 
   /* Copy across data. */
   memcpy(dst_pkgbin, src_pkgbin, sizeof(struct pkgbin));
+  pkg_invalidate_stanza(dst_pkg);
   if (!(ps->flags & pdb_recordavailable)) {
     struct trigaw *ta;
 
@@ -529,6 +620,7 @@ parsedb_new(const char *filename, int fd, enum parsedbflags flags)
   ps->lno = 0;
   ps->pkg = NULL;
   ps->pkgbin = NULL;
+  ps->lazy_source = NULL;
 
   return ps;
 }
@@ -826,16 +918,78 @@ int
 parsedb(const char *filename, enum parsedbflags flags, struct pkginfo **pkgp)
 {
   struct parsedb_state *ps;
+  struct perf_phase *phase;
   int count;
 
+  phase = perf_phase_start("db-parse");
+
   ps = parsedb_open(filename, flags);
   parsedb_load(ps);
   count = parsedb_parse(ps, pkgp);
   parsedb_close(ps);
 
+  perf_phase_stop(phase);
+
   return count;
 }
 
+/**
+ * Decode the package fields with their decoding deferred.
+ *
+ * The fields get decoded as if they had been parsed along the rest of the
+ * package stanza, and their reverse dependency links get set up.
+ *
+ * @param pkg The package.
+ * @param pkgbin The package binary information to decode the fields for.
+ */
+void
+pkgbin_decode_fields(struct pkginfo *pkg, struct pkgbin *pkgbin)
+{
+  struct parsedb_state ps;
+  struct pkgbin newbin;
+  struct lazyfield *lf;
+  struct dependency *dep, **depp;
+  struct deppossi *dop;
+  bool available = pkgbin == &pkg->available;
+
+  if (pkgbin->lazyfields == NULL)
+    return;
+
+  memset(&ps, 0, sizeof(ps));
+  ps.pkg = pkg;
+  ps.pkgbin = pkgbin;
+  ps.fd = -1;
+
+  pkgbin_blank(&newbin);
+
+  /* Detach the fields first, so that they never get decoded twice. */
+  lf = pkgbin->lazyfields;
+  pkgbin->lazyfields = NULL;
+
+  for (; lf; lf = lf->next) {
+    ps.filename = lf->source->filename;
+    ps.type = lf->source->type;
+    ps.flags = lf->source->flags;
+    ps.lno = lf->lno;
+
+    lf->fip->rcall(pkg, &newbin, &ps, lf->value, lf->fip);
+  }
+
+  /* Initialize deps to be arch-specific unless stated otherwise. */
+  for (dep = newbin.depends; dep; dep = dep->next)
+    for (dop = dep->list; dop; dop = dop->next)
+      if (!dop->arch)
+        dop->arch = pkgbin->arch;
+
+  /* Append the decoded dependencies to any already present. */
+  dep = pkgbin->depends;
+  copy_dependency_links(pkg, &pkgbin->depends, NULL, available);
+  for (depp = &dep; *depp; depp = &(*depp)->next)
+    ;
+  *depp = newbin.depends;
+  copy_dependency_links(pkg, &pkgbin->depends, dep, available);
+}
+
 /**
  * Copy dependency links structures.
  *
@@ -32,6 +32,7 @@
  */
 
 struct fieldinfo;
+struct lazyfield_source;
 
 /**
  * Parse action.
@@ -52,6 +53,7 @@ struct parsedb_state {
 	char *dataptr;
 	char *endptr;
 	const char *filename;
+	struct lazyfield_source *lazy_source;
 	int fd;
 	int lno;
 };
@@ -232,6 +232,7 @@ parseversion(struct dpkg_version *rversion, const char *string,
   if (hyphen)
     *hyphen++ = '\0';
   rversion->revision= hyphen ? hyphen : "";
+  dpkg_version_build_key(rversion);
 
   /* XXX: Would be faster to use something like cisversion and cisrevision. */
   ptr = rversion->version;
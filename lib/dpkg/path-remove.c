@@ -26,6 +26,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <dpkg/i18n.h>
@@ -72,6 +73,39 @@ secure_unlink(const char *pathname)
 	return secure_unlink_statted(pathname, &stab);
 }
 
+/**
+ * Securely unlink a pathname relative to a directory file descriptor.
+ *
+ * This is the same as secure_unlink(), but with the pathname resolved
+ * like unlinkat(2) does.
+ *
+ * @param dirfd The directory file descriptor, or AT_FDCWD.
+ * @param pathname The pathname to unlink.
+ *
+ * @retval  0 On success.
+ * @retval -1 On failure, just like unlinkat(2).
+ */
+int
+secure_unlinkat(int dirfd, const char *pathname)
+{
+	struct stat stab;
+
+	if (fstatat(dirfd, pathname, &stab, AT_SYMLINK_NOFOLLOW))
+		return -1;
+
+	if (S_ISREG(stab.st_mode) ? (stab.st_mode & 07000) :
+	    !(S_ISLNK(stab.st_mode) || S_ISDIR(stab.st_mode) ||
+	      S_ISFIFO(stab.st_mode) || S_ISSOCK(stab.st_mode))) {
+		if (fchmodat(dirfd, pathname, 0600, 0))
+			return -1;
+	}
+
+	if (unlinkat(dirfd, pathname, 0))
+		return -1;
+
+	return 0;
+}
+
 /**
  * Securely remove a pathname.
  *
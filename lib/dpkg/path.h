@@ -44,6 +44,7 @@ char *path_make_temp_template(const char *suffix);
 
 int secure_unlink_statted(const char *pathname, const struct stat *stab);
 int secure_unlink(const char *pathname);
+int secure_unlinkat(int dirfd, const char *pathname);
 int secure_remove(const char *pathname);
 
 void path_remove_tree(const char *pathname);
@@ -0,0 +1,326 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * perf.c - performance instrumentation
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <dpkg/i18n.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/varbuf.h>
+#include <dpkg/fdio.h>
+#include <dpkg/perf.h>
+
+/*
+ * The phases and counters are kept in the order they were first seen, and
+ * are looked up by name, as there are only ever a few dozen of them.
+ *
+ * The phase times are inclusive, so the time of a phase running inside
+ * another one (f.ex. a maintainer script during an unpack) is accounted
+ * in both.
+ */
+
+struct perf_phase {
+	struct perf_phase *next;
+	char *name;
+
+	bool running;
+	struct timespec start_wall;
+	struct rusage start_self;
+	struct rusage start_children;
+
+	long count;
+	struct timespec wall;
+	struct timeval utime;
+	struct timeval stime;
+	struct timeval children_utime;
+	struct timeval children_stime;
+};
+
+struct perf_counter {
+	struct perf_counter *next;
+	char *name;
+	long value;
+};
+
+static int perf_fd = -1;
+
+static struct perf_phase *phases;
+static struct perf_phase **phases_tail = &phases;
+
+static struct perf_counter *counters;
+static struct perf_counter **counters_tail = &counters;
+
+/**
+ * Enable the instrumentation, with its report to be sent to fd.
+ */
+void
+perf_enable(int fd)
+{
+	setcloexec(fd, _("<instrumentation report file descriptor>"));
+
+	perf_fd = fd;
+}
+
+bool
+perf_is_enabled(void)
+{
+	return perf_fd >= 0;
+}
+
+/**
+ * Get the current time, as used for the phase wall clock times.
+ */
+void
+perf_gettime(struct timespec *ts)
+{
+#if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && \
+    defined(_POSIX_MONOTONIC_CLOCK) && _POSIX_MONOTONIC_CLOCK > 0
+	if (clock_gettime(CLOCK_MONOTONIC, ts) < 0)
+		ohshite(_("cannot get current time"));
+#else
+	struct timeval tv;
+
+	if (gettimeofday(&tv, NULL) < 0)
+		ohshite(_("cannot get current time"));
+
+	ts->tv_sec = tv.tv_sec;
+	ts->tv_nsec = tv.tv_usec * 1000;
+#endif
+}
+
+static void
+timeval_add_delta(struct timeval *acc,
+                  const struct timeval *end, const struct timeval *start)
+{
+	acc->tv_sec += end->tv_sec - start->tv_sec;
+	acc->tv_usec += end->tv_usec - start->tv_usec;
+	while (acc->tv_usec < 0) {
+		acc->tv_usec += 1000000;
+		acc->tv_sec--;
+	}
+	while (acc->tv_usec >= 1000000) {
+		acc->tv_usec -= 1000000;
+		acc->tv_sec++;
+	}
+}
+
+static struct perf_phase *
+perf_phase_get(const char *name)
+{
+	struct perf_phase *phase;
+
+	for (phase = phases; phase; phase = phase->next)
+		if (strcmp(phase->name, name) == 0)
+			return phase;
+
+	phase = m_calloc(1, sizeof(*phase));
+	phase->name = m_strdup(name);
+
+	*phases_tail = phase;
+	phases_tail = &phase->next;
+
+	return phase;
+}
+
+/**
+ * Start timing a phase.
+ *
+ * If the phase was already running, because an error unwound the stack
+ * before it got stopped, it gets restarted, and the time spent on the
+ * interrupted run is not accounted.
+ *
+ * @return The phase to pass to perf_phase_stop(), or NULL if the
+ *         instrumentation is disabled.
+ */
+struct perf_phase *
+perf_phase_start(const char *name)
+{
+	struct perf_phase *phase;
+
+	if (perf_fd < 0)
+		return NULL;
+
+	phase = perf_phase_get(name);
+	phase->running = true;
+	getrusage(RUSAGE_SELF, &phase->start_self);
+	getrusage(RUSAGE_CHILDREN, &phase->start_children);
+	perf_gettime(&phase->start_wall);
+
+	return phase;
+}
+
+static void
+perf_phase_add_wall(struct perf_phase *phase, const struct timespec *start)
+{
+	struct timespec now;
+
+	perf_gettime(&now);
+
+	phase->wall.tv_sec += now.tv_sec - start->tv_sec;
+	phase->wall.tv_nsec += now.tv_nsec - start->tv_nsec;
+	while (phase->wall.tv_nsec < 0) {
+		phase->wall.tv_nsec += 1000000000;
+		phase->wall.tv_sec--;
+	}
+	while (phase->wall.tv_nsec >= 1000000000) {
+		phase->wall.tv_nsec -= 1000000000;
+		phase->wall.tv_sec++;
+	}
+}
+
+void
+perf_phase_stop(struct perf_phase *phase)
+{
+	struct rusage self, children;
+
+	if (phase == NULL || !phase->running)
+		return;
+
+	perf_phase_add_wall(phase, &phase->start_wall);
+	getrusage(RUSAGE_SELF, &self);
+	getrusage(RUSAGE_CHILDREN, &children);
+
+	timeval_add_delta(&phase->utime,
+	                  &self.ru_utime, &phase->start_self.ru_utime);
+	timeval_add_delta(&phase->stime,
+	                  &self.ru_stime, &phase->start_self.ru_stime);
+	timeval_add_delta(&phase->children_utime,
+	                  &children.ru_utime, &phase->start_children.ru_utime);
+	timeval_add_delta(&phase->children_stime,
+	                  &children.ru_stime, &phase->start_children.ru_stime);
+
+	phase->count++;
+	phase->running = false;
+}
+
+/**
+ * Account a complete run of a phase, ending now.
+ *
+ * This is for runs which might overlap with other runs of the same phase,
+ * such as concurrent maintainer script jobs, and which cannot then be
+ * timed with perf_phase_start() and perf_phase_stop(). Only the time of
+ * the child processes reaped between start_children and end_children, as
+ * returned by getrusage(RUSAGE_CHILDREN), gets accounted.
+ *
+ * @param name The phase name.
+ * @param start_wall The start time of the run, from perf_gettime().
+ * @param start_children The child processes usage before reaping the run.
+ * @param end_children The child processes usage after reaping the run.
+ */
+void
+perf_phase_add(const char *name, const struct timespec *start_wall,
+               const struct rusage *start_children,
+               const struct rusage *end_children)
+{
+	struct perf_phase *phase;
+
+	if (perf_fd < 0)
+		return;
+
+	phase = perf_phase_get(name);
+	perf_phase_add_wall(phase, start_wall);
+	timeval_add_delta(&phase->children_utime,
+	                  &end_children->ru_utime, &start_children->ru_utime);
+	timeval_add_delta(&phase->children_stime,
+	                  &end_children->ru_stime, &start_children->ru_stime);
+	phase->count++;
+}
+
+/**
+ * Add n to the named counter, f.ex. for the system calls being tracked.
+ */
+void
+perf_count(const char *name, long n)
+{
+	struct perf_counter *counter;
+
+	if (perf_fd < 0)
+		return;
+
+	for (counter = counters; counter; counter = counter->next)
+		if (strcmp(counter->name, name) == 0)
+			break;
+
+	if (counter == NULL) {
+		counter = m_calloc(1, sizeof(*counter));
+		counter->name = m_strdup(name);
+
+		*counters_tail = counter;
+		counters_tail = &counter->next;
+	}
+
+	counter->value += n;
+}
+
+/**
+ * Send the report to the instrumentation fd.
+ *
+ * There is one line per phase, with its run count, and its wall clock,
+ * user and system times, and those of its child processes, in seconds:
+ *
+ *   phase: <name>: count=<n> wall=<s> user=<s> system=<s>
+ *                  children-user=<s> children-system=<s>
+ *
+ * followed by one line per counter:
+ *
+ *   counter: <name>: <n>
+ */
+void
+perf_report(void)
+{
+	struct perf_phase *phase;
+	struct perf_counter *counter;
+	struct varbuf vb = VARBUF_INIT;
+
+	if (perf_fd < 0)
+		return;
+
+	for (phase = phases; phase; phase = phase->next) {
+		varbuf_printf(&vb, "phase: %s: count=%ld wall=%ld.%06ld "
+		              "user=%ld.%06ld system=%ld.%06ld "
+		              "children-user=%ld.%06ld children-system=%ld.%06ld\n",
+		              phase->name, phase->count,
+		              (long)phase->wall.tv_sec,
+		              (long)phase->wall.tv_nsec / 1000,
+		              (long)phase->utime.tv_sec,
+		              (long)phase->utime.tv_usec,
+		              (long)phase->stime.tv_sec,
+		              (long)phase->stime.tv_usec,
+		              (long)phase->children_utime.tv_sec,
+		              (long)phase->children_utime.tv_usec,
+		              (long)phase->children_stime.tv_sec,
+		              (long)phase->children_stime.tv_usec);
+	}
+	for (counter = counters; counter; counter = counter->next)
+		varbuf_printf(&vb, "counter: %s: %ld\n",
+		              counter->name, counter->value);
+
+	if (vb.used && fd_write(perf_fd, vb.buf, vb.used) < 0)
+		ohshite(_("unable to write instrumentation report"));
+
+	varbuf_destroy(&vb);
+}
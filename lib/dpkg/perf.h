@@ -0,0 +1,59 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * perf.h - performance instrumentation
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBDPKG_PERF_H
+#define LIBDPKG_PERF_H
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <stdbool.h>
+#include <time.h>
+
+#include <dpkg/macros.h>
+
+DPKG_BEGIN_DECLS
+
+/**
+ * @defgroup perf Performance instrumentation
+ * @ingroup dpkg-internal
+ * @{
+ */
+
+struct perf_phase;
+
+void perf_enable(int fd);
+bool perf_is_enabled(void);
+
+struct perf_phase *perf_phase_start(const char *name);
+void perf_phase_stop(struct perf_phase *phase);
+void perf_phase_add(const char *name, const struct timespec *start_wall,
+                    const struct rusage *start_children,
+                    const struct rusage *end_children);
+
+void perf_gettime(struct timespec *ts);
+
+void perf_count(const char *name, long n);
+
+void perf_report(void);
+
+/** @} */
+
+DPKG_END_DECLS
+
+#endif /* LIBDPKG_PERF_H */
@@ -25,6 +25,7 @@
 #include <compat.h>
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -35,14 +36,175 @@
 #include <dpkg/string.h>
 #include <dpkg/arch.h>
 
-/* This must always be a prime for optimal performance.
- * With 4093 buckets, we glean a 20% speedup, for 8191 buckets
- * we get 23%. The nominal increase in memory usage is a mere
- * sizeof(void *) * 8191 (i.e. less than 32 KiB on 32bit systems). */
-#define BINS 8191
+/* The initial number of buckets, which must be a power of two, as the
+ * bucket is selected by the top bits of the hash. The table gets doubled
+ * whenever there are more package sets than buckets, so that small
+ * databases (as in a chroot) do not pay for a huge table, and big ones
+ * (with all the available packages from several archives) keep short
+ * chains. */
+#define BINS_MIN 1024
+/* The shift for BINS_MIN, from the 32-bit hash to its top 10 bits. */
+#define BINS_MIN_SHIFT (32 - 10)
 
-static struct pkgset *bins[BINS];
-static int npkg, nset;
+/* The number of distinct hash values. */
+#define HASH_END ((uint64_t)1 << 32)
+
+/*
+ * An in-core package database, with its own hash table and memory arena.
+ *
+ * All the pkg_db_*() functions, and the nfmalloc() family, operate on the
+ * currently selected database, which is the default one unless another
+ * one has been selected with pkg_db_select().
+ */
+struct pkg_db {
+  /* The arena for the nfmalloc() family, or NULL for the default one. */
+  struct nfarena *arena;
+
+  /* The bins cover consecutive hash ranges, and their chains are sorted
+   * by hash, so that the database is always walked in hash order, which
+   * does not change when the table grows. */
+  struct pkgset **bins;
+  unsigned int nbins;
+  /* The shift selecting the bin from the top bits of the hash. */
+  unsigned int shift;
+  int npkg, nset;
+};
+
+static struct pkg_db pkg_db_default;
+static struct pkg_db *db = &pkg_db_default;
+
+/* The number of databases other than the default one. */
+static int pkg_db_nextra;
+
+/**
+ * Create a new empty package database.
+ *
+ * The database is not selected, which needs to be done with pkg_db_select()
+ * before it can be populated or queried.
+ *
+ * @return The package database.
+ */
+struct pkg_db *
+pkg_db_new(void)
+{
+  struct pkg_db *new_db;
+
+  new_db = m_malloc(sizeof(*new_db));
+  new_db->arena = nfarena_new("pkgdb");
+  new_db->bins = NULL;
+  new_db->nbins = 0;
+  new_db->shift = 0;
+  new_db->npkg = 0;
+  new_db->nset = 0;
+
+  pkg_db_nextra++;
+
+  return new_db;
+}
+
+/**
+ * Select the package database to operate on.
+ *
+ * The package sets and instances from the other databases are still valid,
+ * as long as these do not get reset or freed, and iterators keep walking
+ * the database that was selected when they were created.
+ *
+ * @param new_db The package database, or NULL for the default one.
+ *
+ * @return The previously selected package database.
+ */
+struct pkg_db *
+pkg_db_select(struct pkg_db *new_db)
+{
+  struct pkg_db *old_db = db;
+
+  if (new_db == NULL)
+    new_db = &pkg_db_default;
+
+  db = new_db;
+  nfarena_select(db->arena);
+
+  return old_db;
+}
+
+/**
+ * Free a package database.
+ *
+ * All its package sets and instances, and any other memory allocated with
+ * the nfmalloc() family while it was selected, get released.
+ *
+ * @param old_db The package database, which must not be selected.
+ */
+void
+pkg_db_free(struct pkg_db *old_db)
+{
+  if (old_db == NULL)
+    return;
+  if (old_db == &pkg_db_default)
+    internerr("cannot free the default package database");
+  if (old_db == db)
+    internerr("cannot free the selected package database");
+
+  nfarena_free(old_db->arena);
+  free(old_db->bins);
+  free(old_db);
+
+  pkg_db_nextra--;
+}
+
+static bool
+pkgset_name_matches(const char *setname, const char *name)
+{
+  while (*setname && *setname == c_tolower(*name)) {
+    setname++;
+    name++;
+  }
+
+  return *setname == '\0' && *name == '\0';
+}
+
+static void
+pkg_db_grow(void)
+{
+  struct pkgset **bins;
+  unsigned int oldnbins = db->nbins;
+  unsigned int i;
+
+  if (db->nbins == 0) {
+    db->nbins = BINS_MIN;
+    db->shift = BINS_MIN_SHIFT;
+  } else {
+    db->nbins *= 2;
+    db->shift--;
+  }
+  bins = db->bins = m_realloc(db->bins, sizeof(struct pkgset *) * db->nbins);
+  if (oldnbins == 0) {
+    memset(bins, 0, sizeof(struct pkgset *) * db->nbins);
+    return;
+  }
+
+  /* Each chain gets split in two consecutive ones, keeping the relative
+   * order, depending on the new hash bit now being used. Going downwards
+   * so that no chain gets overwritten before being split. */
+  for (i = oldnbins; i-- > 0; ) {
+    struct pkgset *set, *next;
+    struct pkgset **lo = &bins[i * 2];
+    struct pkgset **hi = &bins[i * 2 + 1];
+
+    for (set = bins[i]; set; set = next) {
+      next = set->next;
+      if ((set->hash >> db->shift) & 1) {
+        *hi = set;
+        hi = &set->next;
+      } else {
+        *lo = set;
+        lo = &set->next;
+      }
+    }
+    *lo = NULL;
+    *hi = NULL;
+  }
+}
 
 /**
  * Return the package set with the given name.
@@ -64,31 +226,32 @@ struct pkgset *
 pkg_db_find_set(const char *inname)
 {
   struct pkgset **setp, *new_set;
-  char *name = m_strdup(inname), *p;
+  unsigned int hash;
+  char *name, *p;
 
-  p= name;
-  while (*p) {
-    *p = c_tolower(*p);
-    p++;
-  }
+  if ((unsigned int)db->nset >= db->nbins)
+    pkg_db_grow();
 
-  setp = bins + (str_fnv_hash(name) % (BINS));
-  while (*setp && strcasecmp((*setp)->name, name))
+  hash = str_fnv_hash_lower(inname);
+  setp = db->bins + (hash >> db->shift);
+  while (*setp && (*setp)->hash <= hash) {
+    if ((*setp)->hash == hash && pkgset_name_matches((*setp)->name, inname))
+      return *setp;
     setp = &(*setp)->next;
-  if (*setp) {
-    free(name);
-    return *setp;
   }
 
+  name = nfstrsave(inname);
+  for (p = name; *p; p++)
+    *p = c_tolower(*p);
+
   new_set = nfmalloc(sizeof(struct pkgset));
   pkgset_blank(new_set);
-  new_set->name = nfstrsave(name);
-  new_set->next = NULL;
+  new_set->name = name;
+  new_set->hash = hash;
+  new_set->next = *setp;
   *setp = new_set;
-  nset++;
-  npkg++;
-
-  free(name);
+  db->nset++;
+  db->npkg++;
 
   return new_set;
 }
@@ -199,7 +362,7 @@ pkg_db_get_pkg(struct pkgset *set, const struct dpkg_arch *arch)
   pkg->installed.arch = arch;
   pkg->available.arch = arch;
   *pkgp = pkg;
-  npkg++;
+  db->npkg++;
 
   return pkg;
 }
@@ -232,7 +395,7 @@ pkg_db_find_pkg(const char *name, const struct dpkg_arch *arch)
 int
 pkg_db_count_set(void)
 {
-  return nset;
+  return db->nset;
 }
 
 /**
@@ -243,12 +406,16 @@ pkg_db_count_set(void)
 int
 pkg_db_count_pkg(void)
 {
-  return npkg;
+  return db->npkg;
 }
 
 struct pkgiterator {
+  struct pkg_db *db;
   struct pkginfo *pkg;
-  int nbinn;
+  /* The start of the hash range of the next bin to walk. */
+  uint64_t hash_next;
+  /* The table size the iterator has walked so far. */
+  unsigned int nbins;
 };
 
 /**
@@ -264,12 +431,52 @@ pkg_db_iter_new(void)
   struct pkgiterator *iter;
 
   iter = m_malloc(sizeof(struct pkgiterator));
+  iter->db = db;
   iter->pkg = NULL;
-  iter->nbinn = 0;
+  iter->hash_next = 0;
+  iter->nbins = db->nbins;
 
   return iter;
 }
 
+/*
+ * Move the iterator to the next package instance to return, if any.
+ *
+ * If the table has grown since the previous step, the chain being walked
+ * might have been split, but as the database is walked in hash order, it
+ * can resume right after the bin now holding the current package set.
+ */
+static bool
+pkg_db_iter_step(struct pkgiterator *iter)
+{
+  struct pkg_db *iter_db = iter->db;
+
+  if (iter_db->nbins == 0)
+    return false;
+
+  if (iter->nbins != iter_db->nbins) {
+    if (iter->pkg) {
+      uint64_t bin = iter->pkg->set->hash >> iter_db->shift;
+
+      iter->hash_next = (bin + 1) << iter_db->shift;
+    }
+    iter->nbins = iter_db->nbins;
+  }
+
+  while (!iter->pkg) {
+    struct pkgset *set;
+
+    if (iter->hash_next >= HASH_END)
+      return false;
+    set = iter_db->bins[iter->hash_next >> iter_db->shift];
+    if (set)
+      iter->pkg = &set->pkg;
+    iter->hash_next += (uint64_t)1 << iter_db->shift;
+  }
+
+  return true;
+}
+
 /**
  * Return the next package set in the database.
  *
@@ -284,13 +491,8 @@ pkg_db_iter_next_set(struct pkgiterator *iter)
 {
   struct pkgset *set;
 
-  while (!iter->pkg) {
-    if (iter->nbinn >= BINS)
-      return NULL;
-    if (bins[iter->nbinn])
-      iter->pkg = &bins[iter->nbinn]->pkg;
-    iter->nbinn++;
-  }
+  if (!pkg_db_iter_step(iter))
+    return NULL;
 
   set = iter->pkg->set;
   if (set->next)
@@ -319,13 +521,8 @@ pkg_db_iter_next_pkg(struct pkgiterator *iter)
 {
   struct pkginfo *pkg;
 
-  while (!iter->pkg) {
-    if (iter->nbinn >= BINS)
-      return NULL;
-    if (bins[iter->nbinn])
-      iter->pkg = &bins[iter->nbinn]->pkg;
-    iter->nbinn++;
-  }
+  if (!pkg_db_iter_step(iter))
+    return NULL;
 
   pkg = iter->pkg;
   if (pkg->arch_next)
@@ -346,37 +543,43 @@ pkg_db_iter_next_pkg(struct pkgiterator *iter)
 void
 pkg_db_iter_free(struct pkgiterator *iter)
 {
+  if (iter == NULL)
+    return;
+
   free(iter);
 }
 
 void
 pkg_db_reset(void)
 {
-  int i;
-
-  dpkg_arch_reset_list();
+  /* The architecture list is shared by all the databases, so it can only
+   * be reset when there is no other database which might refer to it. */
+  if (db == &pkg_db_default && pkg_db_nextra == 0)
+    dpkg_arch_reset_list();
   nffreeall();
-  nset = 0;
-  npkg = 0;
-  for (i=0; i<BINS; i++) bins[i]= NULL;
+  db->nset = 0;
+  db->npkg = 0;
+  if (db->bins)
+    memset(db->bins, 0, sizeof(struct pkgset *) * db->nbins);
 }
 
 void
 pkg_db_report(FILE *file)
 {
+  unsigned int b;
   int i, c;
   struct pkgset *pkg;
   int *freq;
 
-  freq = m_malloc(sizeof(int) * nset + 1);
-  for (i = 0; i <= nset; i++)
+  freq = m_malloc(sizeof(int) * db->nset + 1);
+  for (i = 0; i <= db->nset; i++)
     freq[i] = 0;
-  for (i=0; i<BINS; i++) {
-    for (c=0, pkg= bins[i]; pkg; c++, pkg= pkg->next);
-    fprintf(file,"bin %5d has %7d\n",i,c);
+  for (b = 0; b < db->nbins; b++) {
+    for (c=0, pkg= db->bins[b]; pkg; c++, pkg= pkg->next);
+    fprintf(file, "bin %5u has %7d\n", b, c);
     freq[c]++;
   }
-  for (i = nset; i > 0 && freq[i] == 0; i--);
+  for (i = db->nset; i > 0 && freq[i] == 0; i--);
   while (i >= 0) {
     fprintf(file, "size %7d occurs %5d times\n", i, freq[i]);
     i--;
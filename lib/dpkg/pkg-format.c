@@ -48,6 +48,10 @@ struct pkg_format_node {
 	size_t width;
 	int pad;
 	char *data;
+	/** The length of data for strings. */
+	size_t len;
+	/** The resolved field, or NULL for arbitrary fields. */
+	const struct fieldinfo *fip;
 };
 
 
@@ -60,12 +64,134 @@ pkg_format_node_new(void)
 	buf->type = PKG_FORMAT_INVALID;
 	buf->next = NULL;
 	buf->data = NULL;
+	buf->len = 0;
+	buf->fip = NULL;
 	buf->width = 0;
 	buf->pad = 0;
 
 	return buf;
 }
 
+static void
+virt_package(struct varbuf *vb,
+             const struct pkginfo *pkg, const struct pkgbin *pkgbin,
+             enum fwriteflags flags, const struct fieldinfo *fip)
+{
+	varbuf_add_pkgbin_name(vb, pkg, pkgbin, pnaw_nonambig);
+}
+
+static void
+virt_status_abbrev(struct varbuf *vb,
+                   const struct pkginfo *pkg, const struct pkgbin *pkgbin,
+                   enum fwriteflags flags, const struct fieldinfo *fip)
+{
+	if (pkgbin != &pkg->installed)
+		return;
+
+	varbuf_add_char(vb, pkg_abbrev_want(pkg));
+	varbuf_add_char(vb, pkg_abbrev_status(pkg));
+	varbuf_add_char(vb, pkg_abbrev_eflag(pkg));
+}
+
+static void
+virt_status_want(struct varbuf *vb,
+                 const struct pkginfo *pkg, const struct pkgbin *pkgbin,
+                 enum fwriteflags flags, const struct fieldinfo *fip)
+{
+	if (pkgbin != &pkg->installed)
+		return;
+
+	varbuf_add_str(vb, pkg_want_name(pkg));
+}
+
+static void
+virt_status_status(struct varbuf *vb,
+                   const struct pkginfo *pkg, const struct pkgbin *pkgbin,
+                   enum fwriteflags flags, const struct fieldinfo *fip)
+{
+	if (pkgbin != &pkg->installed)
+		return;
+
+	varbuf_add_str(vb, pkg_status_name(pkg));
+}
+
+static void
+virt_status_eflag(struct varbuf *vb,
+                  const struct pkginfo *pkg, const struct pkgbin *pkgbin,
+                  enum fwriteflags flags, const struct fieldinfo *fip)
+{
+	if (pkgbin != &pkg->installed)
+		return;
+
+	varbuf_add_str(vb, pkg_eflag_name(pkg));
+}
+
+static void
+virt_summary(struct varbuf *vb,
+             const struct pkginfo *pkg, const struct pkgbin *pkgbin,
+             enum fwriteflags flags, const struct fieldinfo *fip)
+{
+	const char *desc;
+	int len;
+
+	desc = pkgbin_summary(pkg, pkgbin, &len);
+
+	varbuf_add_buf(vb, desc, len);
+}
+
+static void
+virt_source_package(struct varbuf *vb,
+                    const struct pkginfo *pkg, const struct pkgbin *pkgbin,
+                    enum fwriteflags flags, const struct fieldinfo *fip)
+{
+	const char *name;
+	size_t len;
+
+	name = pkgbin->source;
+	if (name == NULL)
+		name = pkg->set->name;
+
+	len = strcspn(name, " ");
+
+	varbuf_add_buf(vb, name, len);
+}
+
+static void
+virt_source_version(struct varbuf *vb,
+                    const struct pkginfo *pkg, const struct pkgbin *pkgbin,
+                    enum fwriteflags flags, const struct fieldinfo *fip)
+{
+	const char *version;
+	size_t len;
+
+	if (pkgbin->source)
+		version = strchr(pkgbin->source, '(');
+	else
+		version = NULL;
+
+	if (version == NULL) {
+		varbufversion(vb, &pkgbin->version, vdew_nonambig);
+	} else {
+		version++;
+
+		len = strcspn(version, ")");
+
+		varbuf_add_buf(vb, version, len);
+	}
+}
+
+static const struct fieldinfo virtinfos[] = {
+	{ FIELD("binary:Package"), NULL, virt_package },
+	{ FIELD("binary:Summary"), NULL, virt_summary },
+	{ FIELD("db:Status-Abbrev"), NULL, virt_status_abbrev },
+	{ FIELD("db:Status-Want"), NULL, virt_status_want },
+	{ FIELD("db:Status-Status"), NULL, virt_status_status },
+	{ FIELD("db:Status-Eflag"), NULL, virt_status_eflag },
+	{ FIELD("source:Package"), NULL, virt_source_package },
+	{ FIELD("source:Version"), NULL, virt_source_version },
+	{ NULL },
+};
+
 static bool
 parsefield(struct pkg_format_node *node, const char *fmt, const char *fmtend,
            struct dpkg_error *err)
@@ -107,6 +233,12 @@ parsefield(struct pkg_format_node *node, const char *fmt, const char *fmtend,
 	memcpy(node->data, fmt, len);
 	node->data[len] = '\0';
 
+	/* Resolve the field once here, instead of for each package shown;
+	 * only arbitrary fields need to be looked up per package. */
+	node->fip = find_field_info(fieldinfos, node->data);
+	if (node->fip == NULL)
+		node->fip = find_field_info(virtinfos, node->data);
+
 	return true;
 }
 
@@ -145,6 +277,7 @@ parsestring(struct pkg_format_node *node, const char *fmt, const char *fmtend,
 		fmt++;
 	}
 	*write = '\0';
+	node->len = strlen(node->data);
 
 	return true;
 }
@@ -214,189 +347,88 @@ pkg_format_parse(const char *fmt, struct dpkg_error *err)
 	return head;
 }
 
-static void
-virt_package(struct varbuf *vb,
-             const struct pkginfo *pkg, const struct pkgbin *pkgbin,
-             enum fwriteflags flags, const struct fieldinfo *fip)
-{
-	varbuf_add_pkgbin_name(vb, pkg, pkgbin, pnaw_nonambig);
-}
-
-static void
-virt_status_abbrev(struct varbuf *vb,
-                   const struct pkginfo *pkg, const struct pkgbin *pkgbin,
-                   enum fwriteflags flags, const struct fieldinfo *fip)
-{
-	if (pkgbin != &pkg->installed)
-		return;
-
-	varbuf_add_char(vb, pkg_abbrev_want(pkg));
-	varbuf_add_char(vb, pkg_abbrev_status(pkg));
-	varbuf_add_char(vb, pkg_abbrev_eflag(pkg));
-}
-
-static void
-virt_status_want(struct varbuf *vb,
-                 const struct pkginfo *pkg, const struct pkgbin *pkgbin,
-                 enum fwriteflags flags, const struct fieldinfo *fip)
-{
-	if (pkgbin != &pkg->installed)
-		return;
-
-	varbuf_add_str(vb, pkg_want_name(pkg));
-}
-
-static void
-virt_status_status(struct varbuf *vb,
-                   const struct pkginfo *pkg, const struct pkgbin *pkgbin,
-                   enum fwriteflags flags, const struct fieldinfo *fip)
-{
-	if (pkgbin != &pkg->installed)
-		return;
-
-	varbuf_add_str(vb, pkg_status_name(pkg));
-}
-
-static void
-virt_status_eflag(struct varbuf *vb,
-                  const struct pkginfo *pkg, const struct pkgbin *pkgbin,
-                  enum fwriteflags flags, const struct fieldinfo *fip)
-{
-	if (pkgbin != &pkg->installed)
-		return;
-
-	varbuf_add_str(vb, pkg_eflag_name(pkg));
-}
-
-static void
-virt_summary(struct varbuf *vb,
-             const struct pkginfo *pkg, const struct pkgbin *pkgbin,
-             enum fwriteflags flags, const struct fieldinfo *fip)
-{
-	const char *desc;
-	int len;
-
-	desc = pkgbin_summary(pkg, pkgbin, &len);
-
-	varbuf_add_buf(vb, desc, len);
-}
-
-static void
-virt_source_package(struct varbuf *vb,
-                    const struct pkginfo *pkg, const struct pkgbin *pkgbin,
-                    enum fwriteflags flags, const struct fieldinfo *fip)
+/**
+ * Check whether a format needs fields not in the status snapshot.
+ *
+ * @param head The parsed format.
+ *
+ * @retval true If the whole status database needs to be parsed.
+ * @retval false If loading it from its snapshot is enough.
+ */
+bool
+pkg_format_needs_db_fields(const struct pkg_format_node *head)
 {
-	const char *name;
-	size_t len;
-
-	name = pkgbin->source;
-	if (name == NULL)
-		name = pkg->set->name;
+	const struct pkg_format_node *node;
 
-	len = strcspn(name, " ");
+	for (node = head; node; node = node->next) {
+		if (node->type != PKG_FORMAT_FIELD)
+			continue;
+		if (!db_snapshot_has_field(node->data))
+			return true;
+	}
 
-	varbuf_add_buf(vb, name, len);
+	return false;
 }
 
+/*
+ * Apply the node width to the item just added to vb at offset start, which
+ * is equivalent to printing it with a "%<width>s" format and truncating the
+ * result to the width, but without having to copy it around.
+ */
 static void
-virt_source_version(struct varbuf *vb,
-                    const struct pkginfo *pkg, const struct pkgbin *pkgbin,
-                    enum fwriteflags flags, const struct fieldinfo *fip)
+pkg_format_pad(struct varbuf *vb, size_t start,
+               const struct pkg_format_node *node)
 {
-	const char *version;
 	size_t len;
 
-	if (pkgbin->source)
-		version = strchr(pkgbin->source, '(');
-	else
-		version = NULL;
+	len = vb->used - start;
 
-	if (version == NULL) {
-		varbufversion(vb, &pkgbin->version, vdew_nonambig);
+	if (len >= node->width) {
+		varbuf_trunc(vb, start + node->width);
+	} else if (node->pad) {
+		varbuf_dup_char(vb, ' ', node->width - len);
 	} else {
-		version++;
-
-		len = strcspn(version, ")");
+		size_t padlen = node->width - len;
 
-		varbuf_add_buf(vb, version, len);
+		varbuf_grow(vb, padlen);
+		memmove(vb->buf + start + padlen, vb->buf + start, len);
+		memset(vb->buf + start, ' ', padlen);
+		vb->used = start + node->width;
 	}
 }
 
-static const struct fieldinfo virtinfos[] = {
-	{ FIELD("binary:Package"), NULL, virt_package },
-	{ FIELD("binary:Summary"), NULL, virt_summary },
-	{ FIELD("db:Status-Abbrev"), NULL, virt_status_abbrev },
-	{ FIELD("db:Status-Want"), NULL, virt_status_want },
-	{ FIELD("db:Status-Status"), NULL, virt_status_status },
-	{ FIELD("db:Status-Eflag"), NULL, virt_status_eflag },
-	{ FIELD("source:Package"), NULL, virt_source_package },
-	{ FIELD("source:Version"), NULL, virt_source_version },
-	{ NULL },
-};
-
 void
 pkg_format_show(const struct pkg_format_node *head,
                 struct pkginfo *pkg, struct pkgbin *pkgbin)
 {
+	/* Reused across calls, to avoid reallocating it for each package. */
+	static struct varbuf vb = VARBUF_INIT;
 	const struct pkg_format_node *node;
-	struct varbuf vb = VARBUF_INIT, fb = VARBUF_INIT, wb = VARBUF_INIT;
-
-	for (node = head; node; node = node->next) {
-		bool ok;
-		char fmt[16];
 
-		ok = false;
+	varbuf_reset(&vb);
 
-		if (node->width > 0)
-			snprintf(fmt, 16, "%%%s%zus",
-			         ((node->pad) ? "-" : ""), node->width);
-		else
-			strcpy(fmt, "%s");
+	for (node = head; node; node = node->next) {
+		size_t start = vb.used;
 
 		if (node->type == PKG_FORMAT_STRING) {
-			varbuf_printf(&fb, fmt, node->data);
-			ok = true;
+			varbuf_add_buf(&vb, node->data, node->len);
 		} else if (node->type == PKG_FORMAT_FIELD) {
-			const struct fieldinfo *fip;
-
-			fip = find_field_info(fieldinfos, node->data);
-			if (fip == NULL)
-				fip = find_field_info(virtinfos, node->data);
-
-			if (fip) {
-				fip->wcall(&wb, pkg, pkgbin, 0, fip);
-
-				varbuf_end_str(&wb);
-				varbuf_printf(&fb, fmt, wb.buf);
-				varbuf_reset(&wb);
-				ok = true;
+			if (node->fip) {
+				node->fip->wcall(&vb, pkg, pkgbin, 0, node->fip);
 			} else {
 				const struct arbitraryfield *afp;
 
 				afp = find_arbfield_info(pkgbin->arbs, node->data);
-				if (afp) {
-					varbuf_printf(&fb, fmt, afp->value);
-					ok = true;
-				}
+				if (afp == NULL)
+					continue;
+				varbuf_add_str(&vb, afp->value);
 			}
 		}
 
-		if (ok) {
-			size_t len = fb.used;
-			if ((node->width > 0) && (len > node->width))
-				len = node->width;
-			varbuf_add_buf(&vb, fb.buf, len);
-		}
-
-		varbuf_reset(&fb);
-	}
-
-	if (vb.buf) {
-		varbuf_end_str(&vb);
-		fputs(vb.buf, stdout);
+		if (node->width > 0)
+			pkg_format_pad(&vb, start, node);
 	}
 
-	varbuf_destroy(&wb);
-	varbuf_destroy(&fb);
-	varbuf_destroy(&vb);
+	if (vb.used)
+		fwrite(vb.buf, 1, vb.used, stdout);
 }
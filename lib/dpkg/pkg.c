@@ -45,6 +45,7 @@ pkg_set_status(struct pkginfo *pkg, enum pkgstatus status)
 	assert(pkg->set->installed_instances >= 0);
 
 	pkg->status = status;
+	pkg_invalidate_stanza(pkg);
 }
 
 /**
@@ -54,6 +55,7 @@ void
 pkg_set_eflags(struct pkginfo *pkg, enum pkgeflag eflag)
 {
 	pkg->eflag |= eflag;
+	pkg_invalidate_stanza(pkg);
 }
 
 /**
@@ -63,6 +65,7 @@ void
 pkg_clear_eflags(struct pkginfo *pkg, enum pkgeflag eflag)
 {
 	pkg->eflag &= ~eflag;
+	pkg_invalidate_stanza(pkg);
 }
 
 /**
@@ -72,6 +75,7 @@ void
 pkg_reset_eflags(struct pkginfo *pkg)
 {
 	pkg->eflag = PKG_EFLAG_OK;
+	pkg_invalidate_stanza(pkg);
 }
 
 /**
@@ -81,6 +85,7 @@ void
 pkg_copy_eflags(struct pkginfo *pkg_dst, struct pkginfo *pkg_src)
 {
 	pkg_dst->eflag = pkg_src->eflag;
+	pkg_invalidate_stanza(pkg_dst);
 }
 
 /**
@@ -90,6 +95,21 @@ void
 pkg_set_want(struct pkginfo *pkg, enum pkgwant want)
 {
 	pkg->want = want;
+	pkg_invalidate_stanza(pkg);
+}
+
+/**
+ * Invalidate the status database stanza cached for the package.
+ *
+ * The setters and modstatdb_note() take care of this, but anything else
+ * modifying the package without noting it needs to call this, otherwise
+ * the next status database dump will contain outdated information.
+ */
+void
+pkg_invalidate_stanza(struct pkginfo *pkg)
+{
+	pkg->stanza = NULL;
+	pkg->stanza_len = 0;
 }
 
 void
@@ -107,6 +127,7 @@ pkgbin_blank(struct pkgbin *pkgbin)
 	dpkg_version_blank(&pkgbin->version);
 	pkgbin->conffiles = NULL;
 	pkgbin->arbs = NULL;
+	pkgbin->lazyfields = NULL;
 }
 
 void
@@ -125,6 +146,8 @@ pkg_blank(struct pkginfo *pkg)
 	pkg->trigaw.tail = NULL;
 	pkg->othertrigaw_head = NULL;
 	pkg->trigpend_head = NULL;
+	pkg->stanza = NULL;
+	pkg->stanza_len = 0;
 	pkgbin_blank(&pkg->installed);
 	pkgbin_blank(&pkg->available);
 
@@ -193,7 +216,9 @@ pkg_is_informative(struct pkginfo *pkg, struct pkgbin *pkgbin)
 	     dpkg_version_is_informative(&pkg->configversion)))
 		return true;
 
+	/* Any deferred field is a non-empty dependency field. */
 	if (pkgbin->depends ||
+	    pkgbin->lazyfields ||
 	    str_is_set(pkgbin->description) ||
 	    str_is_set(pkgbin->maintainer) ||
 	    str_is_set(pkgbin->origin) ||
@@ -42,6 +42,7 @@ void pkg_clear_eflags(struct pkginfo *pkg, enum pkgeflag eflag);
 void pkg_reset_eflags(struct pkginfo *pkg);
 void pkg_copy_eflags(struct pkginfo *pkg_dst, struct pkginfo *pkg_src);
 void pkg_set_want(struct pkginfo *pkg, enum pkgwant want);
+void pkg_invalidate_stanza(struct pkginfo *pkg);
 
 /** @} */
 
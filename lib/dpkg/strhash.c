@@ -21,6 +21,7 @@
 #include <config.h>
 #include <compat.h>
 
+#include <dpkg/c-ctype.h>
 #include <dpkg/string.h>
 
 #define FNV_OFFSET_BASIS 2166136261UL
@@ -48,3 +49,27 @@ str_fnv_hash(const char *str)
 
 	return h;
 }
+
+/**
+ * Fowler/Noll/Vo -- FNV-1a simple string hash, on the lowercase string.
+ *
+ * This is equivalent to hashing the string after lowercasing it, without
+ * needing a copy to do so.
+ *
+ * @param str The string to hash.
+ *
+ * @return The hashed value.
+ */
+unsigned int
+str_fnv_hash_lower(const char *str)
+{
+	register unsigned int h = FNV_OFFSET_BASIS;
+	register unsigned int p = FNV_MIXING_PRIME;
+
+	while (*str) {
+		h ^= c_tolower(*str++);
+		h *= p;
+	}
+
+	return h;
+}
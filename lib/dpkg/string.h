@@ -55,6 +55,7 @@ str_is_set(const char *str)
 bool str_match_end(const char *str, const char *end);
 
 unsigned int str_fnv_hash(const char *str);
+unsigned int str_fnv_hash_lower(const char *str);
 
 char *str_fmt(const char *fmt, ...) DPKG_ATTR_PRINTF(1);
 char *str_escape_fmt(char *dest, const char *src, size_t n);
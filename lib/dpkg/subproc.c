@@ -118,7 +118,7 @@ subproc_fork(void)
 	return pid;
 }
 
-static int
+int
 subproc_check(int status, const char *desc, enum subproc_flags flags)
 {
 	void (*out)(const char *fmt, ...) DPKG_ATTR_PRINTF(1);
@@ -163,7 +163,7 @@ subproc_check(int status, const char *desc, enum subproc_flags flags)
 	return -1;
 }
 
-static int
+int
 subproc_wait(pid_t pid, const char *desc)
 {
 	pid_t dead_pid;
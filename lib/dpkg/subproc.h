@@ -53,6 +53,8 @@ void subproc_signals_cleanup(int argc, void **argv);
 void subproc_signals_restore(void);
 
 pid_t subproc_fork(void);
+int subproc_wait(pid_t pid, const char *desc);
+int subproc_check(int status, const char *desc, enum subproc_flags flags);
 int subproc_reap(pid_t pid, const char *desc, enum subproc_flags flags);
 
 /** @} */
@@ -0,0 +1,262 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * b-buffer.c - benchmark buffer and compressor handling
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/stat.h>
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/bench.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/varbuf.h>
+#include <dpkg/buffer.h>
+#include <dpkg/compress.h>
+
+#define BENCH_DATA "bench.tmp/buffer-data"
+#define BENCH_COPY "bench.tmp/buffer-copy"
+#define BENCH_COMPRESSED "bench.tmp/buffer-compressed"
+
+/*
+ * Generate size bytes of text, which compresses about as well as the
+ * contents of a typical package.
+ */
+static void
+gen_data(const char *filename, off_t size)
+{
+	FILE *fp;
+	off_t used = 0;
+	unsigned long n = 1;
+
+	fp = fopen(filename, "w");
+	if (fp == NULL)
+		ohshite("cannot create %s", filename);
+
+	while (used < size) {
+		int len;
+
+		n = n * 1103515245 + 12345;
+		len = fprintf(fp, "%08lx line %lu of the benchmark data, "
+		                  "with some repeated text.\n",
+		              n / 65536, n % 1000);
+		if (len < 0)
+			ohshite("cannot write %s", filename);
+		used += len;
+	}
+
+	if (fclose(fp))
+		ohshite("cannot close %s", filename);
+	if (truncate(filename, size) < 0)
+		ohshite("cannot truncate %s", filename);
+}
+
+static int
+bench_open(const char *filename, int flags)
+{
+	int fd;
+
+	fd = open(filename, flags, 0644);
+	if (fd < 0)
+		ohshite("cannot open %s", filename);
+
+	return fd;
+}
+
+static void
+bench_copy(off_t size, long nrounds)
+{
+	struct bench b;
+	struct dpkg_error err;
+	char hash[MD5HASHLEN + 1];
+	long r;
+	int fd_in, fd_out;
+
+	bench_start(&b, "fd_fd_copy");
+	for (r = 0; r < nrounds; r++) {
+		fd_in = bench_open(BENCH_DATA, O_RDONLY);
+		fd_out = bench_open(BENCH_COPY, O_WRONLY | O_CREAT | O_TRUNC);
+		if (fd_fd_copy(fd_in, fd_out, -1, &err) < 0)
+			ohshit("cannot copy data: %s", err.str);
+		close(fd_in);
+		close(fd_out);
+	}
+	bench_stop(&b, nrounds, (long long)size * nrounds);
+
+	bench_start(&b, "fd_md5");
+	for (r = 0; r < nrounds; r++) {
+		fd_in = bench_open(BENCH_DATA, O_RDONLY);
+		if (fd_md5(fd_in, hash, -1, &err) < 0)
+			ohshit("cannot digest data: %s", err.str);
+		close(fd_in);
+	}
+	bench_stop(&b, nrounds, (long long)size * nrounds);
+
+	bench_start(&b, "fd_fd_copy_and_md5");
+	for (r = 0; r < nrounds; r++) {
+		fd_in = bench_open(BENCH_DATA, O_RDONLY);
+		fd_out = bench_open(BENCH_COPY, O_WRONLY | O_CREAT | O_TRUNC);
+		if (fd_fd_copy_and_md5(fd_in, fd_out, hash, -1, &err) < 0)
+			ohshit("cannot copy and digest data: %s", err.str);
+		close(fd_in);
+		close(fd_out);
+	}
+	bench_stop(&b, nrounds, (long long)size * nrounds);
+
+	unlink(BENCH_COPY);
+}
+
+/*
+ * The compressors not built into libdpkg are run as commands, which might
+ * not be available.
+ */
+static bool
+compressor_available(enum compressor_type type)
+{
+	struct varbuf cmd = VARBUF_INIT;
+	const char *path;
+	const char *name;
+	bool found = false;
+
+	switch (type) {
+	case COMPRESSOR_TYPE_NONE:
+		return true;
+#ifdef WITH_ZLIB
+	case COMPRESSOR_TYPE_GZIP:
+		return true;
+#endif
+#ifdef WITH_LIBLZMA
+	case COMPRESSOR_TYPE_XZ:
+		return true;
+#endif
+#ifdef WITH_BZ2
+	case COMPRESSOR_TYPE_BZIP2:
+		return true;
+#endif
+	default:
+		break;
+	}
+
+	name = compressor_get_name(type);
+	path = getenv("PATH");
+	if (path == NULL)
+		return false;
+
+	while (!found && path) {
+		const char *path_end;
+		size_t path_len;
+
+		path_end = strchr(path, ':');
+		if (path_end)
+			path_len = path_end - path;
+		else
+			path_len = strlen(path);
+
+		varbuf_reset(&cmd);
+		varbuf_add_buf(&cmd, path, path_len);
+		varbuf_add_char(&cmd, '/');
+		varbuf_add_str(&cmd, name);
+		varbuf_end_str(&cmd);
+
+		found = access(cmd.buf, X_OK) == 0;
+
+		path = path_end ? path_end + 1 : NULL;
+	}
+
+	varbuf_destroy(&cmd);
+
+	return found;
+}
+
+static void
+bench_compressor(enum compressor_type type, off_t size, long nrounds)
+{
+	struct compress_params params;
+	struct dpkg_error err;
+	struct varbuf name = VARBUF_INIT;
+	struct bench b;
+	long r;
+	int fd_in, fd_out;
+
+	if (!compressor_available(type)) {
+		printf("# compressor %s not available, skipped\n",
+		       compressor_get_name(type));
+		return;
+	}
+
+	params.type = type;
+	params.strategy = COMPRESSOR_STRATEGY_NONE;
+	params.level = -1;
+	if (!compressor_check_params(&params, &err))
+		ohshit("invalid compressor parameters: %s", err.str);
+
+	varbuf_printf(&name, "compress %s", compressor_get_name(type));
+	bench_start(&b, name.buf);
+	for (r = 0; r < nrounds; r++) {
+		fd_in = bench_open(BENCH_DATA, O_RDONLY);
+		fd_out = bench_open(BENCH_COMPRESSED,
+		                    O_WRONLY | O_CREAT | O_TRUNC);
+		compress_filter(&params, fd_in, fd_out, "compressing data");
+		close(fd_in);
+		close(fd_out);
+	}
+	bench_stop(&b, nrounds, (long long)size * nrounds);
+
+	varbuf_reset(&name);
+	varbuf_printf(&name, "decompress %s", compressor_get_name(type));
+	bench_start(&b, name.buf);
+	for (r = 0; r < nrounds; r++) {
+		fd_in = bench_open(BENCH_COMPRESSED, O_RDONLY);
+		fd_out = bench_open("/dev/null", O_WRONLY);
+		decompress_filter(type, fd_in, fd_out, "decompressing data");
+		close(fd_in);
+		close(fd_out);
+	}
+	bench_stop(&b, nrounds, (long long)size * nrounds);
+
+	varbuf_destroy(&name);
+	unlink(BENCH_COMPRESSED);
+}
+
+static void
+bench(void)
+{
+	off_t size;
+	long nrounds;
+
+	nrounds = bench_param("DPKG_BENCH_ROUNDS", 5);
+
+	size = bench_param("DPKG_BENCH_SIZE", 64) * 1024 * 1024;
+	gen_data(BENCH_DATA, size);
+	bench_copy(size, nrounds);
+
+	/* The compressors are way slower, so use a smaller data set. */
+	nrounds = bench_param("DPKG_BENCH_COMPRESS_ROUNDS", 1);
+	size = bench_param("DPKG_BENCH_COMPRESS_SIZE", 4) * 1024 * 1024;
+	gen_data(BENCH_DATA, size);
+	bench_compressor(COMPRESSOR_TYPE_NONE, size, nrounds);
+	bench_compressor(COMPRESSOR_TYPE_GZIP, size, nrounds);
+	bench_compressor(COMPRESSOR_TYPE_XZ, size, nrounds);
+	bench_compressor(COMPRESSOR_TYPE_BZIP2, size, nrounds);
+
+	unlink(BENCH_DATA);
+}
@@ -0,0 +1,180 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * b-pkgdb.c - benchmark package database handling
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/stat.h>
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/bench.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/pkg.h>
+
+#define BENCH_STATUS "bench.tmp/pkgdb-status"
+
+/*
+ * Generate a status file with npkgs installed packages, with the fields
+ * and relationships found on a typical system.
+ */
+static off_t
+gen_status(const char *filename, int npkgs)
+{
+	struct stat st;
+	FILE *fp;
+	int i;
+
+	fp = fopen(filename, "w");
+	if (fp == NULL)
+		ohshite("cannot create %s", filename);
+
+	for (i = 0; i < npkgs; i++) {
+		bool lib = i % 3 == 0;
+
+		fprintf(fp, "Package: %s%05d\n", lib ? "lib" : "pkg-", i);
+		fprintf(fp, "Status: install ok installed\n");
+		fprintf(fp, "Priority: optional\n");
+		fprintf(fp, "Section: %s\n", lib ? "libs" : "utils");
+		fprintf(fp, "Installed-Size: %d\n", 100 + i * 7 % 5000);
+		fprintf(fp, "Maintainer: Dpkg Developers "
+		            "<debian-dpkg@lists.debian.org>\n");
+		fprintf(fp, "Architecture: %s\n",
+		        lib || i % 5 ? "amd64" : "all");
+		if (lib)
+			fprintf(fp, "Multi-Arch: same\n");
+		fprintf(fp, "Source: src%05d (%d.%d-%d)\n", i / 2,
+		        i % 4, i % 10, i % 3 + 1);
+		fprintf(fp, "Version: %d:%d.%d.%d-%dubuntu%d\n", i % 2,
+		        i % 4, i % 10, i % 100, i % 3 + 1, i % 2 + 1);
+		if (i > 3) {
+			fprintf(fp, "Depends: lib%05d (>= %d.%d), "
+			            "lib%05d (>= 1:%d.0~), pkg-%05d | pkg-%05d\n",
+			        (i - 1) / 3 * 3, i % 4, i % 10,
+			        (i - 3) / 3 * 3, i % 3, i - 2, i - 1);
+			fprintf(fp, "Pre-Depends: lib%05d (>= 2.%d)\n",
+			        (i / 2) / 3 * 3, i % 17);
+			fprintf(fp, "Breaks: pkg-%05d (<< %d.%d)\n",
+			        i - 4, i % 4, i % 10);
+			fprintf(fp, "Recommends: pkg-%05d, pkg-%05d\n",
+			        i - 2, i - 3);
+		}
+		if (i % 10 == 0) {
+			fprintf(fp, "Conffiles:\n");
+			fprintf(fp, " /etc/pkg-%05d/config "
+			            "0123456789abcdef0123456789abcdef\n", i);
+			fprintf(fp, " /etc/pkg-%05d/defaults "
+			            "fedcba9876543210fedcba9876543210\n", i);
+		}
+		fprintf(fp, "Description: synthetic package %d\n", i);
+		fprintf(fp, " This is a synthetic package used to benchmark the\n"
+		            " parsing and dumping of the package database.\n"
+		            " .\n"
+		            " It has a multi-line description, as most do.\n");
+		if (i % 4 == 0)
+			fprintf(fp, "Homepage: https://www.example.org/%d/\n", i);
+		fprintf(fp, "\n");
+	}
+
+	if (fclose(fp))
+		ohshite("cannot close %s", filename);
+
+	if (stat(filename, &st) < 0)
+		ohshite("cannot stat %s", filename);
+
+	return st.st_size;
+}
+
+static void
+invalidate_stanzas(void)
+{
+	struct pkgiterator *iter;
+	struct pkginfo *pkg;
+
+	iter = pkg_db_iter_new();
+	while ((pkg = pkg_db_iter_next_pkg(iter)))
+		pkg_invalidate_stanza(pkg);
+	pkg_db_iter_free(iter);
+}
+
+static void
+bench(void)
+{
+	struct bench b;
+	off_t size;
+	long npkgs, nrounds;
+	long r, i, ops;
+
+	npkgs = bench_param("DPKG_BENCH_PACKAGES", 5000);
+	nrounds = bench_param("DPKG_BENCH_ROUNDS", 10);
+
+	size = gen_status(BENCH_STATUS, npkgs);
+
+	bench_start(&b, "parsedb");
+	for (r = 0; r < nrounds; r++) {
+		pkg_db_reset();
+		if (parsedb(BENCH_STATUS, pdb_parse_status, NULL) != npkgs)
+			bench_bail("unexpected number of parsed packages");
+	}
+	bench_stop(&b, npkgs * nrounds, (long long)size * nrounds);
+
+	bench_start(&b, "parsedb lazy");
+	for (r = 0; r < nrounds; r++) {
+		pkg_db_reset();
+		if (parsedb(BENCH_STATUS, pdb_parse_status | pdb_lazy_fields,
+		            NULL) != npkgs)
+			bench_bail("unexpected number of parsed packages");
+	}
+	bench_stop(&b, npkgs * nrounds, (long long)size * nrounds);
+
+	/* Get the dependencies decoded again, for the benchmarks below. */
+	pkg_db_reset();
+	parsedb(BENCH_STATUS, pdb_parse_status, NULL);
+
+	bench_start(&b, "pkg_db_find_set");
+	ops = 0;
+	for (r = 0; r < nrounds * 10; r++) {
+		for (i = 0; i < npkgs; i++) {
+			char name[32];
+
+			sprintf(name, "%s%05ld", i % 3 == 0 ? "lib" : "pkg-", i);
+			pkg_db_find_set(name);
+			ops++;
+		}
+	}
+	bench_stop(&b, ops, 0);
+
+	bench_start(&b, "writedb");
+	for (r = 0; r < nrounds; r++) {
+		invalidate_stanzas();
+		writedb(BENCH_STATUS, 0);
+	}
+	bench_stop(&b, npkgs * nrounds, (long long)size * nrounds);
+
+	bench_start(&b, "writedb cached");
+	for (r = 0; r < nrounds; r++)
+		writedb(BENCH_STATUS, 0);
+	bench_stop(&b, npkgs * nrounds, (long long)size * nrounds);
+
+	pkg_db_reset();
+	unlink(BENCH_STATUS);
+	unlink(BENCH_STATUS "-old");
+}
@@ -0,0 +1,205 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * b-tar.c - benchmark tar extraction
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/bench.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/fdio.h>
+#include <dpkg/buffer.h>
+#include <dpkg/tarfn.h>
+
+#define BENCH_TAR "bench.tmp/tar-stream"
+
+#define TARBLKSZ 512
+
+struct tar_context {
+	int tar_fd;
+	long nentries;
+};
+
+static void
+gen_tar_header(FILE *fp, const char *name, char type, off_t size,
+               const char *linkname)
+{
+	char block[TARBLKSZ];
+	unsigned int checksum = 0;
+	int i;
+
+	memset(block, 0, sizeof(block));
+	strncpy(block, name, 100);
+	sprintf(block + 100, "%07o", type == '5' ? 0755 : 0644);
+	sprintf(block + 108, "%07o", 0);
+	sprintf(block + 116, "%07o", 0);
+	sprintf(block + 124, "%011jo", (intmax_t)size);
+	sprintf(block + 136, "%011o", 1420070400);
+	memset(block + 148, ' ', 8);
+	block[156] = type;
+	if (linkname)
+		strncpy(block + 157, linkname, 100);
+	memcpy(block + 257, "ustar\0" "00", 8);
+	strcpy(block + 265, "root");
+	strcpy(block + 297, "root");
+
+	for (i = 0; i < TARBLKSZ; i++)
+		checksum += (unsigned char)block[i];
+	sprintf(block + 148, "%06o", checksum);
+
+	fwrite(block, 1, sizeof(block), fp);
+}
+
+/*
+ * Generate a tar stream with nentries objects, laid out as in the data
+ * member of a typical package: directories with a batch of regular files
+ * of varying sizes each, and some symlinks.
+ */
+static off_t
+gen_tar(const char *filename, long nentries)
+{
+	static char data[64 * 1024];
+	char name[100];
+	struct stat st;
+	FILE *fp;
+	long i;
+
+	fp = fopen(filename, "w");
+	if (fp == NULL)
+		ohshite("cannot create %s", filename);
+
+	memset(data, 'x', sizeof(data));
+
+	for (i = 0; i < nentries; i++) {
+		if (i % 50 == 0) {
+			sprintf(name, "./usr/share/bench/d%05ld/", i / 50);
+			gen_tar_header(fp, name, '5', 0, NULL);
+		} else if (i % 20 == 0) {
+			sprintf(name, "./usr/share/bench/d%05ld/l%05ld",
+			        i / 50, i);
+			gen_tar_header(fp, name, '2', 0, "f00001");
+		} else {
+			off_t size = (i * 1237) % (i % 10 ? 8192 : 65536);
+
+			sprintf(name, "./usr/share/bench/d%05ld/f%05ld",
+			        i / 50, i);
+			gen_tar_header(fp, name, '0', size, NULL);
+			fwrite(data, 1, size, fp);
+			if (size % TARBLKSZ)
+				fwrite(data, 1, TARBLKSZ - size % TARBLKSZ, fp);
+		}
+	}
+
+	/* The end of archive marker. */
+	memset(data, 0, TARBLKSZ * 2);
+	fwrite(data, 1, TARBLKSZ * 2, fp);
+
+	if (fclose(fp))
+		ohshite("cannot close %s", filename);
+
+	if (stat(filename, &st) < 0)
+		ohshite("cannot stat %s", filename);
+
+	return st.st_size;
+}
+
+static int
+tar_read(void *ctx, char *buffer, int size)
+{
+	struct tar_context *tc = ctx;
+
+	return fd_read(tc->tar_fd, buffer, size);
+}
+
+static int
+tar_object(void *ctx, struct tar_entry *te)
+{
+	struct tar_context *tc = ctx;
+
+	tc->nentries++;
+
+	return 0;
+}
+
+static int
+tar_file(void *ctx, struct tar_entry *te)
+{
+	struct tar_context *tc = ctx;
+	struct dpkg_error err;
+	off_t size;
+
+	tc->nentries++;
+
+	/* Consume the file contents, as the extractor leaves that to us. */
+	size = te->size;
+	if (size % TARBLKSZ)
+		size += TARBLKSZ - size % TARBLKSZ;
+	if (fd_skip(tc->tar_fd, size, &err) < 0)
+		ohshit("cannot skip file contents: %s", err.str);
+
+	return 0;
+}
+
+static const struct tar_operations tar_ops = {
+	.read = tar_read,
+	.extract_file = tar_file,
+	.link = tar_object,
+	.symlink = tar_object,
+	.mkdir = tar_object,
+	.mknod = tar_object,
+};
+
+static void
+bench(void)
+{
+	struct bench b;
+	struct tar_context tc;
+	long nentries, nrounds, r;
+	off_t size;
+
+	nentries = bench_param("DPKG_BENCH_ENTRIES", 20000);
+	nrounds = bench_param("DPKG_BENCH_ROUNDS", 5);
+
+	size = gen_tar(BENCH_TAR, nentries);
+
+	bench_start(&b, "tar_extractor");
+	for (r = 0; r < nrounds; r++) {
+		tc.tar_fd = open(BENCH_TAR, O_RDONLY);
+		if (tc.tar_fd < 0)
+			ohshite("cannot open %s", BENCH_TAR);
+		tc.nentries = 0;
+
+		if (tar_extractor(&tc, &tar_ops))
+			ohshite("cannot extract tar stream");
+		if (tc.nentries != nentries)
+			bench_bail("unexpected number of tar entries");
+
+		close(tc.tar_fd);
+	}
+	bench_stop(&b, nentries * nrounds, (long long)size * nrounds);
+
+	unlink(BENCH_TAR);
+}
@@ -0,0 +1,156 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * b-version.c - benchmark version handling
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/bench.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/dpkg-db.h>
+
+static unsigned long rand_state = 1;
+
+static unsigned long
+rand_next(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+
+	return (rand_state / 65536) % 32768;
+}
+
+/* Generate a version in one of the shapes commonly found in the archive. */
+static void
+gen_version(char *buf, size_t len)
+{
+	static const char *const suffixes[] = {
+		"", "", "", "~rc1", "~beta2", "+dfsg", "+git20150102",
+		"a", ".is.1.0", "~",
+	};
+	static const char *const revisions[] = {
+		"", "-1", "-2", "-1ubuntu1", "-0.1", "-3+deb8u1", "-1~bpo8+1",
+	};
+	char epoch[8] = "";
+
+	if (rand_next() % 8 == 0)
+		snprintf(epoch, sizeof(epoch), "%lu:", rand_next() % 3 + 1);
+
+	snprintf(buf, len, "%s%lu.%lu.%lu%s%s", epoch,
+	         rand_next() % 4, rand_next() % 20, rand_next() % 100,
+	         suffixes[rand_next() % array_count(suffixes)],
+	         revisions[rand_next() % array_count(revisions)]);
+}
+
+static void
+bench(void)
+{
+	struct bench b;
+	struct dpkg_version *versions, *unkeyed;
+	struct dpkg_version **sorted;
+	char **strings;
+	long nversions, nrounds;
+	long i, r, ops;
+	int sum = 0;
+
+	nversions = bench_param("DPKG_BENCH_VERSIONS", 100000);
+	nrounds = bench_param("DPKG_BENCH_ROUNDS", 100);
+
+	strings = m_malloc(sizeof(*strings) * nversions);
+	versions = m_malloc(sizeof(*versions) * nversions);
+	unkeyed = m_malloc(sizeof(*unkeyed) * nversions);
+	sorted = m_malloc(sizeof(*sorted) * nversions);
+
+	for (i = 0; i < nversions; i++) {
+		char buf[64];
+
+		gen_version(buf, sizeof(buf));
+		strings[i] = m_strdup(buf);
+	}
+
+	bench_start(&b, "parseversion");
+	for (i = 0; i < nversions; i++) {
+		struct dpkg_error err;
+
+		if (parseversion(&versions[i], strings[i], &err) < 0)
+			ohshit("cannot parse version '%s': %s",
+			       strings[i], err.str);
+	}
+	bench_stop(&b, nversions, 0);
+
+	bench_start(&b, "dpkg_version_compare");
+	ops = 0;
+	for (r = 0; r < nrounds; r++) {
+		for (i = 1; i < nversions; i++) {
+			sum += dpkg_version_compare(&versions[i - 1],
+			                            &versions[i]) > 0;
+			ops++;
+		}
+	}
+	bench_stop(&b, ops, 0);
+
+	for (i = 0; i < nversions; i++) {
+		unkeyed[i] = versions[i];
+		unkeyed[i].key = NULL;
+	}
+
+	bench_start(&b, "dpkg_version_compare unkeyed");
+	ops = 0;
+	for (r = 0; r < nrounds; r++) {
+		for (i = 1; i < nversions; i++) {
+			sum += dpkg_version_compare(&unkeyed[i - 1],
+			                            &unkeyed[i]) > 0;
+			ops++;
+		}
+	}
+	bench_stop(&b, ops, 0);
+
+	bench_start(&b, "dpkg_version_relate");
+	ops = 0;
+	for (r = 0; r < nrounds; r++) {
+		for (i = 1; i < nversions; i++) {
+			sum += dpkg_version_relate(&versions[i - 1],
+			                           DPKG_RELATION_GE,
+			                           &versions[i]);
+			ops++;
+		}
+	}
+	bench_stop(&b, ops, 0);
+
+	bench_start(&b, "dpkg_version_sort");
+	ops = 0;
+	for (r = 0; r < nrounds / 10 + 1; r++) {
+		for (i = 0; i < nversions; i++)
+			sorted[i] = &versions[i];
+		dpkg_version_sort(sorted, nversions);
+		ops += nversions;
+	}
+	bench_stop(&b, ops, 0);
+
+	/* Use the result, so that the comparisons cannot be optimized out. */
+	if (sum < 0)
+		bench_bail("impossible comparison result");
+
+	for (i = 0; i < nversions; i++)
+		free(strings[i]);
+	free(strings);
+	free(versions);
+	free(unkeyed);
+	free(sorted);
+}
@@ -0,0 +1,57 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * db-test.h - package database test suite support
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBDPKG_DB_TEST_H
+#define LIBDPKG_DB_TEST_H
+
+#include <string.h>
+#include <unistd.h>
+
+#include <dpkg/test.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/fdio.h>
+#include <dpkg/parsedump.h>
+
+/**
+ * Parse database stanzas from a string into the selected package database.
+ *
+ * @param filename The name to use for the database in parse errors.
+ * @param data The stanzas to parse.
+ * @param flags The parsedb() flags.
+ */
+static void
+test_parsedb_string(const char *filename, const char *data,
+                    enum parsedbflags flags)
+{
+	struct parsedb_state *ps;
+	int fd[2];
+
+	if (pipe(fd) < 0)
+		test_bail("cannot create pipe");
+	if (fd_write(fd[1], data, strlen(data)) < 0)
+		test_bail("cannot write to pipe");
+	close(fd[1]);
+
+	ps = parsedb_new(filename, fd[0], flags);
+	parsedb_load(ps);
+	parsedb_parse(ps, NULL);
+	parsedb_close(ps);
+	close(fd[0]);
+}
+
+#endif
@@ -71,11 +71,43 @@ test_fdio_hash(void)
 	test_pass(unlink(test_file) == 0);
 }
 
+static void
+test_fdio_copy(void)
+{
+	char hash[MD5HASHLEN + 1];
+	char *src_file, *dst_file;
+	int fd_src, fd_dst;
+
+	src_file = test_alloc(strdup("test.XXXXXX"));
+	fd_src = mkstemp(src_file);
+	test_pass(fd_src >= 0);
+	dst_file = test_alloc(strdup("test.XXXXXX"));
+	fd_dst = mkstemp(dst_file);
+	test_pass(fd_dst >= 0);
+
+	test_pass(write(fd_src, str_test, strlen(str_test)) == strlen(str_test));
+	test_pass(lseek(fd_src, 0, SEEK_SET) == 0);
+
+	/* Copy with a limit, and then the rest up to end of file. */
+	test_pass(fd_fd_copy(fd_src, fd_dst, 4, NULL) == 4);
+	test_pass(fd_fd_copy(fd_src, fd_dst, -1, NULL) ==
+	          (off_t)strlen(str_test) - 4);
+	test_pass(fd_fd_copy(fd_src, fd_dst, 1, NULL) < 0);
+
+	test_pass(lseek(fd_dst, 0, SEEK_SET) == 0);
+	test_pass(fd_md5(fd_dst, hash, -1, NULL) >= 0);
+	test_str(hash, ==, ref_hash_test);
+
+	test_pass(unlink(src_file) == 0);
+	test_pass(unlink(dst_file) == 0);
+}
+
 static void
 test(void)
 {
-	test_plan(10);
+	test_plan(22);
 
 	test_buffer_hash();
 	test_fdio_hash();
+	test_fdio_copy();
 }
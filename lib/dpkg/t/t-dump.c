@@ -0,0 +1,158 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * t-dump.c - test status database dumping
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <dpkg/test.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/pkg.h>
+#include <dpkg/buffer.h>
+#include <dpkg/varbuf.h>
+#include <dpkg/parsedump.h>
+#include <dpkg/triglib.h>
+
+#include "db-test.h"
+
+#define TEST_STATUS_FILE "t-dump.status"
+
+static const char status[] =
+	"Package: pkg-a\n"
+	"Status: install ok installed\n"
+	"Version: 1.0\n"
+	"Architecture: all\n"
+	"Maintainer: dummy\n"
+	"Conffiles:\n"
+	" /etc/pkg-a.conf 00000000000000000000000000000000\n"
+	"Description: dummy\n"
+	"\n"
+	"Package: pkg-b\n"
+	"Status: install ok installed\n"
+	"Version: 1.0\n"
+	"Architecture: all\n"
+	"Maintainer: dummy\n"
+	"Depends: pkg-a\n"
+	"Description: dummy\n"
+	"\n"
+	"Package: pkg-c\n"
+	"Status: install ok installed\n"
+	"Version: 1.0\n"
+	"Architecture: all\n"
+	"Maintainer: dummy\n"
+	"Description: dummy\n"
+	"\n";
+
+static const char update[] =
+	"Package: pkg-b\n"
+	"Status: install ok installed\n"
+	"Version: 2.0\n"
+	"Architecture: all\n"
+	"Maintainer: dummy\n"
+	"Description: dummy\n";
+
+/* Check the written status file against a dump ignoring the cache. */
+static void
+test_writedb(void)
+{
+	struct varbuf vb = VARBUF_INIT;
+	struct varbuf ref = VARBUF_INIT;
+	struct dpkg_error err;
+	struct pkgiterator *iter;
+	struct pkginfo *pkg;
+	int fd;
+
+	writedb(TEST_STATUS_FILE, 0);
+
+	fd = open(TEST_STATUS_FILE, O_RDONLY);
+	if (fd < 0 || fd_vbuf_copy(fd, &vb, -1, &err) < 0)
+		test_bail("cannot read " TEST_STATUS_FILE);
+	close(fd);
+	varbuf_end_str(&vb);
+
+	iter = pkg_db_iter_new();
+	while ((pkg = pkg_db_iter_next_pkg(iter))) {
+		if (!pkg_is_informative(pkg, &pkg->installed))
+			continue;
+		varbufrecord(&ref, pkg, &pkg->installed);
+		varbuf_add_char(&ref, '\n');
+	}
+	pkg_db_iter_free(iter);
+	varbuf_end_str(&ref);
+
+	test_str(vb.buf, ==, ref.buf);
+
+	varbuf_destroy(&vb);
+	varbuf_destroy(&ref);
+}
+
+static void
+test_writedb_cache(void)
+{
+	struct pkginfo *pkg_a, *pkg_b, *pkg_c;
+
+	test_parsedb_string("status", status, pdb_parse_status);
+	pkg_a = pkg_db_find_singleton("pkg-a");
+	pkg_b = pkg_db_find_singleton("pkg-b");
+	pkg_c = pkg_db_find_singleton("pkg-c");
+
+	test_writedb();
+	test_pass(pkg_a->stanza != NULL);
+	test_pass(pkg_b->stanza != NULL);
+	test_pass(pkg_c->stanza != NULL);
+
+	/* Unchanged packages keep their cached stanza. */
+	test_writedb();
+
+	pkg_set_want(pkg_b, PKG_WANT_HOLD);
+	pkg_set_eflags(pkg_b, PKG_EFLAG_REINSTREQ);
+	test_pass(pkg_b->stanza == NULL);
+	test_pass(pkg_a->stanza != NULL);
+	test_writedb();
+
+	pkg_set_status(pkg_a, PKG_STAT_HALFCONFIGURED);
+	test_writedb();
+
+	trig_note_pend(pkg_c, "some-trigger");
+	trig_note_aw(pkg_c, pkg_a);
+	pkg_set_status(pkg_a, PKG_STAT_TRIGGERSAWAITED);
+	test_writedb();
+
+	/* Changes done directly on the package need to invalidate it. */
+	pkg_a->installed.conffiles->obsolete = true;
+	pkg_invalidate_stanza(pkg_a);
+	test_writedb();
+
+	test_parsedb_string("update", update, pdb_parse_update);
+	test_str(pkg_b->installed.version.version, ==, "2.0");
+	test_writedb();
+
+	test_pass(unlink(TEST_STATUS_FILE) == 0);
+	test_pass(unlink(TEST_STATUS_FILE "-old") == 0);
+}
+
+static void
+test(void)
+{
+	test_plan(15);
+
+	test_writedb_cache();
+}
@@ -0,0 +1,289 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * t-parse-lazy.c - test deferred decoding of package fields
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <dpkg/test.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/varbuf.h>
+#include <dpkg/parsedump.h>
+
+#include "db-test.h"
+
+static const char status[] =
+	"Package: pkg-a\n"
+	"Status: install ok installed\n"
+	"Version: 1.0\n"
+	"Architecture: all\n"
+	"Pre-Depends: pkg-c (>= 2:1.0-1)\n"
+	"Depends: pkg-b (>= 1.0), pkg-c | pkg-d:any (<< 3), pkg-virt\n"
+	"Recommends: pkg-e\n"
+	"Conflicts: pkg-old (<= 0.9)\n"
+	"Maintainer: dummy\n"
+	"Description: dummy\n"
+	"\n"
+	"Package: pkg-b\n"
+	"Status: install ok installed\n"
+	"Version: 1.0\n"
+	"Architecture: amd64\n"
+	"Multi-Arch: same\n"
+	"Provides: pkg-virt\n"
+	"Breaks: pkg-a (<< 1.0)\n"
+	"Maintainer: dummy\n"
+	"Description: dummy\n"
+	"\n"
+	"Package: pkg-b\n"
+	"Status: install ok installed\n"
+	"Version: 1.0\n"
+	"Architecture: i386\n"
+	"Multi-Arch: same\n"
+	"Provides: pkg-virt\n"
+	"Depends: pkg-c:native\n"
+	"Maintainer: dummy\n"
+	"Description: dummy\n"
+	"\n"
+	"Package: pkg-c\n"
+	"Status: install ok unpacked\n"
+	"Version: 2:1.0-1\n"
+	"Architecture: all\n"
+	"Depends:\n"
+	"Maintainer: dummy\n"
+	"Description: dummy\n"
+	"\n"
+	"Package: pkg-deps-only\n"
+	"Status: deinstall ok not-installed\n"
+	"Depends: pkg-a\n"
+	"\n";
+
+static const char available[] =
+	"Package: pkg-a\n"
+	"Version: 2.0\n"
+	"Architecture: all\n"
+	"Depends: pkg-b (>= 2.0), pkg-new\n"
+	"Replaces: pkg-old\n"
+	"Maintainer: dummy\n"
+	"Description: dummy\n"
+	"\n"
+	"Package: pkg-e\n"
+	"Version: 1.0\n"
+	"Architecture: all\n"
+	"Suggests: pkg-c, pkg-b:i386\n"
+	"Maintainer: dummy\n"
+	"Description: dummy\n"
+	"\n";
+
+static struct pkg_db *
+parse_db(enum parsedbflags flags)
+{
+	struct pkg_db *db;
+
+	db = pkg_db_new();
+	test_alloc(db);
+	pkg_db_select(db);
+
+	test_parsedb_string("status", status, pdb_parse_status | flags);
+	test_parsedb_string("available", available,
+	                    pdb_parse_available | flags);
+
+	return db;
+}
+
+static struct pkginfo *
+find_instance(struct pkgset *set, const struct dpkg_arch *arch)
+{
+	struct pkginfo *pkg;
+
+	for (pkg = &set->pkg; pkg; pkg = pkg->arch_next)
+		if (pkg->installed.arch == arch)
+			return pkg;
+
+	return NULL;
+}
+
+static void
+add_dependencies(struct varbuf *vb, struct pkgbin *pkgbin)
+{
+	struct dependency *dep;
+
+	for (dep = pkgbin->depends; dep; dep = dep->next) {
+		varbuf_printf(vb, "%d:", dep->type);
+		varbufdependency(vb, dep);
+		varbuf_add_char(vb, '\n');
+	}
+}
+
+static int
+strcmp_indirect(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* The reverse links depend on the decoding order, so compare them sorted. */
+static void
+add_reverse_links(struct varbuf *vb, struct deppossi *revdeps)
+{
+	struct deppossi *possi;
+	char **links;
+	int nlinks = 0, i;
+
+	for (possi = revdeps; possi; possi = possi->rev_next)
+		nlinks++;
+
+	links = m_malloc(sizeof(*links) * (nlinks + 1));
+	for (possi = revdeps, i = 0; possi; possi = possi->rev_next, i++) {
+		struct varbuf link = VARBUF_INIT;
+
+		varbuf_printf(&link, "%s:%s %d:",
+		              possi->up->up->set->name,
+		              possi->up->up->installed.arch->name,
+		              possi->up->type);
+		varbufdependency(&link, possi->up);
+		varbuf_end_str(&link);
+		links[i] = varbuf_detach(&link);
+	}
+	qsort(links, nlinks, sizeof(*links), strcmp_indirect);
+
+	for (i = 0; i < nlinks; i++) {
+		varbuf_add_str(vb, links[i]);
+		varbuf_add_char(vb, '\n');
+		free(links[i]);
+	}
+	free(links);
+}
+
+static void
+add_dependency_fields(struct varbuf *vb, struct pkginfo *pkg,
+                      struct pkgbin *pkgbin)
+{
+	const struct fieldinfo *fip;
+
+	for (fip = fieldinfos; fip->name; fip++)
+		if (fip->wcall == w_dependency)
+			fip->wcall(vb, pkg, pkgbin, fw_printheader, fip);
+}
+
+static void
+test_pkgbin(struct pkginfo *pkg, struct pkgbin *pkgbin,
+            struct pkginfo *lazy_pkg, struct pkgbin *lazy_pkgbin)
+{
+	struct varbuf vb = VARBUF_INIT;
+	struct varbuf lazy_vb = VARBUF_INIT;
+
+	/* Check the undecoded fields first. */
+	test_pass(pkg_is_informative(pkg, pkgbin) ==
+	          pkg_is_informative(lazy_pkg, lazy_pkgbin));
+
+	pkgbin_decode_fields(lazy_pkg, lazy_pkgbin);
+	test_pass(lazy_pkgbin->lazyfields == NULL);
+
+	add_dependencies(&vb, pkgbin);
+	varbuf_end_str(&vb);
+	add_dependencies(&lazy_vb, lazy_pkgbin);
+	varbuf_end_str(&lazy_vb);
+	test_str(lazy_vb.buf, ==, vb.buf);
+
+	varbuf_reset(&vb);
+	varbuf_reset(&lazy_vb);
+	add_dependency_fields(&vb, pkg, pkgbin);
+	varbuf_end_str(&vb);
+	add_dependency_fields(&lazy_vb, lazy_pkg, lazy_pkgbin);
+	varbuf_end_str(&lazy_vb);
+	test_str(lazy_vb.buf, ==, vb.buf);
+
+	varbuf_destroy(&vb);
+	varbuf_destroy(&lazy_vb);
+}
+
+static void
+test_reverse_links(struct pkgset *set, struct pkgset *lazy_set)
+{
+	struct varbuf vb = VARBUF_INIT;
+	struct varbuf lazy_vb = VARBUF_INIT;
+
+	add_reverse_links(&vb, set->depended.installed);
+	add_reverse_links(&vb, set->depended.available);
+	varbuf_end_str(&vb);
+	add_reverse_links(&lazy_vb, lazy_set->depended.installed);
+	add_reverse_links(&lazy_vb, lazy_set->depended.available);
+	varbuf_end_str(&lazy_vb);
+	test_str(lazy_vb.buf, ==, vb.buf);
+
+	varbuf_destroy(&vb);
+	varbuf_destroy(&lazy_vb);
+}
+
+static void
+test_parse_lazy(void)
+{
+	struct pkg_db *db, *lazy_db;
+	struct pkgiterator *iter;
+	struct pkgset *set, *lazy_set;
+	struct pkginfo *pkg, *lazy_pkg;
+	int count_set;
+
+	db = parse_db(0);
+	count_set = pkg_db_count_set();
+	lazy_db = parse_db(pdb_lazy_fields);
+
+	/* The referenced package names are looked up when parsing. */
+	test_pass(pkg_db_count_set() == count_set);
+
+	pkg_db_select(db);
+	iter = pkg_db_iter_new();
+	pkg_db_select(lazy_db);
+	while ((set = pkg_db_iter_next_set(iter))) {
+		lazy_set = pkg_db_find_set(set->name);
+
+		for (pkg = &set->pkg; pkg; pkg = pkg->arch_next) {
+			lazy_pkg = find_instance(lazy_set,
+			                         pkg->installed.arch);
+			test_pass(lazy_pkg != NULL);
+
+			test_pkgbin(pkg, &pkg->installed,
+			            lazy_pkg, &lazy_pkg->installed);
+			test_pkgbin(pkg, &pkg->available,
+			            lazy_pkg, &lazy_pkg->available);
+		}
+	}
+	pkg_db_iter_free(iter);
+
+	/* Only check the reverse links once everything has been decoded. */
+	pkg_db_select(db);
+	iter = pkg_db_iter_new();
+	pkg_db_select(lazy_db);
+	while ((set = pkg_db_iter_next_set(iter)))
+		test_reverse_links(set, pkg_db_find_set(set->name));
+	pkg_db_iter_free(iter);
+
+	pkg_db_select(NULL);
+	pkg_db_free(db);
+	pkg_db_free(lazy_db);
+}
+
+static void
+test(void)
+{
+	test_plan(100);
+
+	test_parse_lazy();
+}
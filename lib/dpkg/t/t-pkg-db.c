@@ -0,0 +1,200 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * t-pkg-db.c - test in-core package database
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dpkg/test.h>
+#include <dpkg/arch.h>
+#include <dpkg/dpkg-db.h>
+
+static int
+count_sets(void)
+{
+	struct pkgiterator *iter;
+	int n = 0;
+
+	iter = pkg_db_iter_new();
+	while (pkg_db_iter_next_set(iter))
+		n++;
+	pkg_db_iter_free(iter);
+
+	return n;
+}
+
+static void
+test_pkg_db_find_set(void)
+{
+	struct pkgset *set, *first, *last;
+	char name[32];
+	int i;
+
+	set = pkg_db_find_set("Foo-Bar");
+	test_str(set->name, ==, "foo-bar");
+	test_pass(pkg_db_find_set("foo-bar") == set);
+	test_pass(pkg_db_find_set("FOO-BAR") == set);
+	test_pass(pkg_db_count_set() == 1);
+	test_pass(pkg_db_count_pkg() == 1);
+
+	/* Force the hash table to grow several times. */
+	first = pkg_db_find_set("pkg-00000");
+	for (i = 1; i < 5000; i++) {
+		sprintf(name, "pkg-%05d", i);
+		pkg_db_find_set(name);
+	}
+	last = pkg_db_find_set("pkg-04999");
+
+	test_pass(pkg_db_count_set() == 5001);
+	test_pass(count_sets() == 5001);
+	test_pass(pkg_db_find_set("PKG-00000") == first);
+	test_pass(pkg_db_find_set("Pkg-04999") == last);
+	test_pass(pkg_db_find_set("foo-bar") == set);
+	test_pass(pkg_db_count_set() == 5001);
+
+	pkg_db_reset();
+	test_pass(pkg_db_count_set() == 0);
+	test_pass(count_sets() == 0);
+}
+
+static void
+test_pkg_db_iter_grow(void)
+{
+	struct pkg_db *iter_db;
+	struct pkgiterator *iter;
+	struct pkgset *set;
+	char name[32];
+	int seen[10000] = { 0 };
+	int i, n, dups = 0, missed = 0;
+
+	/* The table can grow while an iterator is live on an empty one. */
+	iter_db = pkg_db_new();
+	pkg_db_select(iter_db);
+	iter = pkg_db_iter_new();
+	test_pass(pkg_db_iter_next_set(iter) == NULL);
+	pkg_db_find_set("pkg-00000");
+	test_pass(pkg_db_iter_next_set(iter) != NULL);
+	test_pass(pkg_db_iter_next_set(iter) == NULL);
+	pkg_db_iter_free(iter);
+
+	for (i = 1; i < 1000; i++) {
+		sprintf(name, "pkg-%05d", i);
+		pkg_db_find_set(name);
+	}
+
+	/* Force the hash table to grow several times in the middle of a
+	 * walk, and of a chain, which should still return every package set
+	 * once. */
+	iter = pkg_db_iter_new();
+	for (n = 0; (set = pkg_db_iter_next_set(iter)); n++) {
+		seen[atoi(set->name + 4)]++;
+
+		if (n >= 500 && set->next && set->next->next &&
+		    pkg_db_count_set() < 10000) {
+			for (i = 1000; i < 10000; i++) {
+				sprintf(name, "pkg-%05d", i);
+				pkg_db_find_set(name);
+			}
+		}
+	}
+	pkg_db_iter_free(iter);
+
+	for (i = 0; i < 10000; i++) {
+		if (seen[i] > 1)
+			dups++;
+		else if (seen[i] == 0 && i < 1000)
+			missed++;
+	}
+	test_pass(pkg_db_count_set() == 10000);
+	test_pass(dups == 0);
+	test_pass(missed == 0);
+
+	/* A live iterator, as when unwinding from an error, does not block
+	 * freeing the database. */
+	iter = pkg_db_iter_new();
+	pkg_db_iter_next_set(iter);
+	pkg_db_select(NULL);
+	pkg_db_free(iter_db);
+	pkg_db_iter_free(iter);
+}
+
+static void
+test_pkg_db_select(void)
+{
+	struct pkg_db *db, *old_db;
+	struct pkgiterator *iter;
+	struct pkgset *set, *other_set;
+	struct dpkg_arch *arch;
+
+	set = pkg_db_find_set("foo");
+	test_pass(pkg_db_count_set() == 1);
+
+	db = pkg_db_new();
+	test_alloc(db);
+
+	old_db = pkg_db_select(db);
+	test_pass(pkg_db_count_set() == 0);
+	test_pass(count_sets() == 0);
+
+	other_set = pkg_db_find_set("foo");
+	test_pass(other_set != set);
+	test_str(other_set->name, ==, "foo");
+	pkg_db_find_set("bar");
+	test_pass(pkg_db_count_set() == 2);
+
+	/* Unknown architectures are shared by all databases. */
+	arch = dpkg_arch_find("other-arch");
+	test_pass(arch->type == DPKG_ARCH_UNKNOWN);
+
+	/* An iterator keeps walking the database it was created on. */
+	iter = pkg_db_iter_new();
+	test_pass(pkg_db_select(old_db) == db);
+	test_pass(pkg_db_count_set() == 1);
+	test_pass(pkg_db_find_set("foo") == set);
+	test_pass(pkg_db_iter_next_set(iter) != set);
+	test_pass(pkg_db_iter_next_set(iter) != set);
+	test_pass(pkg_db_iter_next_set(iter) == NULL);
+	pkg_db_iter_free(iter);
+
+	pkg_db_free(db);
+	test_str(set->name, ==, "foo");
+	test_pass(dpkg_arch_find("other-arch") == arch);
+	test_str(arch->name, ==, "other-arch");
+
+	/* Selecting NULL goes back to the default database. */
+	db = pkg_db_new();
+	pkg_db_select(db);
+	test_pass(pkg_db_select(NULL) == db);
+	test_pass(pkg_db_find_set("foo") == set);
+	pkg_db_free(db);
+
+	pkg_db_reset();
+	test_pass(pkg_db_count_set() == 0);
+}
+
+static void
+test(void)
+{
+	test_plan(38);
+
+	test_pkg_db_find_set();
+	test_pkg_db_iter_grow();
+	test_pkg_db_select();
+}
@@ -76,6 +76,16 @@ test_str_fnv_hash(void)
 	test_pass(str_fnv_hash("Rest-string") == 0x20464b9fUL);
 }
 
+static void
+test_str_fnv_hash_lower(void)
+{
+	test_pass(str_fnv_hash_lower("") == 0x811c9dc5U);
+	test_pass(str_fnv_hash_lower("foobar") == 0xbf9cf968UL);
+	test_pass(str_fnv_hash_lower("FooBAR") == 0xbf9cf968UL);
+	test_pass(str_fnv_hash_lower("Test-string") == 0xd28f6e61UL);
+	test_pass(str_fnv_hash_lower("REST-STRING") == 0x1cdeebffUL);
+}
+
 static void
 test_str_fmt(void)
 {
@@ -198,11 +208,12 @@ test_str_strip_quotes(void)
 static void
 test(void)
 {
-	test_plan(50);
+	test_plan(55);
 
 	test_str_is_set();
 	test_str_match_end();
 	test_str_fnv_hash();
+	test_str_fnv_hash_lower();
 	test_str_fmt();
 	test_str_escape_fmt();
 	test_str_quote_meta();
@@ -21,6 +21,7 @@
 #include <config.h>
 #include <compat.h>
 
+#include <string.h>
 #include <stdlib.h>
 
 #include <dpkg/test.h>
@@ -36,6 +37,7 @@ test_version_blank(void)
 	test_pass(a.epoch == 0);
 	test_pass(a.version == NULL);
 	test_pass(a.revision == NULL);
+	test_pass(a.key == NULL);
 }
 
 static void
@@ -285,14 +287,64 @@ test_version_parse(void)
 	/* FIXME: Complete. */
 }
 
+static void
+test_version_key(void)
+{
+	/* Versions in ascending order, with the equal ones adjacent. */
+	static const char *const strings[] = {
+		"0~~", "0~~a", "0~", "0~a", "0", "00", "0-0", "0A", "0a", "0a1",
+		"0+0", "0.0", "1.0~rc1", "1.0", "1.0-0", "1.0-1~bpo1", "1.0-1",
+		"1.0-1ubuntu1", "1.0-1+b1", "1.0-1.1", "1.0a", "1.0+dfsg", "1.00.1",
+		"1.0.1", "1.2", "1.10", "1.10.0", "2", "1:0", "1:0.9", "2:0~",
+	};
+	struct dpkg_version versions[array_count(strings)];
+	struct dpkg_version *sorted[array_count(strings)];
+	char longver[300];
+	size_t i;
+
+	for (i = 0; i < array_count(strings); i++) {
+		test_pass(parseversion(&versions[i], strings[i], NULL) == 0);
+		test_pass(versions[i].key != NULL);
+	}
+
+	/* The keys must order the same as the versions without them. */
+	for (i = 1; i < array_count(strings); i++) {
+		struct dpkg_version a = versions[i - 1];
+		struct dpkg_version b = versions[i];
+		int rc, rc_key;
+
+		rc_key = dpkg_version_compare(&a, &b);
+		a.key = b.key = NULL;
+		rc = dpkg_version_compare(&a, &b);
+		test_pass(rc <= 0);
+		test_pass((rc < 0) == (rc_key < 0) && (rc == 0) == (rc_key == 0));
+	}
+
+	for (i = 0; i < array_count(strings); i++) {
+		sorted[i] = &versions[array_count(strings) - 1 - i];
+		if (i % 2)
+			sorted[i]->key = NULL;
+	}
+	dpkg_version_sort(sorted, array_count(strings));
+	for (i = 1; i < array_count(strings); i++)
+		test_pass(dpkg_version_compare(sorted[i - 1], sorted[i]) <= 0);
+
+	/* Versions that cannot be encoded get no key. */
+	memset(longver, '1', sizeof(longver) - 1);
+	longver[sizeof(longver) - 1] = '\0';
+	test_pass(parseversion(&versions[0], longver, NULL) == 0);
+	test_pass(versions[0].key == NULL);
+}
+
 static void
 test(void)
 {
-	test_plan(190);
+	test_plan(345);
 
 	test_version_blank();
 	test_version_is_informative();
 	test_version_compare();
 	test_version_relate();
 	test_version_parse();
+	test_version_key();
 }
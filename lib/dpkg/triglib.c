@@ -25,10 +25,16 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef USE_MMAP
+#include <sys/mman.h>
+#endif
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <dpkg/i18n.h>
@@ -36,15 +42,21 @@
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
 #include <dpkg/pkg.h>
+#include <dpkg/debug.h>
 #include <dpkg/dlist.h>
+#include <dpkg/arch.h>
+#include <dpkg/fdio.h>
+#include <dpkg/file.h>
+#include <dpkg/varbuf.h>
 #include <dpkg/dir.h>
+#include <dpkg/path.h>
 #include <dpkg/pkg-spec.h>
 #include <dpkg/trigdeferred.h>
 #include <dpkg/triglib.h>
 
 /*========== Recording triggers. ==========*/
 
-static char *triggersdir, *triggersfilefile;
+static char *triggersdir, *triggersfilefile, *triggersfilecachefile;
 
 static char *
 trig_get_filename(const char *dir, const char *filename)
@@ -113,6 +125,7 @@ trig_clear_awaiters(struct pkginfo *notpend)
 		if (!aw)
 			continue;
 		LIST_UNLINK_PART(aw->trigaw, ta, sameaw.);
+		pkg_invalidate_stanza(aw);
 		if (!aw->trigaw.head && aw->status == PKG_STAT_TRIGGERSAWAITED) {
 			if (aw->trigpend_head)
 				pkg_set_status(aw, PKG_STAT_TRIGGERSPENDING);
@@ -377,6 +390,66 @@ static struct {
 	struct trigfileint *head, *tail;
 } filetriggers;
 
+/*
+ * Index of the file trigger interests, as a trie over the pathname
+ * components, so that activating the parents of a path only needs to
+ * walk as many components as are shared with some interest, instead of
+ * looking up every parent directory in the file database.
+ */
+struct trig_file_dir {
+	struct trig_file_dir *next;
+	struct trig_file_dir *subdirs;
+	/* Non-NULL if this is the pathname of some interest. */
+	struct filenamenode *fnn;
+	const char *name;
+	size_t len;
+};
+
+static struct trig_file_dir *filetrigger_dirs;
+
+static void
+trig_file_dirs_insert(struct filenamenode *fnn)
+{
+	struct trig_file_dir **dirp = &filetrigger_dirs;
+	const char *name;
+
+	name = path_skip_slash_dotslash(trigh.namenode_name(fnn));
+
+	for (;;) {
+		struct trig_file_dir *dir;
+		const char *slash;
+		size_t len;
+
+		slash = strchr(name, '/');
+		if (slash)
+			len = slash - name;
+		else
+			len = strlen(name);
+
+		for (dir = *dirp; dir; dir = dir->next)
+			if (dir->len == len && memcmp(dir->name, name, len) == 0)
+				break;
+
+		if (dir == NULL) {
+			dir = nfmalloc(sizeof(*dir));
+			dir->subdirs = NULL;
+			dir->fnn = NULL;
+			dir->name = name;
+			dir->len = len;
+			dir->next = *dirp;
+			*dirp = dir;
+		}
+
+		if (slash == NULL) {
+			dir->fnn = fnn;
+			return;
+		}
+
+		dirp = &dir->subdirs;
+		name = slash + 1;
+	}
+}
+
 /*
  * Values:
  *  -1: Not read.
@@ -385,6 +458,9 @@ static struct {
  */
 static int filetriggers_edited = -1;
 
+/* Whether the compiled file triggers cache needs to be regenerated. */
+static bool filetriggers_cache_stale;
+
 /*
  * Called by various people with signum -1 and +1 to mean remove and add
  * and also by trig_file_interests_ensure() with signum +2 meaning add
@@ -414,6 +490,9 @@ trk_file_interest_change(const char *trig, struct pkginfo *pkg,
 	if (signum < 0)
 		return;
 
+	if (*trigh.namenode_interested(fnn) == NULL)
+		trig_file_dirs_insert(fnn);
+
 	tfi = nfmalloc(sizeof(*tfi));
 	tfi->pkg = pkg;
 	tfi->pkgbin = pkgbin;
@@ -441,6 +520,224 @@ edited:
 	filetriggers_edited = 1;
 }
 
+/*
+ * The compiled file triggers cache is a native endian binary image of the
+ * File interests, so that it can be mapped and loaded at startup without
+ * any parsing. It records the identity of the File it got compiled from,
+ * and is ignored whenever they do not match, as the latter is the
+ * authoritative source, and might have been modified by something else.
+ */
+
+#define TRIG_FILE_CACHE_MAGIC	0x64747263
+#define TRIG_FILE_CACHE_VERSION	2
+
+struct trig_file_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t file_ino;
+	uint64_t file_size;
+	int64_t file_mtime;
+	int64_t file_mtime_nsec;
+	uint32_t nentries;
+	uint32_t strings_size;
+};
+
+struct trig_file_cache_entry {
+	/* Offsets into the string table. */
+	uint32_t path;
+	uint32_t pkgname;
+	/* Offset to the architecture qualifier, or 0 if there is none. */
+	uint32_t archname;
+	uint32_t options;
+};
+
+static uint32_t
+trig_file_cache_add_str(struct varbuf *strings, const char *str, size_t len)
+{
+	uint32_t offset = strings->used;
+
+	varbuf_add_buf(strings, str, len);
+	varbuf_add_char(strings, '\0');
+
+	return offset;
+}
+
+static void
+trig_file_interests_cache_remove(void)
+{
+	if (unlink(triggersfilecachefile) && errno != ENOENT)
+		ohshite(_("cannot remove '%.250s'"), triggersfilecachefile);
+}
+
+static void
+trig_file_interests_cache_update(void)
+{
+	struct trig_file_cache_header hdr;
+	struct trig_file_cache_entry *entries;
+	struct varbuf strings = VARBUF_INIT;
+	struct trigfileint *tfi;
+	struct atomic_file *file;
+	struct stat st;
+	struct timespec mtime;
+	uint32_t n = 0;
+
+	if (stat(triggersfilefile, &st) < 0)
+		ohshite(_("unable to stat file triggers file '%.250s'"),
+		        triggersfilefile);
+	file_stat_mtime(&st, &mtime);
+
+	for (tfi = filetriggers.head; tfi; tfi = tfi->inoverall.next)
+		n++;
+	entries = m_malloc(sizeof(*entries) * n);
+
+	/* Keep the offset 0 for the empty string. */
+	varbuf_add_char(&strings, '\0');
+
+	n = 0;
+	for (tfi = filetriggers.head; tfi; tfi = tfi->inoverall.next) {
+		const char *path = trigh.namenode_name(tfi->fnn);
+		const char *name, *colon;
+		struct trig_file_cache_entry *entry = &entries[n++];
+
+		name = pkgbin_name(tfi->pkg, tfi->pkgbin, pnaw_nonambig);
+		colon = strchr(name, ':');
+
+		entry->path = trig_file_cache_add_str(&strings, path, strlen(path));
+		if (colon) {
+			entry->pkgname = trig_file_cache_add_str(&strings, name,
+			                                         colon - name);
+			entry->archname = trig_file_cache_add_str(&strings, colon + 1,
+			                                          strlen(colon + 1));
+		} else {
+			entry->pkgname = trig_file_cache_add_str(&strings, name,
+			                                         strlen(name));
+			entry->archname = 0;
+		}
+		entry->options = tfi->options;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = TRIG_FILE_CACHE_MAGIC;
+	hdr.version = TRIG_FILE_CACHE_VERSION;
+	hdr.file_ino = st.st_ino;
+	hdr.file_size = st.st_size;
+	hdr.file_mtime = mtime.tv_sec;
+	hdr.file_mtime_nsec = mtime.tv_nsec;
+	hdr.nentries = n;
+	hdr.strings_size = strings.used;
+
+	file = atomic_file_new(triggersfilecachefile, 0);
+	atomic_file_open(file);
+
+	fwrite(&hdr, sizeof(hdr), 1, file->fp);
+	fwrite(entries, sizeof(*entries), n, file->fp);
+	fwrite(strings.buf, strings.used, 1, file->fp);
+
+	atomic_file_sync(file);
+	atomic_file_close(file);
+	atomic_file_commit(file);
+	atomic_file_free(file);
+
+	free(entries);
+	varbuf_destroy(&strings);
+}
+
+static bool
+trig_file_interests_cache_load(void)
+{
+	const struct trig_file_cache_header *hdr;
+	const struct trig_file_cache_entry *entries;
+	const char *strings;
+	struct stat st, st_file;
+	struct timespec mtime;
+	char *data;
+	size_t size;
+	uint32_t i;
+	bool valid = false;
+	int fd;
+
+	fd = open(triggersfilecachefile, O_RDONLY);
+	if (fd < 0)
+		return false;
+	if (fstat(fd, &st) < 0)
+		ohshite(_("unable to stat file triggers cache '%.250s'"),
+		        triggersfilecachefile);
+	if (stat(triggersfilefile, &st_file) < 0 ||
+	    st.st_size < (off_t)sizeof(*hdr)) {
+		close(fd);
+		return false;
+	}
+	file_stat_mtime(&st_file, &mtime);
+
+	size = st.st_size;
+#ifdef USE_MMAP
+	data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+		ohshite(_("cannot mmap file triggers cache '%.250s'"),
+		        triggersfilecachefile);
+#else
+	data = m_malloc(size);
+	if (fd_read(fd, data, size) < 0)
+		ohshite(_("unable to read file triggers cache '%.250s'"),
+		        triggersfilecachefile);
+#endif
+	close(fd);
+
+	hdr = (const struct trig_file_cache_header *)data;
+	entries = (const struct trig_file_cache_entry *)(hdr + 1);
+
+	if (hdr->magic != TRIG_FILE_CACHE_MAGIC ||
+	    hdr->version != TRIG_FILE_CACHE_VERSION ||
+	    hdr->file_ino != (uint64_t)st_file.st_ino ||
+	    hdr->file_size != (uint64_t)st_file.st_size ||
+	    hdr->file_mtime != (int64_t)mtime.tv_sec ||
+	    hdr->file_mtime_nsec != (int64_t)mtime.tv_nsec ||
+	    hdr->strings_size == 0 ||
+	    size != sizeof(*hdr) + sizeof(*entries) * hdr->nentries +
+	            hdr->strings_size)
+		goto out;
+
+	strings = (const char *)(entries + hdr->nentries);
+	if (strings[hdr->strings_size - 1] != '\0')
+		goto out;
+
+	for (i = 0; i < hdr->nentries; i++) {
+		if (entries[i].path >= hdr->strings_size ||
+		    entries[i].pkgname >= hdr->strings_size ||
+		    entries[i].archname >= hdr->strings_size)
+			goto out;
+	}
+
+	for (i = 0; i < hdr->nentries; i++) {
+		const struct trig_file_cache_entry *entry = &entries[i];
+		const char *pkgname = strings + entry->pkgname;
+		struct pkginfo *pkg;
+
+		if (entry->archname)
+			pkg = pkg_db_find_pkg(pkgname,
+			                      dpkg_arch_find(strings + entry->archname));
+		else
+			pkg = pkg_db_find_singleton(pkgname);
+
+		trk_file_interest_change(strings + entry->path, pkg, &pkg->installed,
+		                         +2, entry->options);
+	}
+	valid = true;
+
+out:
+#ifdef USE_MMAP
+	munmap(data, size);
+#else
+	free(data);
+#endif
+
+	if (!valid)
+		debug(dbg_triggers, "ignoring stale file triggers cache '%s'",
+		      triggersfilecachefile);
+
+	return valid;
+}
+
 static void
 trig_file_interests_remove(void)
 {
@@ -471,17 +768,22 @@ trig_file_interests_update(void)
 void
 trig_file_interests_save(void)
 {
-	if (filetriggers_edited <= 0)
+	if (filetriggers_edited <= 0 && !filetriggers_cache_stale)
 		return;
 
-	if (!filetriggers.head)
+	if (!filetriggers.head) {
 		trig_file_interests_remove();
-	else
-		trig_file_interests_update();
+		trig_file_interests_cache_remove();
+	} else {
+		if (filetriggers_edited > 0)
+			trig_file_interests_update();
+		trig_file_interests_cache_update();
+	}
 
 	dir_sync_path(triggersdir);
 
 	filetriggers_edited = 0;
+	filetriggers_cache_stale = false;
 }
 
 void
@@ -495,6 +797,9 @@ trig_file_interests_ensure(void)
 	if (filetriggers_edited >= 0)
 		return;
 
+	if (trig_file_interests_cache_load())
+		goto ok;
+
 	f = fopen(triggersfilefile, "r");
 	if (!f) {
 		if (errno == ENOENT)
@@ -534,6 +839,7 @@ trig_file_interests_ensure(void)
 		trk_file_interest_change(linebuf, pkg, pkgbin, +2, trig_opts);
 	}
 	pop_cleanup(ehflag_normaltidy);
+	filetriggers_cache_stale = true;
 ok:
 	filetriggers_edited = 0;
 }
@@ -559,19 +865,35 @@ trig_file_activate(struct filenamenode *trig, struct pkginfo *aw)
 }
 
 static void
-trig_file_activate_parents(const char *trig, struct pkginfo *aw)
+trig_file_activate_dirs(struct trig_file_dir *dir, const char *path,
+                        struct pkginfo *aw)
 {
-	char *path, *slash;
+	const char *slash;
+	size_t len;
 
-	/* Traverse the whole pathname to activate all of its components. */
-	path = m_strdup(trig);
+	/* The last component is the pathname itself, not one of its parents. */
+	slash = strchr(path, '/');
+	if (slash == NULL)
+		return;
+	len = slash - path;
 
-	while ((slash = strrchr(path, '/'))) {
-		*slash = '\0';
-		trig_file_activate_byname(path, aw);
-	}
+	for (; dir; dir = dir->next)
+		if (dir->len == len && memcmp(dir->name, path, len) == 0)
+			break;
+	if (dir == NULL)
+		return;
+
+	/* Activate from the innermost directory outwards. */
+	trig_file_activate_dirs(dir->subdirs, slash + 1, aw);
+	if (dir->fnn)
+		trig_file_activate(dir->fnn, aw);
+}
 
-	free(path);
+static void
+trig_file_activate_parents(const char *trig, struct pkginfo *aw)
+{
+	trig_file_activate_dirs(filetrigger_dirs,
+	                        path_skip_slash_dotslash(trig), aw);
 }
 
 void
@@ -767,6 +1089,10 @@ trig_incorporate(enum modstatdb_rw cstatus)
 	free(triggersfilefile);
 	triggersfilefile = trig_get_filename(triggersdir, TRIGGERSFILEFILE);
 
+	free(triggersfilecachefile);
+	triggersfilecachefile = trig_get_filename(triggersdir,
+	                                          TRIGGERSFILECACHEFILE);
+
 	trigdef_set_methods(&tdm_incorp);
 	trig_file_interests_ensure();
 
@@ -50,6 +50,7 @@ trig_note_pend_core(struct pkginfo *pend, const char *trig)
 	tp->name = trig;
 	tp->next = pend->trigpend_head;
 	pend->trigpend_head = tp;
+	pkg_invalidate_stanza(pend);
 
 	return true;
 }
@@ -97,6 +98,7 @@ trig_note_aw(struct pkginfo *pend, struct pkginfo *aw)
 	ta->samepend_next = pend->othertrigaw_head;
 	pend->othertrigaw_head = ta;
 	LIST_LINK_TAIL_PART(aw->trigaw, ta, sameaw.);
+	pkg_invalidate_stanza(aw);
 
 	return true;
 }
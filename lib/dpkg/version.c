@@ -22,9 +22,15 @@
 #include <config.h>
 #include <compat.h>
 
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
 #include <dpkg/c-ctype.h>
 #include <dpkg/ehandle.h>
 #include <dpkg/string.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/dpkg-db.h>
 #include <dpkg/version.h>
 
 /**
@@ -40,6 +46,7 @@ dpkg_version_blank(struct dpkg_version *version)
 	version->epoch = 0;
 	version->version = NULL;
 	version->revision = NULL;
+	version->key = NULL;
 }
 
 /**
@@ -121,6 +128,134 @@ verrevcmp(const char *a, const char *b)
 	return 0;
 }
 
+/*
+ * The comparison key encodes a version into a string that sorts with
+ * strcmp() in the same order as the versions would with verrevcmp(), so
+ * that the character weighting and the digit run scanning only need to be
+ * done once, when the version gets parsed.
+ *
+ * The epoch and each digit run are encoded as their number of significant
+ * digits plus one, followed by those digits. Each non-digit run is encoded
+ * as its characters mapped to bytes in order() weight order, followed by a
+ * separator which sorts after ‘~’ but before anything else. The same byte
+ * ends each of the upstream version and revision parts, as there it gets
+ * compared against the start of another non-digit run.
+ */
+#define VERSION_KEY_TILDE	0x01
+#define VERSION_KEY_SEP		0x02
+#define VERSION_KEY_UPPER	0x10
+#define VERSION_KEY_LOWER	0x30
+#define VERSION_KEY_OTHER	0x60
+#define VERSION_KEY_NUM_MAX	0xfe
+
+static char *
+version_key_add_number(char *key, const char *num, size_t len)
+{
+	while (len && *num == '0') {
+		num++;
+		len--;
+	}
+
+	/* Such digit runs cannot be encoded, but are not sensible either. */
+	if (len >= VERSION_KEY_NUM_MAX)
+		return NULL;
+
+	*key++ = len + 1;
+	memcpy(key, num, len);
+
+	return key + len;
+}
+
+static char *
+version_key_add_part(char *key, const char *str)
+{
+	if (str == NULL)
+		str = "";
+
+	for (;;) {
+		const char *num;
+
+		while (*str && !c_isdigit(*str)) {
+			int c = (unsigned char)*str++;
+
+			if (c == '~') {
+				*key++ = VERSION_KEY_TILDE;
+			} else if (c_isupper(c)) {
+				*key++ = VERSION_KEY_UPPER + c - 'A';
+			} else if (c_islower(c)) {
+				*key++ = VERSION_KEY_LOWER + c - 'a';
+			} else if (c < 0x80) {
+				*key++ = VERSION_KEY_OTHER;
+				*key++ = c;
+			} else {
+				/* Non-ASCII characters are weighted as signed
+				 * chars by order(), do not bother with them. */
+				return NULL;
+			}
+		}
+		*key++ = VERSION_KEY_SEP;
+
+		num = str;
+		while (c_isdigit(*str))
+			str++;
+		key = version_key_add_number(key, num, str - num);
+		if (key == NULL)
+			return NULL;
+
+		if (*str == '\0')
+			break;
+	}
+	*key++ = VERSION_KEY_SEP;
+
+	return key;
+}
+
+/**
+ * Build the comparison key for a version.
+ *
+ * This needs to be called again whenever the version gets modified, to
+ * keep using the key on comparisons. The key is allocated with nfmalloc(),
+ * the same as the versions parsed by parseversion(), which does this
+ * already.
+ *
+ * @param version The version to build the key for.
+ */
+void
+dpkg_version_build_key(struct dpkg_version *version)
+{
+	char stackbuf[256];
+	char epoch[16];
+	char *buf, *key;
+	size_t size;
+	int epoch_len;
+
+	epoch_len = snprintf(epoch, sizeof(epoch), "%u", version->epoch);
+
+	/* Each character might take two bytes, and each digit run one more,
+	 * plus the separators. */
+	size = 1 + epoch_len + 1;
+	size += 4 * strlen(version->version ? version->version : "") + 3;
+	size += 4 * strlen(version->revision ? version->revision : "") + 3;
+
+	if (size > sizeof(stackbuf))
+		buf = m_malloc(size);
+	else
+		buf = stackbuf;
+
+	key = version_key_add_number(buf, epoch, epoch_len);
+	key = version_key_add_part(key, version->version);
+	if (key)
+		key = version_key_add_part(key, version->revision);
+
+	if (key)
+		version->key = nfstrnsave(buf, key - buf);
+	else
+		version->key = NULL;
+
+	if (buf != stackbuf)
+		free(buf);
+}
+
 /**
  * Compares two Debian versions.
  *
@@ -142,6 +277,9 @@ dpkg_version_compare(const struct dpkg_version *a,
 {
 	int rc;
 
+	if (a->key && b->key)
+		return strcmp(a->key, b->key);
+
 	if (a->epoch > b->epoch)
 		return 1;
 	if (a->epoch < b->epoch)
@@ -196,3 +334,33 @@ dpkg_version_relate(const struct dpkg_version *a,
 	}
 	return false;
 }
+
+static int
+version_compare_ptr(const void *a, const void *b)
+{
+	const struct dpkg_version *va = *(const struct dpkg_version * const *)a;
+	const struct dpkg_version *vb = *(const struct dpkg_version * const *)b;
+
+	return dpkg_version_compare(va, vb);
+}
+
+/**
+ * Sort an array of versions in ascending order.
+ *
+ * The comparison keys get built for any version missing one, so that the
+ * sorting itself only needs to compare strings.
+ *
+ * @param versions The array of pointers to the versions to sort.
+ * @param nmemb The number of versions in the array.
+ */
+void
+dpkg_version_sort(struct dpkg_version **versions, size_t nmemb)
+{
+	size_t i;
+
+	for (i = 0; i < nmemb; i++)
+		if (versions[i]->key == NULL)
+			dpkg_version_build_key(versions[i]);
+
+	qsort(versions, nmemb, sizeof(*versions), version_compare_ptr);
+}
@@ -22,6 +22,7 @@
 #ifndef LIBDPKG_VERSION_H
 #define LIBDPKG_VERSION_H
 
+#include <stddef.h>
 #include <stdbool.h>
 
 #include <dpkg/macros.h>
@@ -46,13 +47,21 @@ struct dpkg_version {
 	const char *version;
 	/** The Debian revision part of the version. */
 	const char *revision;
+	/**
+	 * The precomputed comparison key, or NULL if there is none.
+	 *
+	 * It must be rebuilt or cleared whenever any of the other members
+	 * get modified.
+	 */
+	const char *key;
 };
 
 /**
  * Compound literal for a dpkg_version.
  */
 #define DPKG_VERSION_OBJECT(e, v, r) \
-	(struct dpkg_version){ .epoch = (e), .version = (v), .revision = (r) }
+	(struct dpkg_version){ .epoch = (e), .version = (v), .revision = (r), \
+	                       .key = NULL }
 
 /**
  * Enum constants for the supported relation operations that can be done
@@ -80,6 +89,8 @@ int dpkg_version_compare(const struct dpkg_version *a,
 bool dpkg_version_relate(const struct dpkg_version *a,
                          enum dpkg_relation rel,
                          const struct dpkg_version *b);
+void dpkg_version_build_key(struct dpkg_version *version);
+void dpkg_version_sort(struct dpkg_version **versions, size_t nmemb);
 
 /** @} */
 
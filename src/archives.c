@@ -55,6 +55,7 @@
 #include <dpkg/tarfn.h>
 #include <dpkg/options.h>
 #include <dpkg/triglib.h>
+#include <dpkg/perf.h>
 
 #include "filesdb.h"
 #include "main.h"
@@ -730,6 +731,7 @@ tarobject(void *ctx, struct tar_entry *ti)
      * However, it's possible that we were in the middle of some other
      * backup/restore operation and were rudely interrupted.
      * So, we see if we have .dpkg-tmp, and if so we restore it. */
+    perf_count("rename", 1);
     if (rename(fnametmpvb.buf,fnamevb.buf)) {
       if (errno != ENOENT && errno != ENOTDIR)
         ohshite(_("unable to clean up mess surrounding '%.255s' before "
@@ -990,6 +992,9 @@ tarobject(void *ctx, struct tar_entry *ti)
   if (nifd->namenode->flags & fnnf_new_conff) {
     debug(dbg_conffdetail,"tarobject conffile extracted");
     nifd->namenode->flags |= fnnf_elide_other_lists;
+    /* Save having to hash it again when configuring. */
+    if (ti->type == TAR_FILETYPE_FILE)
+      md5hash_note(fnamenewvb.buf, nifd->namenode->newhash);
     return 0;
   }
 
@@ -1003,6 +1008,7 @@ tarobject(void *ctx, struct tar_entry *ti)
       /* One of the two is a directory - can't do atomic install. */
       debug(dbg_eachfiledetail,"tarobject directory, nonatomic");
       nifd->namenode->flags |= fnnf_no_atomic_overwrite;
+      perf_count("rename", 1);
       if (rename(fnamevb.buf,fnametmpvb.buf))
         ohshite(_("unable to move aside '%.255s' to install new version"),
                 ti->name);
@@ -1044,6 +1050,7 @@ tarobject(void *ctx, struct tar_entry *ti)
 
     debug(dbg_eachfiledetail, "tarobject done and installation deferred");
   } else {
+    perf_count("rename", 1);
     if (rename(fnamenewvb.buf, fnamevb.buf))
       ohshite(_("unable to install new version of '%.255s'"), ti->name);
 
@@ -1124,6 +1131,7 @@ tar_deferred_extract(struct fileinlist *files, struct pkginfo *pkg)
       fd = open(fnamenewvb.buf, O_WRONLY);
       if (fd < 0)
         ohshite(_("unable to open '%.255s'"), fnamenewvb.buf);
+      perf_count("fsync", 1);
       if (fsync(fd))
         ohshite(_("unable to sync file '%.255s'"), fnamenewvb.buf);
       if (close(fd))
@@ -1134,6 +1142,7 @@ tar_deferred_extract(struct fileinlist *files, struct pkginfo *pkg)
 
     debug(dbg_eachfiledetail, "deferred extract needs rename");
 
+    perf_count("rename", 1);
     if (rename(fnamenewvb.buf, fnamevb.buf))
       ohshite(_("unable to install new version of '%.255s'"),
               cfile->namenode->name);
@@ -1420,6 +1429,7 @@ archivefiles(const char *const *argv)
   const char *const *volatile argp;
   jmp_buf ejbuf;
   enum modstatdb_rw msdbflags;
+  struct perf_phase *phase;
 
   trigproc_install_hooks();
 
@@ -1533,7 +1543,9 @@ archivefiles(const char *const *argv)
 
     dpkg_selabel_load();
 
+    phase = perf_phase_start("archive");
     process_archive(thisarg);
+    perf_phase_stop(phase);
     onerr_abort++;
     m_output(stdout, _("<standard output>"));
     m_output(stderr, _("<standard error>"));
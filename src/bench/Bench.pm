@@ -0,0 +1,133 @@
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+package Bench;
+
+# Shared setup and reporting for the dpkg benchmark scripts.
+
+use strict;
+use warnings;
+
+our @EXPORT = qw(
+    bench_param
+    bench_tmpdir
+    bench_program
+    write_file
+    status_stanza
+    time_command
+    report
+);
+
+use Exporter qw(import);
+use File::Path qw(make_path remove_tree);
+use File::Spec;
+use Time::HiRes qw(gettimeofday tv_interval);
+
+# Cleanup environment from variables that pollute the benchmark runs.
+delete $ENV{DPKG_MAINTSCRIPT_PACKAGE};
+delete $ENV{DPKG_MAINTSCRIPT_ARCH};
+
+my $builddir = File::Spec->rel2abs($ENV{builddir} || '.');
+
+# Return the value of the DPKG_BENCH_<name> environment variable, or the
+# default value if unset.
+sub bench_param {
+    my ($name, $default) = @_;
+
+    return $ENV{"DPKG_BENCH_$name"} // $default;
+}
+
+# Return the absolute path to a fresh scratch directory for a benchmark.
+sub bench_tmpdir {
+    my $name = shift;
+    my $tmpdir = File::Spec->rel2abs("bench.tmp/$name");
+
+    remove_tree($tmpdir);
+    make_path($tmpdir);
+
+    return $tmpdir;
+}
+
+# Return the path to one of the programs being benchmarked, relative to
+# the source build directory.
+sub bench_program {
+    my $path = shift;
+    my $program = "$builddir/../$path";
+
+    die "$path not available\n" if not -x $program;
+
+    return $program;
+}
+
+sub write_file {
+    my ($file, $contents) = @_;
+
+    open my $fh, '>', $file or die "cannot create $file: $!\n";
+    print { $fh } $contents;
+    close $fh or die "cannot write $file: $!\n";
+}
+
+# Return a minimal status file stanza for an installed package.
+sub status_stanza {
+    my $pkg = shift;
+
+    return <<"STATUS";
+Package: $pkg
+Status: install ok installed
+Version: 1.0
+Architecture: all
+Maintainer: dummy
+Description: dummy
+
+STATUS
+}
+
+# Run a shell command, and return the elapsed time in seconds.
+sub time_command {
+    my ($cmd, $desc) = @_;
+
+    my $start = [ gettimeofday() ];
+    system($cmd) == 0 or die "$desc failed\n";
+
+    return tv_interval($start);
+}
+
+# Print the summary line for a benchmark.
+#
+# The runs are either their elapsed times, or hashes with the elapsed time
+# and a report on the run, in which case the one from the median run gets
+# printed. The params are printed before the timings, and the rate, if
+# any, is the number of items processed per second on the median run.
+sub report {
+    my ($name, $runs, %opts) = @_;
+
+    my @runs = sort { $a->{time} <=> $b->{time} }
+               map { ref ? $_ : { time => $_ } } @{$runs};
+    my $median = $runs[$#runs / 2];
+
+    my @fields = @{$opts{params} // []};
+    push @fields, 'runs=' . scalar @runs,
+                  sprintf('min=%.3fs', $runs[0]{time}),
+                  sprintf('median=%.3fs', $median->{time}),
+                  sprintf('max=%.3fs', $runs[-1]{time});
+    if ($opts{rate}) {
+        my ($unit, $n) = @{$opts{rate}};
+
+        push @fields, sprintf('%s/s=%.0f', $unit, $n / $median->{time});
+    }
+    push @fields, $median->{report} if length($median->{report} // '');
+
+    print "$name: @fields\n";
+}
+
+1;
@@ -0,0 +1,94 @@
+#!/usr/bin/perl
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# Benchmark the loading of a large files database.
+#
+# A scratch database gets generated with the file lists for a set of
+# installed packages, which is then fully loaded by a path search, so that
+# each of its paths goes through the files database hash. The size can be
+# tuned with the DPKG_BENCH_PACKAGES, DPKG_BENCH_FILES and DPKG_BENCH_RUNS
+# environment variables.
+
+use strict;
+use warnings;
+
+use File::Path qw(make_path remove_tree);
+use FindBin;
+use lib $FindBin::Bin;
+
+use Bench;
+
+my $tmpdir = bench_tmpdir('filesdb');
+my $admindir = "$tmpdir/admindir";
+
+my $npkgs = bench_param('PACKAGES', 1000);
+my $nfiles = bench_param('FILES', 1000000);
+my $nruns = bench_param('RUNS', 3);
+my $files_per_dir = 100;
+
+my @dpkg_query = (bench_program('src/dpkg-query'), "--admindir=$admindir");
+
+sub setup {
+    make_path("$admindir/info", "$admindir/updates");
+
+    open my $status_fh, '>', "$admindir/status"
+        or die "cannot create $admindir/status: $!\n";
+
+    my $npaths = 0;
+    my $files_per_pkg = int($nfiles / $npkgs) || 1;
+
+    for my $p (0 .. $npkgs - 1) {
+        my $pkg = sprintf 'bench-pkg%05d', $p;
+
+        print { $status_fh } status_stanza($pkg);
+
+        # The shared directories are listed by every package, as usual.
+        open my $list_fh, '>', "$admindir/info/$pkg.list"
+            or die "cannot create $admindir/info/$pkg.list: $!\n";
+        print { $list_fh } "/.\n/usr\n/usr/share\n/usr/share/$pkg\n";
+        $npaths += 4;
+
+        for my $i (0 .. $files_per_pkg - 1) {
+            if ($i % $files_per_dir == 0) {
+                printf { $list_fh } "/usr/share/%s/d%05d\n",
+                       $pkg, $i / $files_per_dir;
+                $npaths++;
+            }
+            printf { $list_fh } "/usr/share/%s/d%05d/file-%05d\n",
+                   $pkg, $i / $files_per_dir, $i;
+            $npaths++;
+        }
+        close $list_fh;
+    }
+    close $status_fh;
+
+    return $npaths;
+}
+
+my $npaths = setup();
+my $needle = sprintf '/usr/share/bench-pkg%05d/d00000/file-00000',
+                     $npkgs - 1;
+my @times;
+
+for my $run (1 .. $nruns) {
+    push @times, time_command("@dpkg_query --search $needle >/dev/null",
+                              'dpkg-query --search');
+}
+
+report('filesdb', \@times,
+       params => [ "packages=$npkgs", "paths=$npaths" ],
+       rate => [ paths => $npaths ]);
+
+remove_tree($tmpdir);
@@ -0,0 +1,260 @@
+#!/usr/bin/perl
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# Benchmark the installation, upgrade and removal of packages.
+#
+# Synthetic packages of several shapes get built with dpkg-deb, and then
+# installed, reinstalled and purged in a scratch root directory, with the
+# time spent on each processing phase and the number of fsync() and
+# rename() calls being taken from the dpkg --perf-fd report.
+#
+# The shapes to run can be selected with the DPKG_BENCH_SHAPES environment
+# variable, and their size tuned with the DPKG_BENCH_FILES, DPKG_BENCH_HUGE,
+# DPKG_BENCH_DEPTH, DPKG_BENCH_CONFFILES, DPKG_BENCH_TRIGGERS and
+# DPKG_BENCH_RUNS environment variables.
+
+use strict;
+use warnings;
+
+use File::Basename;
+use File::Path qw(make_path remove_tree);
+use FindBin;
+use lib $FindBin::Bin;
+
+use Bench;
+
+my $tmpdir = bench_tmpdir('install');
+my $pkgdir = "$tmpdir/pkgs";
+my $rootdir = "$tmpdir/root";
+my $admindir = "$rootdir/var/lib/dpkg";
+my $perffile = "$tmpdir/perf";
+
+my $nfiles = bench_param('FILES', 5000);
+my $huge_size = bench_param('HUGE', 32);
+my $depth = bench_param('DEPTH', 32);
+my $nconffiles = bench_param('CONFFILES', 500);
+my $ntriggers = bench_param('TRIGGERS', 50);
+my $nruns = bench_param('RUNS', 3);
+my @shapes = split ' ', bench_param('SHAPES',
+                                    'tiny huge deep conffiles triggers');
+
+my @dpkg_deb = (bench_program('dpkg-deb/dpkg-deb'), '-Zgzip', '-z1');
+my @dpkg = (bench_program('src/dpkg'), "--root=$rootdir",
+            "--admindir=$admindir", '--log=/dev/null', '--force-not-root',
+            '--force-bad-path', '--perf-fd', '3');
+
+# Make sure we use the programs being benchmarked, also for the dpkg-deb
+# backend run by dpkg.
+$ENV{PATH} = dirname($dpkg_deb[0]) . ':' . dirname($dpkg[0]) . ":$ENV{PATH}";
+
+sub build_pkg {
+    my ($pkg, %opts) = @_;
+    my $dir = "$pkgdir/$pkg";
+
+    make_path("$dir/DEBIAN");
+    chmod 0755, "$dir/DEBIAN";
+
+    write_file("$dir/DEBIAN/control", <<"CONTROL");
+Package: $pkg
+Version: 1.0
+Architecture: all
+Maintainer: Dpkg Developers <debian-dpkg\@lists.debian.org>
+Description: synthetic $opts{desc} package
+CONTROL
+
+    $opts{populate}->($dir);
+
+    if (@{$opts{conffiles} // []}) {
+        write_file("$dir/DEBIAN/conffiles",
+                   join '', map { "$_\n" } @{$opts{conffiles}});
+    }
+    if ($opts{triggers}) {
+        write_file("$dir/DEBIAN/triggers", $opts{triggers});
+    }
+
+    system("@dpkg_deb --build $dir $pkgdir/$pkg.deb >/dev/null") == 0
+        or die "cannot build $pkg\n";
+    remove_tree($dir);
+
+    return "$pkgdir/$pkg.deb";
+}
+
+sub populate_files {
+    my ($dir, $base, $n, $size) = @_;
+    my $data = 'x' x $size;
+    my $subdir;
+
+    for my $i (0 .. $n - 1) {
+        if ($i % 100 == 0) {
+            $subdir = sprintf '%s/d%05d', $base, $i / 100;
+            make_path("$dir$subdir");
+        }
+        write_file(sprintf('%s%s/f%05d', $dir, $subdir, $i), $data);
+    }
+}
+
+# Each shape returns the packages to benchmark, and the ones that need to be
+# installed beforehand, if any.
+my %shapes = (
+    # Many tiny files.
+    tiny => sub {
+        return [ ], build_pkg('bench-tiny', desc => 'many tiny files',
+            populate => sub {
+                populate_files($_[0], '/usr/share/bench-tiny', $nfiles, 16);
+            });
+    },
+    # A few huge files.
+    huge => sub {
+        return [ ], build_pkg('bench-huge', desc => 'few huge files',
+            populate => sub {
+                my $dir = "$_[0]/usr/share/bench-huge";
+                my $block = pack('N', 0) x 16384;
+
+                make_path($dir);
+                for my $i (1 .. 4) {
+                    open my $fh, '>', "$dir/huge$i"
+                        or die "cannot create $dir/huge$i: $!\n";
+                    for my $j (1 .. $huge_size * 16) {
+                        # Vary the contents, so that they do not compress
+                        # to nothing.
+                        substr($block, ($j * 4099) % 65532, 4, pack 'N', $j);
+                        print { $fh } $block;
+                    }
+                    close $fh;
+                }
+            });
+    },
+    # Deep directory trees.
+    deep => sub {
+        return [ ], build_pkg('bench-deep', desc => 'deep trees',
+            populate => sub {
+                my $dir = shift;
+
+                for my $tree (0 .. $nfiles / $depth / 4) {
+                    my $path = "/usr/share/bench-deep/t$tree";
+
+                    for my $level (1 .. $depth) {
+                        $path .= "/l$level";
+                        make_path("$dir$path");
+                        write_file("$dir$path/f$_", "$level\n") for 1 .. 3;
+                    }
+                }
+            });
+    },
+    # Many conffiles.
+    conffiles => sub {
+        my @conffiles = map { sprintf '/etc/bench-conffiles/c%05d', $_ }
+                        0 .. $nconffiles - 1;
+
+        return [ ], build_pkg('bench-conffiles', desc => 'many conffiles',
+            conffiles => \@conffiles,
+            populate => sub {
+                my $dir = shift;
+
+                make_path("$dir/etc/bench-conffiles");
+                write_file("$dir$_", "option = $_\n") foreach @conffiles;
+            });
+    },
+    # Many packages activating a file trigger, all handled by the same
+    # already installed package, as the man-db or desktop-file-utils ones.
+    triggers => sub {
+        my ($handler, @debs);
+
+        $handler = build_pkg('bench-trigger-handler',
+            desc => 'file trigger handler',
+            triggers => "interest /usr/share/bench-triggers\n",
+            populate => sub {
+                my $dir = shift;
+
+                make_path("$dir/usr/share/bench-triggers",
+                          "$dir/usr/share/bench-trigger-handler");
+                write_file("$dir/usr/share/bench-trigger-handler/handler",
+                           "handler\n");
+            });
+        for my $i (1 .. $ntriggers) {
+            push @debs, build_pkg("bench-trigger$i",
+                desc => 'file trigger activator',
+                populate => sub {
+                    populate_files($_[0], "/usr/share/bench-triggers/p$i",
+                                   $nfiles / $ntriggers, 64);
+                });
+        }
+
+        return [ $handler ], @debs;
+    },
+);
+
+sub pkg_name {
+    my $deb = shift;
+
+    return $deb =~ s{^.*/(.*)\.deb$}{$1}r;
+}
+
+sub run_dpkg {
+    my @args = @_;
+    my (%perf, @order);
+
+    my $elapsed = time_command("@dpkg @args >/dev/null 3>$perffile",
+                               "dpkg @args");
+
+    open my $perf_fh, '<', $perffile or die "cannot open $perffile: $!\n";
+    while (<$perf_fh>) {
+        if (m/^phase: (\S+): count=\d+ wall=([0-9.]+) /) {
+            push @order, $1;
+            $perf{$1} = sprintf '%.3fs', $2;
+        } elsif (m/^counter: (\S+): (\d+)$/) {
+            push @order, $1;
+            $perf{$1} = $2;
+        }
+    }
+    close $perf_fh;
+
+    return {
+        time => $elapsed,
+        report => join ' ', map { "$_=$perf{$_}" } @order,
+    };
+}
+
+foreach my $shape (@shapes) {
+    die "unknown package shape $shape\n" if not exists $shapes{$shape};
+
+    remove_tree($pkgdir);
+    make_path($pkgdir);
+
+    my ($setup_debs, @debs) = $shapes{$shape}->();
+    my @setup_pkgs = map { pkg_name($_) } @{$setup_debs};
+    my @pkgs = map { pkg_name($_) } @debs;
+    my (@install, @upgrade, @purge);
+
+    for my $run (1 .. $nruns) {
+        remove_tree($rootdir);
+        make_path("$admindir/info", "$admindir/updates");
+        write_file("$admindir/status", '');
+
+        run_dpkg('--install', @{$setup_debs}) if @setup_pkgs;
+        push @install, run_dpkg('--install', @debs);
+        push @upgrade, run_dpkg('--install', @debs);
+        push @purge, run_dpkg('--purge', @pkgs);
+        run_dpkg('--purge', @setup_pkgs) if @setup_pkgs;
+
+        die "files left behind after purge\n" if -e "$rootdir/usr/share";
+    }
+
+    report("install $shape", \@install);
+    report("upgrade $shape", \@upgrade);
+    report("purge $shape", \@purge);
+}
+
+remove_tree($tmpdir);
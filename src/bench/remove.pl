@@ -0,0 +1,82 @@
+#!/usr/bin/perl
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# Benchmark the removal of a package with a large number of files.
+#
+# The package is registered directly in a scratch database, so that only
+# the removal itself gets measured. The size can be tuned with the
+# DPKG_BENCH_FILES and DPKG_BENCH_RUNS environment variables.
+
+use strict;
+use warnings;
+
+use File::Path qw(make_path remove_tree);
+use FindBin;
+use lib $FindBin::Bin;
+
+use Bench;
+
+my $tmpdir = bench_tmpdir('remove');
+my $admindir = "$tmpdir/admindir";
+my $instdir = "$tmpdir/instdir";
+
+my $nfiles = bench_param('FILES', 50000);
+my $nruns = bench_param('RUNS', 3);
+my $files_per_dir = 100;
+my $pkg = 'bench-remove';
+
+my @dpkg = (bench_program('src/dpkg'), "--admindir=$admindir",
+            "--instdir=$instdir", '--log=/dev/null',
+            '--force-not-root', '--force-bad-path');
+
+sub setup {
+    remove_tree($admindir, $instdir);
+    make_path("$admindir/info", "$admindir/updates", "$instdir/$pkg");
+
+    write_file("$admindir/status", status_stanza($pkg));
+
+    open my $list_fh, '>', "$admindir/info/$pkg.list"
+        or die "cannot create $admindir/info/$pkg.list: $!\n";
+    print { $list_fh } "/.\n/$pkg\n";
+
+    my $dir;
+    for my $i (0 .. $nfiles - 1) {
+        if ($i % $files_per_dir == 0) {
+            $dir = sprintf '/%s/d%05d', $pkg, $i / $files_per_dir;
+            make_path("$instdir$dir");
+            print { $list_fh } "$dir\n";
+        }
+
+        my $file = sprintf '%s/f%05d', $dir, $i;
+        write_file("$instdir$file", '');
+        print { $list_fh } "$file\n";
+    }
+    close $list_fh;
+}
+
+my @times;
+
+for my $run (1 .. $nruns) {
+    setup();
+
+    push @times, time_command("@dpkg --remove $pkg >/dev/null",
+                              'dpkg --remove');
+
+    die "files left behind after removal\n" if -e "$instdir/$pkg";
+}
+
+report('remove', \@times, params => [ "files=$nfiles" ]);
+
+remove_tree($tmpdir);
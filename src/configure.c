@@ -31,6 +31,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdint.h>
 #include <ctype.h>
 #include <string.h>
 #include <time.h>
@@ -48,11 +49,13 @@
 #include <dpkg/pkg.h>
 #include <dpkg/string.h>
 #include <dpkg/buffer.h>
+#include <dpkg/fdio.h>
 #include <dpkg/file.h>
 #include <dpkg/path.h>
 #include <dpkg/subproc.h>
 #include <dpkg/command.h>
 #include <dpkg/triglib.h>
+#include <dpkg/perf.h>
 
 #include "filesdb.h"
 #include "main.h"
@@ -379,6 +382,7 @@ deferred_configure_conffile(struct pkginfo *pkg, struct conffile *conff)
 	rc = conffderef(pkg, &cdr, usenode->name);
 	if (rc == -1) {
 		conff->hash = EMPTYHASHFLAG;
+		pkg_invalidate_stanza(pkg);
 		return;
 	}
 	md5hash(pkg, currenthash, cdr.buf);
@@ -472,6 +476,7 @@ deferred_configure_conffile(struct pkginfo *pkg, struct conffile *conff)
 		varbuf_end_str(&cdr);
 		strcpy(cdr2rest, DPKGNEWEXT);
 		trig_path_activate(usenode, pkg);
+		perf_count("rename", 1);
 		if (rename(cdr2.buf, cdr.buf))
 			warning(_("%s: failed to rename '%.250s' to '%.250s': %s"),
 			        pkg_name(pkg, pnaw_nonambig), cdr2.buf, cdr.buf,
@@ -508,6 +513,7 @@ deferred_configure_conffile(struct pkginfo *pkg, struct conffile *conff)
 	case CFO_NEW_CONFF:
 		strcpy(cdr2rest, DPKGNEWEXT);
 		trig_path_activate(usenode, pkg);
+		perf_count("rename", 1);
 		if (rename(cdr2.buf, cdr.buf))
 			ohshite(_("unable to install '%.250s' as '%.250s'"),
 			        cdr2.buf, cdr.buf);
@@ -523,6 +529,64 @@ deferred_configure_conffile(struct pkginfo *pkg, struct conffile *conff)
 	varbuf_destroy(&cdr2);
 }
 
+/**
+ * Hash concurrently all the conffiles of a package, both the installed
+ * and new distributed versions, before going through them one by one.
+ *
+ * Only the names resolving to regular files, following any symlinks in the
+ * same way md5hash() does, are hashed here, anything else gets handled when
+ * processing each conffile.
+ *
+ * @param pkg The package being configured.
+ */
+static void
+deferred_configure_hash_conffiles(struct pkginfo *pkg)
+{
+	struct conffile *conff;
+	const char **names;
+	int nnames = 0, nconffs = 0;
+
+	for (conff = pkg->installed.conffiles; conff; conff = conff->next)
+		nconffs++;
+	if (nconffs == 0)
+		return;
+
+	names = m_malloc(sizeof(*names) * nconffs * 2);
+
+	for (conff = pkg->installed.conffiles; conff; conff = conff->next) {
+		struct filenamenode *usenode;
+
+		if (conff->obsolete)
+			continue;
+
+		usenode = namenodetouse(findnamenode(conff->name, fnn_nocopy),
+		                        pkg, &pkg->installed);
+
+		names[nnames++] = str_fmt("%s%s", instdir, usenode->name);
+		names[nnames++] = str_fmt("%s%s" DPKGNEWEXT, instdir,
+		                          usenode->name);
+	}
+
+	md5hash_batch(names, nnames);
+
+	while (nnames)
+		free((char *)names[--nnames]);
+	free(names);
+}
+
+/**
+ * Finish configuring a package after its postinst has been run.
+ *
+ * @param pkg The package to act on.
+ */
+static void
+deferred_configure_done(struct pkginfo *pkg)
+{
+	pkg_reset_eflags(pkg);
+	pkg->trigpend_head = NULL;
+	post_postinst_tasks(pkg, PKG_STAT_INSTALLED);
+}
+
 /**
  * Process the deferred configure package.
  *
@@ -671,6 +735,7 @@ deferred_configure(struct pkginfo *pkg)
 		 * version is in the conffiles data for the package. If
 		 * ‘*.dpkg-new’ no longer exists we assume that we've
 		 * already processed this one. */
+		deferred_configure_hash_conffiles(pkg);
 		for (conff = pkg->installed.conffiles; conff; conff = conff->next) {
 			if (conff->obsolete)
 				continue;
@@ -684,15 +749,11 @@ deferred_configure(struct pkginfo *pkg)
 
 	modstatdb_note(pkg);
 
-	maintscript_postinst(pkg, "configure",
-	                     dpkg_version_is_informative(&pkg->configversion) ?
-	                     versiondescribe(&pkg->configversion,
-	                                     vdew_nonambig) : "",
-	                     NULL);
-
-	pkg_reset_eflags(pkg);
-	pkg->trigpend_head = NULL;
-	post_postinst_tasks(pkg, PKG_STAT_INSTALLED);
+	maintscript_postinst_job(pkg, deferred_configure_done, "configure",
+	                         dpkg_version_is_informative(&pkg->configversion) ?
+	                         versiondescribe(&pkg->configversion,
+	                                         vdew_nonambig) : "",
+	                         NULL);
 }
 
 /**
@@ -801,6 +862,94 @@ conffderef(struct pkginfo *pkg, struct varbuf *result, const char *in)
 	}
 }
 
+/*
+ * Per-run cache of file contents hashes, keyed by inode, so that files
+ * get hashed at most once, even if referred to from different places or
+ * at different stages. An entry is only used if the size, modification
+ * and change times of the inode still match the ones recorded with it.
+ */
+
+#define MD5HASH_CACHE_BINS	4093
+
+struct md5hash_cache_entry {
+	struct md5hash_cache_entry *next;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	struct timespec ctime;
+	char hash[MD5HASHLEN + 1];
+};
+
+static struct md5hash_cache_entry *md5hash_cache[MD5HASH_CACHE_BINS];
+
+static struct md5hash_cache_entry **
+md5hash_cache_bin(const struct stat *st)
+{
+	return &md5hash_cache[(st->st_ino ^ st->st_dev) % MD5HASH_CACHE_BINS];
+}
+
+static const char *
+md5hash_cache_get(const struct stat *st)
+{
+	struct md5hash_cache_entry *entry;
+	struct timespec mtime, ctime;
+
+	for (entry = *md5hash_cache_bin(st); entry; entry = entry->next) {
+		if (entry->ino != st->st_ino || entry->dev != st->st_dev)
+			continue;
+		file_stat_mtime(st, &mtime);
+		file_stat_ctime(st, &ctime);
+		if (entry->size != st->st_size ||
+		    entry->mtime.tv_sec != mtime.tv_sec ||
+		    entry->mtime.tv_nsec != mtime.tv_nsec ||
+		    entry->ctime.tv_sec != ctime.tv_sec ||
+		    entry->ctime.tv_nsec != ctime.tv_nsec)
+			return NULL;
+		return entry->hash;
+	}
+
+	return NULL;
+}
+
+static void
+md5hash_cache_set(const struct stat *st, const char *hash)
+{
+	struct md5hash_cache_entry **bin, *entry;
+
+	bin = md5hash_cache_bin(st);
+	for (entry = *bin; entry; entry = entry->next)
+		if (entry->ino == st->st_ino && entry->dev == st->st_dev)
+			break;
+
+	if (entry == NULL) {
+		entry = m_malloc(sizeof(*entry));
+		entry->dev = st->st_dev;
+		entry->ino = st->st_ino;
+		entry->next = *bin;
+		*bin = entry;
+	}
+	entry->size = st->st_size;
+	file_stat_mtime(st, &entry->mtime);
+	file_stat_ctime(st, &entry->ctime);
+	strcpy(entry->hash, hash);
+}
+
+/**
+ * Record the already known contents hash for a file.
+ *
+ * @param fn The filename.
+ * @param hash The hash of its contents.
+ */
+void
+md5hash_note(const char *fn, const char *hash)
+{
+	struct stat st;
+
+	if (lstat(fn, &st) == 0 && S_ISREG(st.st_mode))
+		md5hash_cache_set(&st, hash);
+}
+
 /**
  * Generate a file contents MD5 hash.
  *
@@ -820,10 +969,22 @@ md5hash(struct pkginfo *pkg, char *hashbuf, const char *fn)
 	fd = open(fn, O_RDONLY);
 
 	if (fd >= 0) {
+		struct stat st;
+		const char *hash;
+		bool cache;
+
 		push_cleanup(cu_closefd, ehflag_bombout, NULL, 0, 1, &fd);
-		if (fd_md5(fd, hashbuf, -1, &err) < 0)
-			ohshit(_("cannot compute MD5 hash for file '%s': %s"),
-			       fn, err.str);
+		cache = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+		hash = cache ? md5hash_cache_get(&st) : NULL;
+		if (hash) {
+			strcpy(hashbuf, hash);
+		} else {
+			if (fd_md5(fd, hashbuf, -1, &err) < 0)
+				ohshit(_("cannot compute MD5 hash for file '%s': %s"),
+				       fn, err.str);
+			if (cache)
+				md5hash_cache_set(&st, hashbuf);
+		}
 		pop_cleanup(ehflag_normaltidy); /* fd = open(cdr.buf) */
 		close(fd);
 	} else if (errno == ENOENT) {
@@ -834,3 +995,126 @@ md5hash(struct pkginfo *pkg, char *hashbuf, const char *fn)
 		strcpy(hashbuf, EMPTYHASHFLAG);
 	}
 }
+
+/* Do not bother spawning hashing workers for less data than this. */
+#define MD5HASH_BATCH_MIN_SIZE	(256 * 1024)
+#define MD5HASH_BATCH_MAX_JOBS	8
+
+struct md5hash_batch_result {
+	int index;
+	struct stat st;
+	char hash[MD5HASHLEN + 1];
+};
+
+static void DPKG_ATTR_NORET
+md5hash_batch_worker(const char **names, int nnames, int job, int njobs,
+                     int fd_out)
+{
+	int i;
+
+	for (i = job; i < nnames; i += njobs) {
+		struct md5hash_batch_result res;
+		struct dpkg_error err;
+		int fd;
+
+		if (names[i] == NULL)
+			continue;
+
+		fd = open(names[i], O_RDONLY);
+		if (fd < 0)
+			continue;
+
+		/* Errors are left for md5hash() to diagnose later on. */
+		memset(&res, 0, sizeof(res));
+		res.index = i;
+		if (fstat(fd, &res.st) < 0 ||
+		    fd_md5(fd, res.hash, -1, &err) < 0) {
+			close(fd);
+			continue;
+		}
+		close(fd);
+
+		/* Each result is written atomically, as it is shorter than
+		 * PIPE_BUF, so all workers can share the same pipe. */
+		if (fd_write(fd_out, &res, sizeof(res)) < 0)
+			_exit(1);
+	}
+
+	_exit(0);
+}
+
+/**
+ * Hash a batch of files concurrently, ahead of their md5hash() calls.
+ *
+ * The results go into the hash cache, so that md5hash() does not need to
+ * read the files again. Files which are already cached, or which are not
+ * regular files, are skipped; and any error is left for md5hash() to
+ * report.
+ *
+ * @param names The filenames to hash.
+ * @param nnames The number of filenames.
+ */
+void
+md5hash_batch(const char **names, int nnames)
+{
+	struct md5hash_batch_result res;
+	pid_t pids[MD5HASH_BATCH_MAX_JOBS];
+	const char **todo;
+	off_t size = 0;
+	long ncpus;
+	int ntodo = 0;
+	int njobs, i;
+	int p[2];
+
+	todo = m_malloc(sizeof(*todo) * nnames);
+	for (i = 0; i < nnames; i++) {
+		struct stat st;
+
+		todo[i] = NULL;
+		if (stat(names[i], &st) < 0 || !S_ISREG(st.st_mode))
+			continue;
+		if (md5hash_cache_get(&st))
+			continue;
+		todo[i] = names[i];
+		size += st.st_size;
+		ntodo++;
+	}
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	njobs = min(ntodo, MD5HASH_BATCH_MAX_JOBS);
+	if (ncpus > 0 && njobs > ncpus)
+		njobs = ncpus;
+
+	debug(dbg_conffdetail, "md5hash_batch files=%d todo=%d size=%jd jobs=%d",
+	      nnames, ntodo, (intmax_t)size, njobs);
+
+	/* Not worth the process overhead, the callers will hash the files
+	 * themselves. */
+	if (njobs < 2 || size < MD5HASH_BATCH_MIN_SIZE) {
+		free(todo);
+		return;
+	}
+
+	m_pipe(p);
+	for (i = 0; i < njobs; i++) {
+		pids[i] = subproc_fork();
+		if (pids[i] == 0) {
+			close(p[0]);
+			md5hash_batch_worker(todo, nnames, i, njobs, p[1]);
+		}
+	}
+	close(p[1]);
+
+	while (fd_read(p[0], &res, sizeof(res)) == sizeof(res)) {
+		if (res.index < 0 || res.index >= nnames || todo[res.index] == NULL)
+			continue;
+		res.hash[MD5HASHLEN] = '\0';
+		md5hash_cache_set(&res.st, res.hash);
+	}
+	close(p[0]);
+
+	for (i = 0; i < njobs; i++)
+		subproc_reap(pids[i], _("conffile hashing"), SUBPROC_WARN);
+
+	free(todo);
+}
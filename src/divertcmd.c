@@ -62,6 +62,10 @@ static int opt_verbose = 1;
 static int opt_test = 0;
 static int opt_rename = 0;
 
+static int divertdb_lock_fd = -1;
+static bool divertdb_batch = false;
+static bool divertdb_modified = false;
+
 
 static void
 printversion(const struct cmdinfo *cip, const char *value)
@@ -92,6 +96,8 @@ usage(const struct cmdinfo *cip, const char *value)
 "  --list [<glob-pattern>]  show file diversions.\n"
 "  --listpackage <file>     show what package diverts the file.\n"
 "  --truename <file>        return the diverted file.\n"
+"  --batch [<file>|-]       run the commands in <file>, one per line, and\n"
+"                             write the database only once.\n"
 "\n"));
 
 	printf(_(
@@ -266,6 +272,16 @@ file_rename(struct file *src, struct file *dst)
 	}
 }
 
+struct divert_rename {
+	struct divert_rename *next;
+	struct file src;
+	struct file dst;
+};
+
+/* The renames from a batch, done once the database has been written. */
+static struct divert_rename *divertdb_renames = NULL;
+static struct divert_rename **divertdb_renames_tail = &divertdb_renames;
+
 static void
 diversion_check_filename(const char *filename)
 {
@@ -351,32 +367,54 @@ diversion_describe(struct diversion *d)
 	return varbuf_diversion(&str, pkgname, name_from, name_to);
 }
 
+/*
+ * Serialize the database read-modify-write cycle against other instances,
+ * which might be run concurrently from maintainer scripts.
+ */
+static void
+divertdb_lock(void)
+{
+	char *lockfile;
+
+	lockfile = dpkg_db_get_path(DIVERSIONSLOCKFILE);
+
+	divertdb_lock_fd = open(lockfile, O_RDWR | O_CREAT, 0600);
+	if (divertdb_lock_fd < 0) {
+		/* The database cannot be written either, let that report it. */
+		if (errno == EACCES || errno == EROFS) {
+			free(lockfile);
+			return;
+		}
+		ohshite(_("unable to open/create diversions lock file '%.250s'"),
+		        lockfile);
+	}
+
+	file_lock(&divertdb_lock_fd, FILE_LOCK_WAIT, lockfile,
+	          _("diversions database"));
+
+	free(lockfile);
+}
+
 static void
 divertdb_write(void)
 {
 	char *dbname;
 	struct atomic_file *file;
-	struct fileiterator *iter;
-	struct filenamenode *namenode;
+	struct diversion_iterator *iter;
+	struct diversion *d;
 
 	dbname = dpkg_db_get_path(DIVERSIONSFILE);
 
 	file = atomic_file_new(dbname, ATOMIC_FILE_BACKUP);
 	atomic_file_open(file);
 
-	iter = files_db_iter_new();
-	while ((namenode = files_db_iter_next(iter))) {
-		struct diversion *d = namenode->divert;
-
-		if (d == NULL || d->useinstead == NULL)
-			continue;
-
+	iter = diversion_iter_new();
+	while ((d = diversion_iter_next(iter)))
 		fprintf(file->fp, "%s\n%s\n%s\n",
 		        d->useinstead->divert->camefrom->name,
 		        d->useinstead->name,
 		        diversion_pkg_name(d));
-	}
-	files_db_iter_free(iter);
+	diversion_iter_free(iter);
 
 	atomic_file_sync(file);
 	atomic_file_close(file);
@@ -411,12 +449,91 @@ diversion_is_owned_by_self(struct pkgset *set, struct filenamenode *namenode)
 	return owned;
 }
 
+static void
+divertdb_commit(void)
+{
+	/* In batch mode the database gets written once at the end. */
+	if (divertdb_batch)
+		divertdb_modified = true;
+	else
+		divertdb_write();
+}
+
+/*
+ * Move a file aside for a diversion that has been committed. In batch mode
+ * the rename is queued until the database recording the diversion has been
+ * written, as otherwise an abrupt stop would leave the file moved with no
+ * diversion to protect its original name.
+ */
+static void
+divertdb_commit_rename(struct file *src, struct file *dst)
+{
+	struct divert_rename *r;
+
+	if (!divertdb_batch) {
+		file_rename(src, dst);
+		return;
+	}
+
+	r = m_malloc(sizeof(*r));
+	r->next = NULL;
+	r->src = *src;
+	r->src.name = m_strdup(src->name);
+	r->dst = *dst;
+	r->dst.name = m_strdup(dst->name);
+
+	*divertdb_renames_tail = r;
+	divertdb_renames_tail = &r->next;
+}
+
+/* Write the pending batch changes, and then do the queued renames. */
+static void
+divertdb_sync(void)
+{
+	struct divert_rename *r;
+
+	if (divertdb_modified) {
+		divertdb_write();
+		divertdb_modified = false;
+	}
+
+	while ((r = divertdb_renames)) {
+		divertdb_renames = r->next;
+		if (divertdb_renames == NULL)
+			divertdb_renames_tail = &divertdb_renames;
+
+		file_rename(&r->src, &r->dst);
+
+		free((char *)r->src.name);
+		free((char *)r->dst.name);
+		free(r);
+	}
+}
+
+static void
+cu_diversion_link(int argc, void **argv)
+{
+	struct diversion *contest = argv[0];
+
+	diversion_unlink(contest);
+}
+
+static void
+cu_diversion_unlink(int argc, void **argv)
+{
+	struct filenamenode *fnn_from = argv[0];
+	struct filenamenode *fnn_to = argv[1];
+	struct pkgset *pkgset = argv[2];
+
+	diversion_link(fnn_from, fnn_to, pkgset);
+}
+
 static int
 diversion_add(const char *const *argv)
 {
 	const char *filename = argv[0];
 	struct file file_from, file_to;
-	struct diversion *contest, *altname;
+	struct diversion *contest;
 	struct filenamenode *fnn_from, *fnn_to;
 	struct pkgset *pkgset;
 
@@ -474,19 +591,10 @@ diversion_add(const char *const *argv)
 		       diversion_describe(fnn_to->divert));
 	}
 
-	/* Create new diversion. */
-	contest = nfmalloc(sizeof(*contest));
-	altname = nfmalloc(sizeof(*altname));
-
-	altname->camefrom = fnn_from;
-	altname->camefrom->divert = contest;
-	altname->useinstead = NULL;
-	altname->pkgset = pkgset;
-
-	contest->useinstead = fnn_to;
-	contest->useinstead->divert = altname;
-	contest->camefrom = NULL;
-	contest->pkgset = pkgset;
+	/* Create new diversion, which gets unlinked again on error, so that
+	 * a batch only commits the diversions added successfully. */
+	contest = diversion_link(fnn_from, fnn_to, pkgset);
+	push_cleanup(cu_diversion_link, ~ehflag_normaltidy, NULL, 0, 1, contest);
 
 	/* Update database and file system if needed. */
 	if (opt_verbose > 0)
@@ -501,10 +609,15 @@ diversion_add(const char *const *argv)
 			       filename, pkgset->name);
 		opt_rename = false;
 	}
+
+	pop_cleanup(ehflag_normaltidy);
+
 	if (!opt_test) {
-		divertdb_write();
+		divertdb_commit();
 		if (opt_rename)
-			file_rename(&file_from, &file_to);
+			divertdb_commit_rename(&file_from, &file_to);
+	} else {
+		diversion_unlink(contest);
 	}
 
 	return 0;
@@ -546,7 +659,7 @@ static int
 diversion_remove(const char *const *argv)
 {
 	const char *filename = argv[0];
-	struct filenamenode *namenode;
+	struct filenamenode *namenode, *fnn_from, *fnn_to;
 	struct diversion *contest, *altname;
 	struct file file_from, file_to;
 	struct pkgset *pkgset;
@@ -601,20 +714,31 @@ diversion_remove(const char *const *argv)
 	if (opt_verbose > 0)
 		printf(_("Removing '%s'\n"), diversion_describe(contest));
 
+	/* The file might still need to be moved aside by a preceding line. */
+	if (opt_rename && divertdb_renames)
+		divertdb_sync();
+
 	file_init(&file_from, altname->camefrom->name);
 	file_init(&file_to, contest->useinstead->name);
 
-	/* Remove entries from database. */
-	contest->useinstead->divert = NULL;
-	altname->camefrom->divert = NULL;
+	/* Remove entries from database, which get linked back on error. */
+	fnn_from = altname->camefrom;
+	fnn_to = contest->useinstead;
+	diversion_unlink(contest);
+	push_cleanup(cu_diversion_unlink, ~ehflag_normaltidy, NULL, 0,
+	             3, fnn_from, fnn_to, contest->pkgset);
 
 	if (opt_rename)
 		opt_rename = check_rename(&file_to, &file_from);
 	if (opt_rename && !opt_test)
 		file_rename(&file_to, &file_from);
 
+	pop_cleanup(ehflag_normaltidy);
+
 	if (!opt_test)
-		divertdb_write();
+		divertdb_commit();
+	else
+		diversion_link(fnn_from, fnn_to, contest->pkgset);
 
 	return 0;
 }
@@ -622,8 +746,8 @@ diversion_remove(const char *const *argv)
 static int
 diversion_list(const char *const *argv)
 {
-	struct fileiterator *iter;
-	struct filenamenode *namenode;
+	struct diversion_iterator *iter;
+	struct diversion *contest;
 	struct glob_node *glob_list = NULL;
 	const char *pattern;
 
@@ -633,16 +757,12 @@ diversion_list(const char *const *argv)
 	if (glob_list == NULL)
 		glob_list_prepend(&glob_list, m_strdup("*"));
 
-	iter = files_db_iter_new();
-	while ((namenode = files_db_iter_next(iter))) {
+	iter = diversion_iter_new();
+	while ((contest = diversion_iter_next(iter))) {
 		struct glob_node *g;
-		struct diversion *contest = namenode->divert;
 		struct diversion *altname;
 		const char *pkgname;
 
-		if (contest->useinstead == NULL)
-			continue;
-
 		altname = contest->useinstead->divert;
 
 		pkgname = diversion_pkg_name(contest);
@@ -656,7 +776,7 @@ diversion_list(const char *const *argv)
 			}
 		}
 	}
-	files_db_iter_free(iter);
+	diversion_iter_free(iter);
 
 	glob_list_free(glob_list);
 
@@ -738,12 +858,84 @@ set_divertto(const struct cmdinfo *cip, const char *value)
 static const struct cmdinfo cmdinfo_add =
 	ACTION("add",         0, 0, diversion_add);
 
+static bool batch_pkgname_match_any;
+static const char *batch_pkgname;
+static const char *batch_divertto;
+static int batch_verbose;
+static int batch_test;
+static int batch_rename;
+
+static void
+diversion_batch_reset(void)
+{
+	opt_pkgname_match_any = batch_pkgname_match_any;
+	opt_pkgname = batch_pkgname;
+	opt_divertto = batch_divertto;
+	opt_verbose = batch_verbose;
+	opt_test = batch_test;
+	opt_rename = batch_rename;
+}
+
+static void
+cu_divertdb_batch(int argc, void **argv)
+{
+	/* Keep the changes from the commands that did complete. */
+	divertdb_sync();
+}
+
+static const struct cmdinfo cmdinfos_batch[] = {
+	ACTION("add",         0, 0, diversion_add),
+	ACTION("remove",      0, 0, diversion_remove),
+	ACTION("list",        0, 0, diversion_list),
+	ACTION("listpackage", 0, 0, diversion_listpackage),
+	ACTION("truename",    0, 0, diversion_truename),
+
+	{ "divert",     0,   1,  NULL,         NULL,      set_divertto  },
+	{ "package",    0,   1,  NULL,         NULL,      set_package   },
+	{ "local",      0,   0,  NULL,         NULL,      set_package   },
+	{ "quiet",      0,   0,  &opt_verbose, NULL,      NULL, 0       },
+	{ "rename",     0,   0,  &opt_rename,  NULL,      NULL, 1       },
+	{ "test",       0,   0,  &opt_test,    NULL,      NULL, 1       },
+	{  NULL,        0                                               }
+};
+
+static int
+diversion_batch(const char *const *argv)
+{
+	const char *filename = argv[0];
+	int ret;
+
+	if (filename && argv[1])
+		badusage(_("--%s takes at most one argument"), cipaction->olong);
+
+	/* The options given on the command line are the defaults. */
+	batch_pkgname_match_any = opt_pkgname_match_any;
+	batch_pkgname = opt_pkgname;
+	batch_divertto = opt_divertto;
+	batch_verbose = opt_verbose;
+	batch_test = opt_test;
+	batch_rename = opt_rename;
+
+	divertdb_batch = true;
+	push_cleanup(cu_divertdb_batch, ehflag_bombout, NULL, 0, 0);
+
+	ret = dpkg_options_run_batch(filename ? filename : "-", cmdinfos_batch,
+	                             &cmdinfo_add, diversion_batch_reset);
+
+	pop_cleanup(ehflag_normaltidy);
+
+	divertdb_sync();
+
+	return ret;
+}
+
 static const struct cmdinfo cmdinfos[] = {
 	ACTION("add",         0, 0, diversion_add),
 	ACTION("remove",      0, 0, diversion_remove),
 	ACTION("list",        0, 0, diversion_list),
 	ACTION("listpackage", 0, 0, diversion_listpackage),
 	ACTION("truename",    0, 0, diversion_truename),
+	ACTION("batch",       0, 0, diversion_batch),
 
 	{ "admindir",   0,   1,  NULL,         &admindir, NULL          },
 	{ "divert",     0,   1,  NULL,         NULL,      set_divertto  },
@@ -776,12 +968,20 @@ main(int argc, const char * const *argv)
 	if (!cipaction)
 		setaction(&cmdinfo_add, NULL);
 
+	if (cipaction->action == diversion_add ||
+	    cipaction->action == diversion_remove ||
+	    cipaction->action == diversion_batch)
+		divertdb_lock();
+
 	modstatdb_open(msdbrw_readonly);
 	filesdbinit();
 	ensure_diversions();
 
 	ret = cipaction->action(argv);
 
+	if (divertdb_lock_fd >= 0)
+		pop_cleanup(ehflag_normaltidy);
+
 	modstatdb_shutdown();
 
 	dpkg_program_done();
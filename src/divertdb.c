@@ -40,9 +40,108 @@
 #include "filesdb.h"
 #include "main.h"
 
+/* The ‘contested’ halves, in database order, so that resetting or
+ * walking the diversions costs O(diversions) instead of O(all files). */
 static struct diversion *diversions = NULL;
+static struct diversion **diversions_tail = &diversions;
 static char *diversionsname;
 
+/* The diversions, released on each reload. */
+static struct nfarena *diversions_arena;
+
+/**
+ * Create a new diversion of from to to, and link it into the database.
+ *
+ * @return The ‘contested’ half of the diversion.
+ */
+struct diversion *
+diversion_link(struct filenamenode *from, struct filenamenode *to,
+               struct pkgset *pkgset)
+{
+	struct diversion *contest, *altname;
+
+	if (diversions_arena == NULL)
+		diversions_arena = nfarena_new("diversions");
+
+	contest = nfarena_alloc(diversions_arena, sizeof(*contest));
+	altname = nfarena_alloc(diversions_arena, sizeof(*altname));
+
+	altname->camefrom = from;
+	altname->camefrom->divert = contest;
+	altname->useinstead = NULL;
+	altname->pkgset = pkgset;
+	altname->next = NULL;
+
+	contest->useinstead = to;
+	contest->useinstead->divert = altname;
+	contest->camefrom = NULL;
+	contest->pkgset = pkgset;
+	contest->next = NULL;
+
+	*diversions_tail = contest;
+	diversions_tail = &contest->next;
+
+	return contest;
+}
+
+/**
+ * Unlink a diversion from the database, given its ‘contested’ half.
+ */
+void
+diversion_unlink(struct diversion *contest)
+{
+	struct diversion **dp;
+
+	for (dp = &diversions; *dp; dp = &(*dp)->next) {
+		if (*dp != contest)
+			continue;
+
+		*dp = contest->next;
+		if (diversions_tail == &contest->next)
+			diversions_tail = dp;
+		break;
+	}
+
+	contest->useinstead->divert->camefrom->divert = NULL;
+	contest->useinstead->divert = NULL;
+	contest->next = NULL;
+}
+
+struct diversion_iterator {
+	struct diversion *next;
+};
+
+struct diversion_iterator *
+diversion_iter_new(void)
+{
+	struct diversion_iterator *iter;
+
+	iter = m_malloc(sizeof(*iter));
+	iter->next = diversions;
+
+	return iter;
+}
+
+/**
+ * @return The next ‘contested’ half of the diversions, or NULL.
+ */
+struct diversion *
+diversion_iter_next(struct diversion_iterator *iter)
+{
+	struct diversion *contest = iter->next;
+
+	if (contest)
+		iter->next = contest->next;
+
+	return contest;
+}
+
+void
+diversion_iter_free(struct diversion_iterator *iter)
+{
+	free(iter);
+}
+
 void
 ensure_diversions(void)
 {
@@ -51,7 +150,9 @@ ensure_diversions(void)
 	char linebuf[MAXDIVERTFILENAME];
 	static FILE *file_prev;
 	FILE *file;
-	struct diversion *ov, *oicontest, *oialtname;
+	struct diversion *ov;
+	struct filenamenode *fnn_from, *fnn_to;
+	struct pkgset *pkgset;
 
 	if (diversionsname == NULL)
 		diversionsname = dpkg_db_get_path(DIVERSIONSFILE);
@@ -94,6 +195,9 @@ ensure_diversions(void)
 		ov->useinstead->divert = NULL;
 	}
 	diversions = NULL;
+	diversions_tail = &diversions;
+	if (diversions_arena)
+		nfarena_reset(diversions_arena);
 	if (!file) {
 		onerr_abort--;
 		debug(dbg_general, "%s: none, reseting", __func__);
@@ -102,31 +206,19 @@ ensure_diversions(void)
 	debug(dbg_general, "%s: new, (re)loading", __func__);
 
 	while (fgets_checked(linebuf, sizeof(linebuf), file, diversionsname) >= 0) {
-		oicontest = nfmalloc(sizeof(struct diversion));
-		oialtname = nfmalloc(sizeof(struct diversion));
-
-		oialtname->camefrom = findnamenode(linebuf, 0);
-		oialtname->useinstead = NULL;
+		fnn_from = findnamenode(linebuf, 0);
 
 		fgets_must(linebuf, sizeof(linebuf), file, diversionsname);
-		oicontest->useinstead = findnamenode(linebuf, 0);
-		oicontest->camefrom = NULL;
+		fnn_to = findnamenode(linebuf, 0);
 
 		fgets_must(linebuf, sizeof(linebuf), file, diversionsname);
-		oicontest->pkgset = strcmp(linebuf, ":") ?
-		                    pkg_db_find_set(linebuf) : NULL;
-		oialtname->pkgset = oicontest->pkgset;
+		pkgset = strcmp(linebuf, ":") ? pkg_db_find_set(linebuf) : NULL;
 
-		if (oialtname->camefrom->divert ||
-		    oicontest->useinstead->divert)
+		if (fnn_from->divert || fnn_to->divert)
 			ohshit(_("conflicting diversions involving '%.250s' or '%.250s'"),
-			       oialtname->camefrom->name, oicontest->useinstead->name);
-
-		oialtname->camefrom->divert = oicontest;
-		oicontest->useinstead->divert = oialtname;
+			       fnn_from->name, fnn_to->name);
 
-		oicontest->next = diversions;
-		diversions = oicontest;
+		diversion_link(fnn_from, fnn_to, pkgset);
 	}
 
 	onerr_abort--;
@@ -50,6 +50,7 @@
 #include <dpkg/fdio.h>
 #include <dpkg/pkg-array.h>
 #include <dpkg/progress.h>
+#include <dpkg/perf.h>
 
 #include "filesdb.h"
 #include "infodb.h"
@@ -58,7 +59,8 @@
 /*** filepackages support for tracking packages owning a file. ***/
 
 struct filepackages_iterator {
-  struct pkg_list *pkg_node;
+  struct filenamenode *fnn;
+  int pkg_index;
 };
 
 struct filepackages_iterator *
@@ -67,23 +69,22 @@ filepackages_iter_new(struct filenamenode *fnn)
   struct filepackages_iterator *iter;
 
   iter = m_malloc(sizeof(*iter));
-  iter->pkg_node = fnn->packages;
+  iter->fnn = fnn;
+  iter->pkg_index = fnn->n_pkgs;
 
   return iter;
 }
 
+/* Returns the packages from the most recently loaded one. */
 struct pkginfo *
 filepackages_iter_next(struct filepackages_iterator *iter)
 {
-  struct pkg_list *pkg_node;
-
-  if (iter->pkg_node == NULL)
+  if (iter->pkg_index > iter->fnn->n_pkgs)
+    iter->pkg_index = iter->fnn->n_pkgs;
+  if (iter->pkg_index == 0)
     return NULL;
 
-  pkg_node = iter->pkg_node;
-  iter->pkg_node = pkg_node->next;
-
-  return pkg_node->pkg;
+  return iter->fnn->pkgs[--iter->pkg_index];
 }
 
 void
@@ -97,6 +98,12 @@ filepackages_iter_free(struct filepackages_iterator *iter)
 static bool allpackagesdone = false;
 static int nfiles= 0;
 
+/* The file nodes, and the files lists they might point into. These live
+ * for the whole run, but are kept apart for the usage statistics, which
+ * show how much the stale files lists reloads are costing. */
+static struct nfarena *filesdb_arena;
+static struct nfarena *filelists_arena;
+
 void
 ensure_package_clientdata(struct pkginfo *pkg)
 {
@@ -106,12 +113,15 @@ ensure_package_clientdata(struct pkginfo *pkg)
   pkg->clientdata->istobe = PKG_ISTOBE_NORMAL;
   pkg->clientdata->color = PKG_CYCLE_WHITE;
   pkg->clientdata->enqueued = false;
+  pkg->clientdata->enqueued_configure = false;
   pkg->clientdata->fileslistvalid = false;
   pkg->clientdata->files = NULL;
+  pkg->clientdata->nfiles = 0;
   pkg->clientdata->replacingfilesandsaid = 0;
   pkg->clientdata->cmdline_seen = 0;
   pkg->clientdata->listfile_phys_offs = 0;
   pkg->clientdata->trigprocdeferred = NULL;
+  pkg->clientdata->trigprocpostponed = TRIGPROC_POSTPONE_NONE;
 }
 
 void note_must_reread_files_inpackage(struct pkginfo *pkg) {
@@ -128,77 +138,81 @@ enum pkg_filesdb_load_status {
 
 static enum pkg_filesdb_load_status saidread = PKG_FILESDB_LOAD_NONE;
 
+static void
+filenamenode_add_pkg(struct filenamenode *namenode, struct pkginfo *pkg)
+{
+  if (namenode->n_pkgs == namenode->max_pkgs) {
+    struct pkginfo **pkgs;
+
+    /* The old vector was allocated from an arena, so we shouldn't
+     * free it. */
+    namenode->max_pkgs = namenode->max_pkgs ? namenode->max_pkgs * 2 : 1;
+    pkgs = nfarena_alloc(filesdb_arena, sizeof(*pkgs) * namenode->max_pkgs);
+    if (namenode->n_pkgs)
+      memcpy(pkgs, namenode->pkgs, sizeof(*pkgs) * namenode->n_pkgs);
+    namenode->pkgs = pkgs;
+  }
+
+  namenode->pkgs[namenode->n_pkgs++] = pkg;
+}
+
+static void
+filenamenode_remove_pkg(struct filenamenode *namenode, struct pkginfo *pkg)
+{
+  int i;
+
+  for (i = namenode->n_pkgs - 1; i >= 0; i--) {
+    if (namenode->pkgs[i] != pkg)
+      continue;
+
+    namenode->n_pkgs--;
+    memmove(&namenode->pkgs[i], &namenode->pkgs[i + 1],
+            sizeof(*namenode->pkgs) * (namenode->n_pkgs - i));
+    break;
+  }
+}
+
 /**
  * Erase the files saved in pkg.
  */
 static void
 pkg_files_blank(struct pkginfo *pkg)
 {
-  struct fileinlist *current;
+  int i;
 
   /* Anything to empty? */
   if (!pkg->clientdata)
     return;
 
-  for (current= pkg->clientdata->files;
-       current;
-       current= current->next) {
-    struct pkg_list *pkg_node, *pkg_prev = NULL;
-
-    /* For each file that used to be in the package,
-     * go through looking for this package's entry in the list
-     * of packages containing this file, and blank it out. */
-    for (pkg_node = current->namenode->packages;
-         pkg_node;
-         pkg_node = pkg_node->next) {
-      if (pkg_node->pkg == pkg) {
-        if (pkg_prev)
-          pkg_prev->next = pkg_node->next;
-        else
-          current->namenode->packages = pkg_node->next;
-
-        /* The actual filelist links were allocated using nfmalloc, so
-         * we shouldn't free them. */
-        break;
-      }
-      pkg_prev = pkg_node;
-    }
-  }
+  /* For each file that used to be in the package, blank out this
+   * package's entry in the vector of packages containing this file. */
+  for (i = 0; i < pkg->clientdata->nfiles; i++)
+    filenamenode_remove_pkg(pkg->clientdata->files[i].namenode, pkg);
+
+  /* The actual files array was allocated from an arena, so we shouldn't
+   * free it. */
   pkg->clientdata->files = NULL;
+  pkg->clientdata->nfiles = 0;
 }
 
-static struct fileinlist **
-pkg_files_add_file(struct pkginfo *pkg, struct filenamenode *namenode,
-                   struct fileinlist **file_tail)
+/*
+ * Append a file to the package files array, which must have been
+ * allocated big enough by the caller.
+ */
+static void
+pkg_files_add_file(struct pkginfo *pkg, struct filenamenode *namenode)
 {
+  struct perpackagestate *ps = pkg->clientdata;
   struct fileinlist *newent;
-  struct pkg_list *pkg_node;
-
-  ensure_package_clientdata(pkg);
 
-  if (file_tail == NULL)
-    file_tail = &pkg->clientdata->files;
-
-  /* Make sure we're at the end. */
-  while ((*file_tail) != NULL) {
-    file_tail = &((*file_tail)->next);
-  }
-
-  /* Create a new node. */
-  newent = nfmalloc(sizeof(struct fileinlist));
+  newent = &ps->files[ps->nfiles];
   newent->namenode = namenode;
   newent->next = NULL;
-  *file_tail = newent;
-  file_tail = &newent->next;
+  if (ps->nfiles > 0)
+    newent[-1].next = newent;
+  ps->nfiles++;
 
-  /* Add pkg to newent's package list. */
-  pkg_node = nfmalloc(sizeof(*pkg_node));
-  pkg_node->pkg = pkg;
-  pkg_node->next = newent->namenode->packages;
-  newent->namenode->packages = pkg_node;
-
-  /* Return the position for the next guy. */
-  return file_tail;
+  filenamenode_add_pkg(namenode, pkg);
 }
 
 /**
@@ -210,9 +224,9 @@ ensure_packagefiles_available(struct pkginfo *pkg)
 {
   static int fd;
   const char *filelistfile;
-  struct fileinlist **lendp;
   struct stat stat_buf;
   char *loaded_list, *loaded_list_end, *thisline, *nextline, *ptr;
+  int nlines;
 
   if (pkg->clientdata && pkg->clientdata->fileslistvalid)
     return;
@@ -244,7 +258,6 @@ ensure_packagefiles_available(struct pkginfo *pkg)
                 "package has no files currently installed"),
               pkg_name(pkg, pnaw_nonambig));
     }
-    pkg->clientdata->files = NULL;
     pkg->clientdata->fileslistvalid = true;
     return;
   }
@@ -260,14 +273,27 @@ ensure_packagefiles_available(struct pkginfo *pkg)
            pkg_name(pkg, pnaw_nonambig));
 
   if (stat_buf.st_size) {
-    loaded_list = nfmalloc(stat_buf.st_size);
+    if (filelists_arena == NULL)
+      filelists_arena = nfarena_new("filelists");
+
+    loaded_list = nfarena_alloc(filelists_arena, stat_buf.st_size);
     loaded_list_end = loaded_list + stat_buf.st_size;
 
     if (fd_read(fd, loaded_list, stat_buf.st_size) < 0)
       ohshite(_("reading files list for package '%.250s'"),
               pkg_name(pkg, pnaw_nonambig));
 
-    lendp= &pkg->clientdata->files;
+    /* Size the files array from the number of lines. */
+    nlines = 0;
+    for (ptr = loaded_list;
+         (ptr = memchr(ptr, '\n', loaded_list_end - ptr));
+         ptr++)
+      nlines++;
+    if (loaded_list_end[-1] != '\n')
+      nlines++;
+    pkg->clientdata->files = nfarena_alloc(filelists_arena,
+                                           sizeof(struct fileinlist) * nlines);
+
     thisline = loaded_list;
     while (thisline < loaded_list_end) {
       struct filenamenode *namenode;
@@ -287,7 +313,7 @@ ensure_packagefiles_available(struct pkginfo *pkg)
       *ptr = '\0';
 
       namenode = findnamenode(thisline, fnn_nocopy);
-      lendp = pkg_files_add_file(pkg, namenode, lendp);
+      pkg_files_add_file(pkg, namenode);
       thisline = nextline;
     }
   }
@@ -400,9 +426,12 @@ void ensure_allinstfiles_available(void) {
   struct pkg_array array;
   struct pkginfo *pkg;
   struct progress progress;
+  struct perf_phase *phase;
   int i;
 
   if (allpackagesdone) return;
+
+  phase = perf_phase_start("filesdb-load");
   if (saidread < PKG_FILESDB_LOAD_DONE) {
     int max = pkg_db_count_pkg();
 
@@ -426,6 +455,13 @@ void ensure_allinstfiles_available(void) {
 
   allpackagesdone = true;
 
+  if (filesdb_arena)
+    nfarena_report(filesdb_arena);
+  if (filelists_arena)
+    nfarena_report(filelists_arena);
+
+  perf_phase_stop(phase);
+
   if (saidread == PKG_FILESDB_LOAD_INPROGRESS) {
     progress_done(&progress);
     printf(P_("%d file or directory currently installed.)\n",
@@ -475,40 +511,25 @@ write_filelist_except(struct pkginfo *pkg, struct pkgbin *pkgbin,
 }
 
 /*
- * Initializes an iterator that appears to go through the file
- * list ‘files’ in reverse order, returning the namenode from
- * each. What actually happens is that we walk the list here,
- * building up a reverse list, and then peel it apart one
- * entry at a time.
+ * Initializes an iterator that goes through the files of a package in
+ * reverse order, returning the namenode from each. The iterator walks
+ * the files array directly, which stays allocated even if the package
+ * files get reloaded in the meantime.
  */
 void
-reversefilelist_init(struct reversefilelistiter *iter, struct fileinlist *files)
+reversefilelist_init(struct reversefilelistiter *iter, struct pkginfo *pkg)
 {
-  struct fileinlist *newent;
-
-  iter->todo = NULL;
-  while (files) {
-    newent= m_malloc(sizeof(struct fileinlist));
-    newent->namenode= files->namenode;
-    newent->next = iter->todo;
-    iter->todo = newent;
-    files= files->next;
-  }
+  iter->files = pkg->clientdata->files;
+  iter->nfiles = pkg->clientdata->nfiles;
 }
 
 struct filenamenode *
 reversefilelist_next(struct reversefilelistiter *iter)
 {
-  struct filenamenode *ret;
-  struct fileinlist *todo;
-
-  todo = iter->todo;
-  if (!todo)
+  if (iter->nfiles == 0)
     return NULL;
-  ret= todo->namenode;
-  iter->todo = todo->next;
-  free(todo);
-  return ret;
+
+  return iter->files[--iter->nfiles].namenode;
 }
 
 /*
@@ -520,7 +541,7 @@ reversefilelist_next(struct reversefilelistiter *iter)
 void
 reversefilelist_abort(struct reversefilelistiter *iter)
 {
-  while (reversefilelist_next(iter));
+  iter->nfiles = 0;
 }
 
 struct fileiterator {
@@ -602,12 +623,17 @@ struct filenamenode *findnamenode(const char *name, enum fnnflags flags) {
   if (flags & fnn_nonew)
     return NULL;
 
-  newnode= nfmalloc(sizeof(struct filenamenode));
-  newnode->packages = NULL;
+  if (filesdb_arena == NULL)
+    filesdb_arena = nfarena_new("filesdb");
+
+  newnode = nfarena_alloc(filesdb_arena, sizeof(struct filenamenode));
+  newnode->pkgs = NULL;
+  newnode->n_pkgs = 0;
+  newnode->max_pkgs = 0;
   if((flags & fnn_nocopy) && name > orig_name && name[-1] == '/')
     newnode->name = name - 1;
   else {
-    char *newname= nfmalloc(strlen(name)+2);
+    char *newname = nfarena_alloc(filesdb_arena, strlen(name) + 2);
     newname[0]= '/'; strcpy(newname+1,name);
     newnode->name= newname;
   }
@@ -80,7 +80,10 @@ enum filenamenode_flags {
 struct filenamenode {
   struct filenamenode *next;
   const char *name;
-  struct pkg_list *packages;
+  /** Vector of the packages containing this file, in load order. */
+  struct pkginfo **pkgs;
+  int n_pkgs;
+  int max_pkgs;
   struct diversion *divert;
 
   /** We allow the administrator to override the owner, group and mode of
@@ -162,6 +165,16 @@ void ensure_package_clientdata(struct pkginfo *pkg);
 
 void ensure_diversions(void);
 
+struct diversion *diversion_link(struct filenamenode *from,
+                                 struct filenamenode *to,
+                                 struct pkgset *pkgset);
+void diversion_unlink(struct diversion *contest);
+
+struct diversion_iterator;
+struct diversion_iterator *diversion_iter_new(void);
+struct diversion *diversion_iter_next(struct diversion_iterator *iter);
+void diversion_iter_free(struct diversion_iterator *iter);
+
 enum statdb_parse_flags {
 	STATDB_PARSE_NORMAL = 0,
 	STATDB_PARSE_LAX = 1,
@@ -171,6 +184,12 @@ uid_t statdb_parse_uid(const char *str);
 gid_t statdb_parse_gid(const char *str);
 mode_t statdb_parse_mode(const char *str);
 void ensure_statoverrides(enum statdb_parse_flags flags);
+void statdb_node_set(struct filenamenode *fnn, struct file_stat *filestat);
+
+struct statdb_iterator;
+struct statdb_iterator *statdb_iter_new(void);
+struct filenamenode *statdb_iter_next(struct statdb_iterator *iter);
+void statdb_iter_free(struct statdb_iterator *iter);
 
 #define LISTFILE           "list"
 #define HASHFILE           "md5sums"
@@ -186,9 +205,12 @@ void write_filelist_except(struct pkginfo *pkg, struct pkgbin *pkgbin,
 void write_filehash_except(struct pkginfo *pkg, struct pkgbin *pkgbin,
                            struct fileinlist *list, enum filenamenode_flags mask);
 
-struct reversefilelistiter { struct fileinlist *todo; };
+struct reversefilelistiter {
+  struct fileinlist *files;
+  int nfiles;
+};
 
-void reversefilelist_init(struct reversefilelistiter *iterptr, struct fileinlist *files);
+void reversefilelist_init(struct reversefilelistiter *iterptr, struct pkginfo *pkg);
 struct filenamenode *reversefilelist_next(struct reversefilelistiter *iterptr);
 void reversefilelist_abort(struct reversefilelistiter *iterptr);
 
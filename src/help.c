@@ -33,6 +33,7 @@
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/pkg.h>
 #include <dpkg/path.h>
 
 #include "filesdb.h"
@@ -313,6 +314,8 @@ conffile_mark_obsolete(struct pkginfo *pkg, struct filenamenode *namenode)
       debug(dbg_conff, "marking %s conffile %s as obsolete",
             pkg_name(pkg, pnaw_always), conff->name);
       conff->obsolete = true;
+      /* The package might not get noted, as it can be another one. */
+      pkg_invalidate_stanza(pkg);
       return;
     }
   }
@@ -50,6 +50,7 @@
 #include <dpkg/subproc.h>
 #include <dpkg/command.h>
 #include <dpkg/options.h>
+#include <dpkg/perf.h>
 
 #include "main.h"
 #include "filesdb.h"
@@ -151,6 +152,7 @@ usage(const struct cmdinfo *ci, const char *value)
 "  -D|--debug=<octal>         Enable debugging (see -Dhelp or --debug=help).\n"
 "  --status-fd <n>            Send status change updates to file descriptor <n>.\n"
 "  --status-logger=<command>  Send status change updates to <command>'s stdin.\n"
+"  --perf-fd <n>              Send phase timings and counters to file descriptor <n>.\n"
 "  --log=<filename>           Log status changes and actions to <filename>.\n"
 "  --ignore-depends=<package>,...\n"
 "                             Ignore dependencies involving <package>.\n"
@@ -158,6 +160,7 @@ usage(const struct cmdinfo *ci, const char *value)
 "  --no-force-...|--refuse-...\n"
 "                             Stop when problems encountered.\n"
 "  --abort-after <n>          Abort after encountering <n> errors.\n"
+"  --script-jobs=<n>          Run up to <n> postinst configure scripts at once.\n"
 "\n"), ADMINDIR);
 
   printf(_(
@@ -187,6 +190,7 @@ static const char printforhelp[] = N_(
 int f_pending=0, f_recursive=0, f_alsoselect=1, f_skipsame=0, f_noact=0;
 int f_autodeconf=0, f_nodebsig=0;
 int f_triggers = 0;
+int f_scriptjobs = 1;
 int fc_downgrade=1, fc_configureany=0, fc_hold=0, fc_removereinstreq=0, fc_overwrite=0;
 int fc_removeessential=0, fc_conflicts=0, fc_depends=0, fc_dependsversion=0;
 int fc_breaks=0, fc_badpath=0, fc_overwritediverted=0, fc_architecture=0;
@@ -398,6 +402,18 @@ set_integer(const struct cmdinfo *cip, const char *value)
   *cip->iassignto = dpkg_options_parse_arg_int(cip, value);
 }
 
+static void
+set_script_jobs(const struct cmdinfo *cip, const char *value)
+{
+  long v;
+
+  v = dpkg_options_parse_arg_int(cip, value);
+  if (v < 1)
+    badusage(_("--%s requires a positive number of jobs"), cip->olong);
+
+  f_scriptjobs = v;
+}
+
 static void
 set_pipe(const struct cmdinfo *cip, const char *value)
 {
@@ -408,6 +424,16 @@ set_pipe(const struct cmdinfo *cip, const char *value)
   statusfd_add(v);
 }
 
+static void
+set_perf_fd(const struct cmdinfo *cip, const char *value)
+{
+  long v;
+
+  v = dpkg_options_parse_arg_int(cip, value);
+
+  perf_enable(v);
+}
+
 static bool
 is_invoke_action(enum action action)
 {
@@ -705,6 +731,7 @@ static const struct cmdinfo cmdinfos[]= {
   { "verify-format",     0,   1, NULL,          NULL,      set_verify_format },
   { "status-logger",     0,   1, NULL,          NULL,      set_invoke_hook, 0, &status_loggers_tail },
   { "status-fd",         0,   1, NULL,          NULL,      set_pipe, 0 },
+  { "perf-fd",           0,   1, NULL,          NULL,      set_perf_fd, 0 },
   { "log",               0,   1, NULL,          &log_file, NULL,    0 },
   { "pending",           'a', 0, &f_pending,    NULL,      NULL,    1 },
   { "recursive",         'R', 0, &f_recursive,  NULL,      NULL,    1 },
@@ -723,6 +750,7 @@ static const struct cmdinfo cmdinfos[]= {
   { "auto-deconfigure",  'B', 0, &f_autodeconf, NULL,      NULL,    1 },
   { "root",              0,   1, NULL,          NULL,      set_root,      0 },
   { "abort-after",       0,   1, &errabort,     NULL,      set_integer,   0 },
+  { "script-jobs",       0,   1, NULL,          NULL,      set_script_jobs, 0 },
   { "admindir",          0,   1, NULL,          &admindir, NULL,          0 },
   { "instdir",           0,   1, NULL,          NULL,      set_instdir,   0 },
   { "ignore-depends",    0,   1, NULL,          NULL,      set_ignore_depends, 0 },
@@ -895,6 +923,8 @@ int main(int argc, const char *const *argv) {
   if (is_invoke_action(cipaction->arg_int))
     run_invoke_hooks(cipaction->olong, post_invoke_hooks);
 
+  perf_report();
+
   dpkg_program_done();
 
   return reportbroken_retexitstatus(ret);
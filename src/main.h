@@ -49,6 +49,15 @@ enum pkg_cycle_color {
 	PKG_CYCLE_BLACK,
 };
 
+enum trigproc_postpone {
+	/** Trigger processing has not been postponed. */
+	TRIGPROC_POSTPONE_NONE,
+	/** Trigger processing has been postponed. */
+	TRIGPROC_POSTPONE_WAITING,
+	/** Further activations have been coalesced while postponed. */
+	TRIGPROC_POSTPONE_COALESCED,
+};
+
 struct perpackagestate {
   enum pkg_istobe istobe;
 
@@ -56,6 +65,8 @@ struct perpackagestate {
   enum pkg_cycle_color color;
 
   bool enqueued;
+  /** Enqueued while pending configuration, see queue_has_configure_work(). */
+  bool enqueued_configure;
 
   /**
    * filelistvalid  files  Meaning
@@ -65,9 +76,13 @@ struct perpackagestate {
    *                         info must throw away old and reread file.
    * true           !NULL  Read, all is OK.
    * true           NULL   Read OK, but, there were no files.
+   *
+   * The files are stored as a contiguous array of nfiles entries, which
+   * are also linked in order through their next member.
    */
   bool fileslistvalid;
   struct fileinlist *files;
+  int nfiles;
   int replacingfilesandsaid;
   int cmdline_seen;
 
@@ -75,6 +90,8 @@ struct perpackagestate {
 
   /** Non-NULL iff in trigproc.c:deferred. */
   struct pkg_list *trigprocdeferred;
+  /** Trigger processing postponing state, see trigproc.c. */
+  enum trigproc_postpone trigprocpostponed;
 };
 
 enum action {
@@ -133,6 +150,7 @@ extern const char *const statusstrings[];
 extern int f_pending, f_recursive, f_alsoselect, f_skipsame, f_noact;
 extern int f_autodeconf, f_nodebsig;
 extern int f_triggers;
+extern int f_scriptjobs;
 extern int fc_downgrade, fc_configureany, fc_hold, fc_removereinstreq, fc_overwrite;
 extern int fc_removeessential, fc_conflicts, fc_depends, fc_dependsversion;
 extern int fc_breaks, fc_badpath, fc_overwritediverted, fc_architecture;
@@ -198,6 +216,8 @@ int clearselections(const char *const *argv);
 /* from packages.c, remove.c and configure.c */
 
 void md5hash(struct pkginfo *pkg, char *hashbuf, const char *fn);
+void md5hash_note(const char *fn, const char *hash);
+void md5hash_batch(const char **names, int nnames);
 void enqueue_package(struct pkginfo *pkg);
 void enqueue_package_mark_seen(struct pkginfo *pkg);
 void process_queue(void);
@@ -264,6 +284,14 @@ int maintscript_fallback(struct pkginfo *pkg,
 int maintscript_postinst(struct pkginfo *pkg, ...) DPKG_ATTR_SENTINEL;
 void post_postinst_tasks(struct pkginfo *pkg, enum pkgstatus new_status);
 
+typedef void maintscript_job_done_func(struct pkginfo *pkg);
+
+int maintscript_postinst_job(struct pkginfo *pkg,
+                             maintscript_job_done_func *done, ...)
+	DPKG_ATTR_SENTINEL;
+void maintscript_jobs_wait(int njobs);
+bool maintscript_jobs_pending(void);
+
 void clear_istobes(void);
 bool dir_is_used_by_others(struct filenamenode *namenode, struct pkginfo *pkg);
 bool dir_is_used_by_pkg(struct filenamenode *namenode, struct pkginfo *pkg,
@@ -292,6 +320,7 @@ void trigproc_populate_deferred(void);
 void trigproc_run_deferred(void);
 void trigproc_reset_cycle(void);
 
+void trigproc_postpone(struct pkginfo *pkg);
 void trigproc(struct pkginfo *pkg, enum trigproc_type type);
 
 void trig_activate_packageprocessing(struct pkginfo *pkg);
@@ -42,6 +42,7 @@
 #include <dpkg/pkg-queue.h>
 #include <dpkg/string.h>
 #include <dpkg/options.h>
+#include <dpkg/perf.h>
 
 #include "filesdb.h"
 #include "infodb.h"
@@ -49,6 +50,8 @@
 
 static struct pkginfo *progress_bytrigproc;
 static struct pkg_queue queue = PKG_QUEUE_INIT;
+/* The number of packages in the queue which are pending configuration. */
+static int queue_configure_work;
 
 int sincenothing = 0, dependtry = 1;
 
@@ -59,6 +62,11 @@ enqueue_package(struct pkginfo *pkg)
   if (pkg->clientdata->enqueued)
     return;
   pkg->clientdata->enqueued = true;
+  if (pkg->status == PKG_STAT_UNPACKED ||
+      pkg->status == PKG_STAT_HALFCONFIGURED) {
+    pkg->clientdata->enqueued_configure = true;
+    queue_configure_work++;
+  }
   pkg_queue_push(&queue, pkg);
 }
 
@@ -167,12 +175,27 @@ packages(const char *const *argv)
   return 0;
 }
 
+/*
+ * Check whether there are packages left in the queue to be configured,
+ * which might activate further triggers when processed.
+ */
+static bool
+queue_has_configure_work(void)
+{
+  if (maintscript_jobs_pending())
+    return true;
+
+  return queue_configure_work > 0;
+}
+
 void process_queue(void) {
   struct pkg_list *rundown;
   struct pkginfo *volatile pkg;
   volatile enum action action_todo;
+  volatile bool trigproc_now;
   jmp_buf ejbuf;
   enum pkg_istobe istobe = PKG_ISTOBE_NORMAL;
+  struct perf_phase *phase;
 
   if (abort_processing)
     return;
@@ -223,8 +246,21 @@ void process_queue(void) {
 
     ensure_package_clientdata(pkg);
     pkg->clientdata->enqueued = false;
+    if (pkg->clientdata->enqueued_configure) {
+      pkg->clientdata->enqueued_configure = false;
+      queue_configure_work--;
+    }
 
     action_todo = cipaction->arg_int;
+    trigproc_now = false;
+
+    if (sincenothing >= queue.length * 2 + 2 && maintscript_jobs_pending()) {
+      /* Packages might only be getting deferred because they depend on
+       * packages with running script jobs, let these finish before
+       * trying harder. */
+      maintscript_jobs_wait(0);
+      sincenothing = 0;
+    }
 
     if (sincenothing++ > queue.length * 3 + 2) {
       /* Make sure that even if we have exceeded the queue since not having
@@ -239,6 +275,7 @@ void process_queue(void) {
         enqueue_package(pkg);
         pkg = progress_bytrigproc;
         action_todo = act_configure;
+        trigproc_now = true;
       } else {
         dependtry++;
         sincenothing = 0;
@@ -258,8 +295,10 @@ void process_queue(void) {
       pkg->clientdata->istobe = PKG_ISTOBE_NORMAL;
 
       pop_error_context(ehflag_bombout);
-      if (abort_processing)
+      if (abort_processing) {
+        maintscript_jobs_wait(0);
         return;
+      }
       continue;
     }
     push_error_context_jump(&ejbuf, print_error_perpackage,
@@ -279,13 +318,26 @@ void process_queue(void) {
       /* Fall through. */
     case act_configure:
       /* Do whatever is most needed. */
-      if (pkg->trigpend_head)
+      if (pkg->trigpend_head && !trigproc_now && f_triggers > 0 &&
+          queue_has_configure_work()) {
+        /* Coalesce any further activations into a single run. */
+        trigproc_postpone(pkg);
+        enqueue_package(pkg);
+      } else if (pkg->trigpend_head) {
+        /* Do not run triggers while other scripts might be activating
+         * them. */
+        maintscript_jobs_wait(0);
         trigproc(pkg, TRIGPROC_REQUIRED);
-      else
+      } else {
+        phase = perf_phase_start("configure");
         deferred_configure(pkg);
+        perf_phase_stop(phase);
+      }
       break;
     case act_remove: case act_purge:
+      phase = perf_phase_start("remove");
       deferred_remove(pkg);
+      perf_phase_stop(phase);
       break;
     default:
       internerr("unknown action '%d'", cipaction->arg_int);
@@ -295,6 +347,7 @@ void process_queue(void) {
 
     pop_error_context(ehflag_normaltidy);
   }
+  maintscript_jobs_wait(0);
   assert(!queue.length);
 }
 
@@ -254,9 +254,10 @@ listpackages(const char *const *argv)
   struct list_format fmt;
 
   if (!opt_loadavail)
-    modstatdb_open(msdbrw_readonly);
+    modstatdb_open(msdbrw_readonly | msdbrw_lazy_fields);
   else
-    modstatdb_open(msdbrw_readonly | msdbrw_available_readonly);
+    modstatdb_open(msdbrw_readonly | msdbrw_available_readonly |
+                   msdbrw_lazy_fields);
 
   pkg_array_init_from_db(&array);
   pkg_array_sort(&array, pkg_sorter_by_nonambig_name_arch);
@@ -371,7 +372,7 @@ searchfiles(const char *const *argv)
   if (!*argv)
     badusage(_("--search needs at least one file name pattern argument"));
 
-  modstatdb_open(msdbrw_readonly);
+  modstatdb_open(msdbrw_readonly | msdbrw_lazy_fields);
   ensure_allinstfiles_available_quiet();
   ensure_diversions();
 
@@ -432,9 +433,10 @@ enqperpackage(const char *const *argv)
     badusage(_("--%s needs at least one package name argument"), cipaction->olong);
 
   if (cipaction->arg_int == act_printavail)
-    modstatdb_open(msdbrw_readonly | msdbrw_available_readonly);
+    modstatdb_open(msdbrw_readonly | msdbrw_available_readonly |
+                   msdbrw_lazy_fields);
   else
-    modstatdb_open(msdbrw_readonly);
+    modstatdb_open(msdbrw_readonly | msdbrw_lazy_fields);
 
   while ((thisarg = *argv++) != NULL) {
     pkg = dpkg_options_parse_pkgname(cipaction, thisarg);
@@ -534,6 +536,7 @@ showpackages(const char *const *argv)
   struct pkg_array array;
   struct pkginfo *pkg;
   struct pkg_format_node *fmt;
+  enum modstatdb_rw msdbflags;
   int i;
   int failures = 0;
 
@@ -545,10 +548,12 @@ showpackages(const char *const *argv)
     return failures;
   }
 
-  if (!opt_loadavail)
-    modstatdb_open(msdbrw_readonly);
-  else
-    modstatdb_open(msdbrw_readonly | msdbrw_available_readonly);
+  msdbflags = msdbrw_readonly | msdbrw_lazy_fields;
+  if (opt_loadavail)
+    msdbflags |= msdbrw_available_readonly;
+  if (!pkg_format_needs_db_fields(fmt))
+    msdbflags |= msdbrw_snapshot;
+  modstatdb_open(msdbflags);
 
   pkg_array_init_from_db(&array);
   pkg_array_sort(&array, pkg_sorter_by_nonambig_name_arch);
@@ -244,6 +244,82 @@ removal_bulk_file_is_shared(struct pkginfo *pkg, struct filenamenode *namenode)
   return shared;
 }
 
+/*
+ * The reverse file list walk visits in a row all the entries in the same
+ * directory, so we keep the last parent directory open, and operate on
+ * the entries relative to it, which saves resolving the whole pathname
+ * on each system call.
+ */
+struct removal_dir {
+  struct varbuf name;
+  int fd;
+};
+
+/*
+ * Make dir refer to the parent directory of pathname, and return the
+ * offset of the last pathname component, to use relative to dir->fd.
+ * If the directory cannot be opened, then dir->fd is AT_FDCWD and the
+ * offset is 0, so that the whole pathname gets used instead.
+ */
+static size_t
+removal_dir_chdir(struct removal_dir *dir, const char *pathname)
+{
+  const char *slash;
+  size_t dirlen;
+
+  slash = strrchr(pathname, '/');
+  if (slash == NULL)
+    return 0;
+  dirlen = slash - pathname;
+
+  if (dir->fd != AT_FDCWD && dir->name.used == dirlen &&
+      memcmp(dir->name.buf, pathname, dirlen) == 0)
+    return dirlen + 1;
+
+  if (dir->fd >= 0)
+    close(dir->fd);
+
+  varbuf_reset(&dir->name);
+  varbuf_add_buf(&dir->name, pathname, dirlen);
+  varbuf_end_str(&dir->name);
+
+  dir->fd = open(dirlen ? dir->name.buf : "/", O_RDONLY | O_DIRECTORY);
+  if (dir->fd < 0) {
+    debug(dbg_eachfiledetail, "removal_bulk cannot open directory '%s': %s",
+          dir->name.buf, strerror(errno));
+    dir->fd = AT_FDCWD;
+    return 0;
+  }
+  setcloexec(dir->fd, dir->name.buf);
+
+  return dirlen + 1;
+}
+
+static void
+cu_removal_dir(int argc, void **argv)
+{
+  struct removal_dir *dir = argv[0];
+
+  if (dir->fd >= 0)
+    close(dir->fd);
+  dir->fd = AT_FDCWD;
+  varbuf_destroy(&dir->name);
+}
+
+static void
+removal_dir_remove_tree(struct removal_dir *dir, const char *pathname,
+                        const char *basename)
+{
+  struct stat stab;
+
+  /* This is the common case, so avoid the full path based removal. */
+  if (fstatat(dir->fd, basename, &stab, AT_SYMLINK_NOFOLLOW) < 0 &&
+      errno == ENOENT)
+    return;
+
+  path_remove_tree(pathname);
+}
+
 static void
 removal_bulk_remove_files(struct pkginfo *pkg)
 {
@@ -252,16 +328,20 @@ removal_bulk_remove_files(struct pkginfo *pkg)
   struct filenamenode *namenode;
   static struct varbuf fnvb;
   struct varbuf_state fnvb_state;
+  struct removal_dir dir = { VARBUF_INIT, AT_FDCWD };
   struct stat stab;
 
     pkg_set_status(pkg, PKG_STAT_HALFINSTALLED);
     modstatdb_note(pkg);
     push_checkpoint(~ehflag_bombout, ehflag_normaltidy);
 
-    reversefilelist_init(&rlistit,pkg->clientdata->files);
+    push_cleanup(cu_removal_dir, ~0, NULL, 0, 1, &dir);
+
+    reversefilelist_init(&rlistit, pkg);
     leftover = NULL;
     while ((namenode= reversefilelist_next(&rlistit))) {
       struct filenamenode *usenode;
+      size_t baseoff;
       bool is_dir;
 
       debug(dbg_eachfile, "removal_bulk '%s' flags=%o",
@@ -275,7 +355,10 @@ removal_bulk_remove_files(struct pkginfo *pkg)
       varbuf_end_str(&fnvb);
       varbuf_snapshot(&fnvb, &fnvb_state);
 
-      is_dir = stat(fnvb.buf, &stab) == 0 && S_ISDIR(stab.st_mode);
+      baseoff = removal_dir_chdir(&dir, fnvb.buf);
+
+      is_dir = fstatat(dir.fd, fnvb.buf + baseoff, &stab, 0) == 0 &&
+               S_ISDIR(stab.st_mode);
 
       /* A pkgset can share files between its instances that we
        * don't want to remove, we just want to forget them. This
@@ -319,19 +402,21 @@ removal_bulk_remove_files(struct pkginfo *pkg)
       varbuf_add_str(&fnvb, DPKGTEMPEXT);
       varbuf_end_str(&fnvb);
       debug(dbg_eachfiledetail, "removal_bulk cleaning temp '%s'", fnvb.buf);
-      path_remove_tree(fnvb.buf);
+      removal_dir_remove_tree(&dir, fnvb.buf, fnvb.buf + baseoff);
 
       varbuf_rollback(&fnvb, &fnvb_state);
       varbuf_add_str(&fnvb, DPKGNEWEXT);
       varbuf_end_str(&fnvb);
       debug(dbg_eachfiledetail, "removal_bulk cleaning new '%s'", fnvb.buf);
-      path_remove_tree(fnvb.buf);
+      removal_dir_remove_tree(&dir, fnvb.buf, fnvb.buf + baseoff);
 
       varbuf_rollback(&fnvb, &fnvb_state);
       varbuf_end_str(&fnvb);
 
       debug(dbg_eachfiledetail, "removal_bulk removing '%s'", fnvb.buf);
-      if (!rmdir(fnvb.buf) || errno == ENOENT || errno == ELOOP) continue;
+      if (!unlinkat(dir.fd, fnvb.buf + baseoff, AT_REMOVEDIR) ||
+          errno == ENOENT || errno == ELOOP)
+        continue;
       if (errno == ENOTEMPTY || errno == EEXIST) {
         debug(dbg_eachfiledetail,
               "removal_bulk '%s' was not empty, will try again later",
@@ -348,9 +433,11 @@ removal_bulk_remove_files(struct pkginfo *pkg)
       if (errno != ENOTDIR)
         ohshite(_("cannot remove '%.250s'"), fnvb.buf);
       debug(dbg_eachfiledetail, "removal_bulk unlinking '%s'", fnvb.buf);
-      if (secure_unlink(fnvb.buf))
+      if (secure_unlinkat(dir.fd, fnvb.buf + baseoff))
         ohshite(_("unable to securely remove '%.250s'"), fnvb.buf);
     }
+
+    pop_cleanup(ehflag_normaltidy); /* dir.fd = open() */
     write_filelist_except(pkg, &pkg->installed, leftover, 0);
     maintscript_installed(pkg, POSTRMFILE, "post-removal", "remove", NULL);
 
@@ -381,7 +468,7 @@ static void removal_bulk_remove_leftover_dirs(struct pkginfo *pkg) {
   modstatdb_note(pkg);
   push_checkpoint(~ehflag_bombout, ehflag_normaltidy);
 
-  reversefilelist_init(&rlistit,pkg->clientdata->files);
+  reversefilelist_init(&rlistit, pkg);
   leftover = NULL;
   while ((namenode= reversefilelist_next(&rlistit))) {
     struct filenamenode *usenode;
@@ -24,12 +24,16 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 #ifdef WITH_SELINUX
 #include <selinux/selinux.h>
@@ -40,9 +44,12 @@
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
 #include <dpkg/pkg.h>
+#include <dpkg/path.h>
+#include <dpkg/buffer.h>
 #include <dpkg/subproc.h>
 #include <dpkg/command.h>
 #include <dpkg/triglib.h>
+#include <dpkg/perf.h>
 
 #include "filesdb.h"
 #include "infodb.h"
@@ -152,10 +159,39 @@ maintscript_set_exec_context(struct command *cmd, const char *fallback)
 	return rc < 0 ? rc : 0;
 }
 
+static void DPKG_ATTR_NORET
+maintscript_child_exec(struct pkginfo *pkg, struct pkgbin *pkgbin,
+                       struct command *cmd)
+{
+	char *pkg_count;
+	const char *maintscript_debug;
+
+	pkg_count = str_fmt("%d", pkgset_installed_instances(pkg->set));
+
+	maintscript_debug = debug_has_flag(dbg_scripts) ? "1" : "0";
+
+	if (setenv("DPKG_MAINTSCRIPT_PACKAGE", pkg->set->name, 1) ||
+	    setenv("DPKG_MAINTSCRIPT_PACKAGE_REFCOUNT", pkg_count, 1) ||
+	    setenv("DPKG_MAINTSCRIPT_ARCH", pkgbin->arch->name, 1) ||
+	    setenv("DPKG_MAINTSCRIPT_NAME", cmd->argv[0], 1) ||
+	    setenv("DPKG_MAINTSCRIPT_DEBUG", maintscript_debug, 1) ||
+	    setenv("DPKG_RUNNING_VERSION", PACKAGE_VERSION, 1))
+		ohshite(_("unable to setenv for maintainer script"));
+
+	cmd->filename = cmd->argv[0] = maintscript_pre_exec(cmd);
+
+	if (maintscript_set_exec_context(cmd, "dpkg_script_t") < 0)
+		ohshite(_("cannot set security execution context for "
+		          "maintainer script"));
+
+	command_exec(cmd);
+}
+
 static int
 maintscript_exec(struct pkginfo *pkg, struct pkgbin *pkgbin,
                  struct command *cmd, struct stat *stab, int warn)
 {
+	struct perf_phase *phase = NULL;
 	pid_t pid;
 	int rc;
 
@@ -163,35 +199,22 @@ maintscript_exec(struct pkginfo *pkg, struct pkgbin *pkgbin,
 
 	push_cleanup(cu_post_script_tasks, ehflag_bombout, NULL, 0, 0);
 
-	pid = subproc_fork();
-	if (pid == 0) {
-		char *pkg_count;
-		const char *maintscript_debug;
-
-		pkg_count = str_fmt("%d", pkgset_installed_instances(pkg->set));
-
-		maintscript_debug = debug_has_flag(dbg_scripts) ? "1" : "0";
-
-		if (setenv("DPKG_MAINTSCRIPT_PACKAGE", pkg->set->name, 1) ||
-		    setenv("DPKG_MAINTSCRIPT_PACKAGE_REFCOUNT", pkg_count, 1) ||
-		    setenv("DPKG_MAINTSCRIPT_ARCH", pkgbin->arch->name, 1) ||
-		    setenv("DPKG_MAINTSCRIPT_NAME", cmd->argv[0], 1) ||
-		    setenv("DPKG_MAINTSCRIPT_DEBUG", maintscript_debug, 1) ||
-		    setenv("DPKG_RUNNING_VERSION", PACKAGE_VERSION, 1))
-			ohshite(_("unable to setenv for maintainer script"));
+	if (perf_is_enabled()) {
+		char name[64];
 
-		cmd->filename = cmd->argv[0] = maintscript_pre_exec(cmd);
-
-		if (maintscript_set_exec_context(cmd, "dpkg_script_t") < 0)
-			ohshite(_("cannot set security execution context for "
-			          "maintainer script"));
-
-		command_exec(cmd);
+		snprintf(name, sizeof(name), "script:%s", cmd->argv[0]);
+		phase = perf_phase_start(name);
 	}
+
+	pid = subproc_fork();
+	if (pid == 0)
+		maintscript_child_exec(pkg, pkgbin, cmd);
 	subproc_signals_ignore(cmd->name);
 	rc = subproc_reap(pid, cmd->name, warn);
 	subproc_signals_restore();
 
+	perf_phase_stop(phase);
+
 	pop_cleanup(ehflag_normaltidy);
 
 	return rc;
@@ -267,6 +290,322 @@ maintscript_postinst(struct pkginfo *pkg, ...)
 	return rc;
 }
 
+/*
+ * Concurrent «postinst configure» jobs.
+ *
+ * When more than one script job is allowed, the postinst of a package
+ * being configured is started in the background, so that dpkg can go on
+ * with other packages whose dependencies are already satisfied. As the
+ * package is kept half-configured and due to be installed, any package
+ * depending on it will be deferred by the dependency checks until the
+ * job has been reaped.
+ *
+ * The job output is captured into temporary files and replayed when it
+ * gets reaped. Jobs are reaped in the same order they were started, so
+ * that the output and the status database updates are serialized.
+ */
+
+struct maintscript_job {
+	struct maintscript_job *next;
+	struct pkginfo *pkg;
+	maintscript_job_done_func *done;
+	char *name;
+	pid_t pid;
+	int out_fd;
+	int err_fd;
+	/* When the job got started, for the instrumentation. */
+	struct timespec start;
+};
+
+static struct {
+	struct maintscript_job *head, *tail;
+	int count;
+} jobs;
+
+static int
+maintscript_job_capture_file(void)
+{
+	char *template;
+	int fd;
+
+	template = path_make_temp_template("dpkg-script");
+	fd = mkstemp(template);
+	if (fd < 0)
+		ohshite(_("unable to create temporary file '%s'"), template);
+	setcloexec(fd, template);
+	if (unlink(template))
+		ohshite(_("unable to remove temporary file '%s'"), template);
+	free(template);
+
+	return fd;
+}
+
+static void
+maintscript_job_replay(int fd, int outfd, FILE *outfp)
+{
+	struct dpkg_error err;
+
+	if (lseek(fd, 0, SEEK_SET) < 0)
+		ohshite(_("unable to seek on maintainer script output"));
+
+	if (fflush(outfp))
+		ohshite(_("unable to flush maintainer script output"));
+	if (fd_fd_copy(fd, outfd, -1, &err) < 0)
+		ohshit(_("cannot replay maintainer script output: %s"),
+		       err.str);
+}
+
+static void
+cu_maintscript_job(int argc, void **argv)
+{
+	struct maintscript_job *job = argv[0];
+
+	close(job->out_fd);
+	close(job->err_fd);
+	free(job->name);
+	free(job);
+}
+
+static void
+maintscript_job_reap(struct maintscript_job *job)
+{
+	struct pkginfo *pkg = job->pkg;
+	struct rusage start_children, end_children;
+	jmp_buf ejbuf;
+	int status;
+
+	if (setjmp(ejbuf)) {
+		/* Give up on it from the point of view of other packages,
+		 * as done in process_queue(). */
+		pkg->clientdata->istobe = PKG_ISTOBE_NORMAL;
+
+		pop_error_context(ehflag_bombout);
+		return;
+	}
+	push_error_context_jump(&ejbuf, print_error_perpackage,
+	                        pkg_name(pkg, pnaw_nonambig));
+
+	push_cleanup(cu_maintscript_job, ~0, NULL, 0, 1, job);
+	push_cleanup(cu_post_script_tasks, ehflag_bombout, NULL, 0, 0);
+
+	if (perf_is_enabled())
+		getrusage(RUSAGE_CHILDREN, &start_children);
+
+	subproc_signals_ignore(job->name);
+	status = subproc_wait(job->pid, job->name);
+	subproc_signals_restore();
+
+	/* The jobs overlap, so each one gets accounted once reaped, with its
+	 * wall clock time measured up to that point. */
+	if (perf_is_enabled()) {
+		getrusage(RUSAGE_CHILDREN, &end_children);
+		perf_phase_add("script:" POSTINSTFILE, &job->start,
+		               &start_children, &end_children);
+	}
+
+	debug(dbg_scripts, "maintscript_job_reap %s pid %d status %d",
+	      pkg_name(pkg, pnaw_always), (int)job->pid, status);
+
+	maintscript_job_replay(job->out_fd, STDOUT_FILENO, stdout);
+	maintscript_job_replay(job->err_fd, STDERR_FILENO, stderr);
+	subproc_check(status, job->name, SUBPROC_NORMAL);
+
+	pop_cleanup(ehflag_normaltidy);
+	ensure_diversions();
+
+	job->done(pkg);
+
+	pop_cleanup(ehflag_normaltidy);
+
+	m_output(stdout, _("<standard output>"));
+	m_output(stderr, _("<standard error>"));
+
+	pop_error_context(ehflag_normaltidy);
+}
+
+/**
+ * Wait for the oldest running script jobs, until at most njobs are left.
+ */
+void
+maintscript_jobs_wait(int njobs)
+{
+	struct maintscript_job *job;
+
+	while (jobs.count > njobs) {
+		job = jobs.head;
+		jobs.head = job->next;
+		if (jobs.head == NULL)
+			jobs.tail = NULL;
+		jobs.count--;
+
+		maintscript_job_reap(job);
+	}
+}
+
+bool
+maintscript_jobs_pending(void)
+{
+	return jobs.count > 0;
+}
+
+/*
+ * Check whether the package uses debconf, which locks its database without
+ * waiting and might need to interact with the user, so its postinst cannot
+ * be run concurrently with any other.
+ */
+static bool
+maintscript_uses_debconf(struct pkginfo *pkg)
+{
+	struct varbuf vb = VARBUF_INIT;
+	struct dpkg_error err;
+	const char *scriptpath;
+	bool uses_debconf;
+	int fd;
+
+	scriptpath = pkg_infodb_get_file(pkg, &pkg->installed, "config");
+	if (access(scriptpath, F_OK) == 0)
+		return true;
+
+	scriptpath = pkg_infodb_get_file(pkg, &pkg->installed, POSTINSTFILE);
+	fd = open(scriptpath, O_RDONLY);
+	if (fd < 0) {
+		if (errno == ENOENT)
+			return false;
+		ohshite(_("unable to open maintainer script '%.250s'"),
+		        scriptpath);
+	}
+	if (fd_vbuf_copy(fd, &vb, -1, &err) < 0)
+		ohshit(_("cannot read maintainer script '%.250s': %s"),
+		       scriptpath, err.str);
+	close(fd);
+	varbuf_end_str(&vb);
+
+	uses_debconf = strstr(vb.buf, "debconf") != NULL;
+
+	varbuf_destroy(&vb);
+
+	return uses_debconf;
+}
+
+/**
+ * Start the «postinst configure» for a package in the background.
+ *
+ * If script jobs are not enabled this is equivalent to calling
+ * maintscript_postinst() and then the done function. Otherwise the
+ * done function will be called once the job gets reaped, which might
+ * happen on any of the maintscript_jobs_wait() calls, but the package
+ * status is only ever changed from the main dpkg process.
+ *
+ * Packages using debconf get their script run in the foreground, once all
+ * the running jobs have been reaped.
+ */
+int
+maintscript_postinst_job(struct pkginfo *pkg, maintscript_job_done_func *done,
+                         ...)
+{
+	struct maintscript_job *job;
+	struct command cmd;
+	const char *scriptpath;
+	struct stat stab;
+	va_list args;
+	char buf[100];
+	bool serial = f_scriptjobs <= 1;
+
+	if (!serial && maintscript_uses_debconf(pkg)) {
+		debug(dbg_scripts, "maintscript_postinst_job %s uses debconf",
+		      pkg_name(pkg, pnaw_always));
+		maintscript_jobs_wait(0);
+		serial = true;
+	}
+
+	if (serial) {
+		int rc;
+
+		va_start(args, done);
+		rc = vmaintscript_installed(pkg, POSTINSTFILE,
+		                            "post-installation", args);
+		va_end(args);
+
+		if (rc)
+			ensure_diversions();
+		done(pkg);
+
+		return rc;
+	}
+
+	scriptpath = pkg_infodb_get_file(pkg, &pkg->installed, POSTINSTFILE);
+	sprintf(buf, _("installed %s script"), "post-installation");
+
+	va_start(args, done);
+	command_init(&cmd, scriptpath, buf);
+	command_add_arg(&cmd, POSTINSTFILE);
+	command_add_argv(&cmd, args);
+	va_end(args);
+
+	if (stat(scriptpath, &stab)) {
+		command_destroy(&cmd);
+		if (errno == ENOENT) {
+			debug(dbg_scripts,
+			      "maintscript_postinst_job nonexistent %s",
+			      POSTINSTFILE);
+			done(pkg);
+			return 0;
+		}
+		ohshite(_("unable to stat %s '%.250s'"), buf, scriptpath);
+	}
+	setexecute(cmd.filename, &stab);
+
+	/* Make room for the new job. */
+	maintscript_jobs_wait(f_scriptjobs - 1);
+
+	job = m_malloc(sizeof(*job));
+	job->next = NULL;
+	job->pkg = pkg;
+	job->done = done;
+	job->name = m_strdup(cmd.name);
+	job->out_fd = maintscript_job_capture_file();
+	job->err_fd = maintscript_job_capture_file();
+
+	/* Do not let the child inherit any pending buffered output. */
+	m_output(stdout, _("<standard output>"));
+	m_output(stderr, _("<standard error>"));
+
+	if (perf_is_enabled())
+		perf_gettime(&job->start);
+
+	job->pid = subproc_fork();
+	if (job->pid == 0) {
+		int nullfd;
+
+		/* The scripts cannot be interactive when run concurrently. */
+		nullfd = open("/dev/null", O_RDONLY);
+		if (nullfd < 0)
+			ohshite(_("unable to open '%s'"), "/dev/null");
+		m_dup2(nullfd, STDIN_FILENO);
+		m_dup2(job->out_fd, STDOUT_FILENO);
+		m_dup2(job->err_fd, STDERR_FILENO);
+		close(nullfd);
+		close(job->out_fd);
+		close(job->err_fd);
+
+		maintscript_child_exec(pkg, &pkg->installed, &cmd);
+	}
+
+	debug(dbg_scripts, "maintscript_postinst_job %s pid %d (%d running)",
+	      pkg_name(pkg, pnaw_always), (int)job->pid, jobs.count + 1);
+
+	if (jobs.tail)
+		jobs.tail->next = job;
+	else
+		jobs.head = job;
+	jobs.tail = job;
+	jobs.count++;
+
+	command_destroy(&cmd);
+
+	return 1;
+}
+
 int
 maintscript_new(struct pkginfo *pkg, const char *scriptname,
                 const char *desc, const char *cidir, char *cidirrest, ...)
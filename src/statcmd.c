@@ -26,6 +26,7 @@
 #include <sys/stat.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #if HAVE_LOCALE_H
 #include <locale.h>
 #endif
@@ -42,6 +43,7 @@
 #include <dpkg/dpkg-db.h>
 #include <dpkg/path.h>
 #include <dpkg/dir.h>
+#include <dpkg/file.h>
 #include <dpkg/glob.h>
 #include <dpkg/options.h>
 
@@ -79,6 +81,8 @@ usage(const struct cmdinfo *cip, const char *value)
 "                           add a new <path> entry into the database.\n"
 "  --remove <path>          remove <path> from the database.\n"
 "  --list [<glob-pattern>]  list current overrides in the database.\n"
+"  --batch [<file>|-]       run the commands in <file>, one per line, and\n"
+"                             write the database only once.\n"
 "\n"));
 
 	printf(_(
@@ -102,6 +106,10 @@ static int opt_verbose = 1;
 static int opt_force = 0;
 static int opt_update = 0;
 
+static int statdb_lock_fd = -1;
+static bool statdb_batch = false;
+static bool statdb_modified = false;
+
 static char *
 path_cleanup(const char *path)
 {
@@ -134,16 +142,6 @@ statdb_node_new(const char *user, const char *group, const char *mode)
 	return filestat;
 }
 
-static struct file_stat **
-statdb_node_find(const char *filename)
-{
-	struct filenamenode *file;
-
-	file = findnamenode(filename, 0);
-
-	return &file->statoverride;
-}
-
 static int
 statdb_node_remove(const char *filename)
 {
@@ -153,7 +151,7 @@ statdb_node_remove(const char *filename)
 	if (!file || (file && !file->statoverride))
 		return 0;
 
-	file->statoverride = NULL;
+	statdb_node_set(file, NULL);
 
 	return 1;
 }
@@ -200,22 +198,50 @@ statdb_node_print(FILE *out, struct filenamenode *file)
 	fprintf(out, "%o %s\n", filestat->mode & ~S_IFMT, file->name);
 }
 
+/*
+ * Serialize the database read-modify-write cycle against other instances,
+ * which might be run concurrently from maintainer scripts.
+ */
+static void
+statdb_lock(void)
+{
+	char *lockfile;
+
+	lockfile = dpkg_db_get_path(STATOVERRIDELOCKFILE);
+
+	statdb_lock_fd = open(lockfile, O_RDWR | O_CREAT, 0600);
+	if (statdb_lock_fd < 0) {
+		/* The database cannot be written either, let that report it. */
+		if (errno == EACCES || errno == EROFS) {
+			free(lockfile);
+			return;
+		}
+		ohshite(_("unable to open/create statoverride lock file '%.250s'"),
+		        lockfile);
+	}
+
+	file_lock(&statdb_lock_fd, FILE_LOCK_WAIT, lockfile,
+	          _("statoverride database"));
+
+	free(lockfile);
+}
+
 static void
 statdb_write(void)
 {
 	char *dbname;
 	struct atomic_file *dbfile;
-	struct fileiterator *iter;
+	struct statdb_iterator *iter;
 	struct filenamenode *file;
 
 	dbname = dpkg_db_get_path(STATOVERRIDEFILE);
 	dbfile = atomic_file_new(dbname, ATOMIC_FILE_BACKUP);
 	atomic_file_open(dbfile);
 
-	iter = files_db_iter_new();
-	while ((file = files_db_iter_next(iter)))
+	iter = statdb_iter_new();
+	while ((file = statdb_iter_next(iter)))
 		statdb_node_print(dbfile->fp, file);
-	files_db_iter_free(iter);
+	statdb_iter_free(iter);
 
 	atomic_file_sync(dbfile);
 	atomic_file_close(dbfile);
@@ -227,6 +253,16 @@ statdb_write(void)
 	free(dbname);
 }
 
+static void
+statdb_commit(void)
+{
+	/* In batch mode the database gets written once at the end. */
+	if (statdb_batch)
+		statdb_modified = true;
+	else
+		statdb_write();
+}
+
 static int
 statoverride_add(const char *const *argv)
 {
@@ -235,7 +271,8 @@ statoverride_add(const char *const *argv)
 	const char *mode = argv[2];
 	const char *path = argv[3];
 	char *filename;
-	struct file_stat **filestat;
+	struct filenamenode *file;
+	struct file_stat *filestat;
 
 	if (!user || !group || !mode || !path || argv[4])
 		badusage(_("--%s needs four arguments"), cipaction->olong);
@@ -245,8 +282,8 @@ statoverride_add(const char *const *argv)
 
 	filename = path_cleanup(path);
 
-	filestat = statdb_node_find(filename);
-	if (*filestat != NULL) {
+	file = findnamenode(filename, 0);
+	if (file->statoverride != NULL) {
 		if (opt_force)
 			warning(_("an override for '%s' already exists, "
 			          "but --force specified so will be ignored"),
@@ -256,21 +293,22 @@ statoverride_add(const char *const *argv)
 			         "aborting"), filename);
 	}
 
-	*filestat = statdb_node_new(user, group, mode);
+	filestat = statdb_node_new(user, group, mode);
 
 	if (opt_update) {
 		struct stat st;
 
 		if (stat(filename, &st) == 0) {
-			(*filestat)->mode |= st.st_mode & S_IFMT;
-			statdb_node_apply(filename, *filestat);
+			filestat->mode |= st.st_mode & S_IFMT;
+			statdb_node_apply(filename, filestat);
 		} else if (opt_verbose) {
 			warning(_("--update given but %s does not exist"),
 			        filename);
 		}
 	}
 
-	statdb_write();
+	statdb_node_set(file, filestat);
+	statdb_commit();
 
 	free(filename);
 
@@ -300,7 +338,7 @@ statoverride_remove(const char *const *argv)
 	if (opt_update && opt_verbose)
 		warning(_("--update is useless for --remove"));
 
-	statdb_write();
+	statdb_commit();
 
 	free(filename);
 
@@ -310,7 +348,7 @@ statoverride_remove(const char *const *argv)
 static int
 statoverride_list(const char *const *argv)
 {
-	struct fileiterator *iter;
+	struct statdb_iterator *iter;
 	struct filenamenode *file;
 	const char *thisarg;
 	struct glob_node *glob_list = NULL;
@@ -324,8 +362,8 @@ statoverride_list(const char *const *argv)
 	if (glob_list == NULL)
 		glob_list_prepend(&glob_list, m_strdup("*"));
 
-	iter = files_db_iter_new();
-	while ((file = files_db_iter_next(iter))) {
+	iter = statdb_iter_new();
+	while ((file = statdb_iter_next(iter))) {
 		struct glob_node *g;
 
 		for (g = glob_list; g; g = g->next) {
@@ -336,17 +374,77 @@ statoverride_list(const char *const *argv)
 			}
 		}
 	}
-	files_db_iter_free(iter);
+	statdb_iter_free(iter);
 
 	glob_list_free(glob_list);
 
 	return ret;
 }
 
+static int batch_verbose;
+static int batch_force;
+static int batch_update;
+
+static void
+statoverride_batch_reset(void)
+{
+	opt_verbose = batch_verbose;
+	opt_force = batch_force;
+	opt_update = batch_update;
+}
+
+static void
+cu_statdb_batch(int argc, void **argv)
+{
+	/* Keep the changes from the commands that did complete. */
+	if (statdb_modified)
+		statdb_write();
+}
+
+static const struct cmdinfo cmdinfos_batch[] = {
+	ACTION("add",    0, act_install,   statoverride_add),
+	ACTION("remove", 0, act_remove,    statoverride_remove),
+	ACTION("list",   0, act_listfiles, statoverride_list),
+
+	{ "quiet",      0,   0,  &opt_verbose, NULL,      NULL, 0       },
+	{ "force",      0,   0,  &opt_force,   NULL,      NULL, 1       },
+	{ "update",     0,   0,  &opt_update,  NULL,      NULL, 1       },
+	{  NULL,        0                                               }
+};
+
+static int
+statoverride_batch(const char *const *argv)
+{
+	const char *filename = argv[0];
+	int ret;
+
+	if (filename && argv[1])
+		badusage(_("--%s takes at most one argument"), cipaction->olong);
+
+	/* The options given on the command line are the defaults. */
+	batch_verbose = opt_verbose;
+	batch_force = opt_force;
+	batch_update = opt_update;
+
+	statdb_batch = true;
+	push_cleanup(cu_statdb_batch, ehflag_bombout, NULL, 0, 0);
+
+	ret = dpkg_options_run_batch(filename ? filename : "-", cmdinfos_batch,
+	                             NULL, statoverride_batch_reset);
+
+	pop_cleanup(ehflag_normaltidy);
+
+	if (statdb_modified)
+		statdb_write();
+
+	return ret;
+}
+
 static const struct cmdinfo cmdinfos[] = {
 	ACTION("add",    0, act_install,   statoverride_add),
 	ACTION("remove", 0, act_remove,    statoverride_remove),
 	ACTION("list",   0, act_listfiles, statoverride_list),
+	ACTION("batch",  0, act_install,   statoverride_batch),
 
 	{ "admindir",   0,   1,  NULL,         &admindir, NULL          },
 	{ "quiet",      0,   0,  &opt_verbose, NULL,      NULL, 0       },
@@ -371,11 +469,17 @@ main(int argc, const char *const *argv)
 	if (!cipaction)
 		badusage(_("need an action option"));
 
+	if (cipaction->arg_int != act_listfiles)
+		statdb_lock();
+
 	filesdbinit();
 	ensure_statoverrides(STATDB_PARSE_LAX);
 
 	ret = cipaction->action(argv);
 
+	if (statdb_lock_fd >= 0)
+		pop_cleanup(ehflag_normaltidy);
+
 	dpkg_program_done();
 
 	return ret;
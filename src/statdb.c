@@ -44,6 +44,102 @@
 
 static char *statoverridename;
 
+/*
+ * Index of the namenodes carrying a statoverride, so that resetting or
+ * walking the overrides costs O(overrides) instead of O(all files).
+ */
+static struct filenamenode **statoverride_nodes;
+static int statoverride_nodes_used;
+static int statoverride_nodes_max;
+
+static int
+statdb_node_index(struct filenamenode *fnn)
+{
+	int i;
+
+	for (i = 0; i < statoverride_nodes_used; i++)
+		if (statoverride_nodes[i] == fnn)
+			return i;
+
+	return -1;
+}
+
+/**
+ * Set or clear the statoverride of a namenode, keeping the index in sync.
+ */
+void
+statdb_node_set(struct filenamenode *fnn, struct file_stat *filestat)
+{
+	if (filestat && fnn->statoverride == NULL) {
+		if (statoverride_nodes_used == statoverride_nodes_max) {
+			statoverride_nodes_max = statoverride_nodes_max * 2 + 64;
+			statoverride_nodes = m_realloc(statoverride_nodes,
+			                               sizeof(*statoverride_nodes) *
+			                               statoverride_nodes_max);
+		}
+		statoverride_nodes[statoverride_nodes_used++] = fnn;
+	} else if (filestat == NULL && fnn->statoverride) {
+		int i = statdb_node_index(fnn);
+
+		if (i >= 0) {
+			statoverride_nodes_used--;
+			memmove(&statoverride_nodes[i], &statoverride_nodes[i + 1],
+			        sizeof(*statoverride_nodes) *
+			        (statoverride_nodes_used - i));
+		}
+	}
+
+	fnn->statoverride = filestat;
+}
+
+struct statdb_iterator {
+	int index;
+};
+
+struct statdb_iterator *
+statdb_iter_new(void)
+{
+	struct statdb_iterator *iter;
+
+	iter = m_malloc(sizeof(*iter));
+	iter->index = 0;
+
+	return iter;
+}
+
+struct filenamenode *
+statdb_iter_next(struct statdb_iterator *iter)
+{
+	if (iter->index >= statoverride_nodes_used)
+		return NULL;
+
+	return statoverride_nodes[iter->index++];
+}
+
+void
+statdb_iter_free(struct statdb_iterator *iter)
+{
+	free(iter);
+}
+
+/* The parsed statoverrides, released on each reload. */
+static struct nfarena *statdb_arena;
+
+static void
+statdb_reset(void)
+{
+	int i;
+
+	for (i = 0; i < statoverride_nodes_used; i++)
+		statoverride_nodes[i]->statoverride = NULL;
+	statoverride_nodes_used = 0;
+
+	if (statdb_arena)
+		nfarena_reset(statdb_arena);
+	else
+		statdb_arena = nfarena_new("statdb");
+}
+
 uid_t
 statdb_parse_uid(const char *str)
 {
@@ -119,7 +215,6 @@ ensure_statoverrides(enum statdb_parse_flags flags)
 	char *loaded_list, *loaded_list_end, *thisline, *nextline, *ptr;
 	struct file_stat *fso;
 	struct filenamenode *fnn;
-	struct fileiterator *iter;
 
 	if (statoverridename == NULL)
 		statoverridename = dpkg_db_get_path(STATOVERRIDEFILE);
@@ -158,10 +253,7 @@ ensure_statoverrides(enum statdb_parse_flags flags)
 	file_prev = file;
 
 	/* Reset statoverride information. */
-	iter = files_db_iter_new();
-	while ((fnn = files_db_iter_next(iter)))
-		fnn->statoverride = NULL;
-	files_db_iter_free(iter);
+	statdb_reset();
 
 	if (!file) {
 		onerr_abort--;
@@ -177,7 +269,9 @@ ensure_statoverrides(enum statdb_parse_flags flags)
 		return;
 	}
 
-	loaded_list = nfmalloc(sb_next.st_size);
+	/* The namenodes and user and group names get their own copies, so
+	 * the buffer does not need to outlive the parse. */
+	loaded_list = m_malloc(sb_next.st_size);
 	loaded_list_end = loaded_list + sb_next.st_size;
 
 	if (fd_read(fileno(file), loaded_list, sb_next.st_size) < 0)
@@ -185,7 +279,7 @@ ensure_statoverrides(enum statdb_parse_flags flags)
 
 	thisline = loaded_list;
 	while (thisline < loaded_list_end) {
-		fso = nfmalloc(sizeof(struct file_stat));
+		fso = nfarena_alloc(statdb_arena, sizeof(struct file_stat));
 
 		ptr = memchr(thisline, '\n', loaded_list_end - thisline);
 		if (ptr == NULL)
@@ -204,7 +298,7 @@ ensure_statoverrides(enum statdb_parse_flags flags)
 
 		fso->uid = statdb_parse_uid(thisline);
 		if (fso->uid == (uid_t)-1)
-			fso->uname = nfstrsave(thisline);
+			fso->uname = nfarena_strsave(statdb_arena, thisline);
 		else
 			fso->uname = NULL;
 
@@ -225,7 +319,7 @@ ensure_statoverrides(enum statdb_parse_flags flags)
 
 		fso->gid = statdb_parse_gid(thisline);
 		if (fso->gid == (gid_t)-1)
-			fso->gname = nfstrsave(thisline);
+			fso->gname = nfarena_strsave(statdb_arena, thisline);
 		else
 			fso->gname = NULL;
 
@@ -255,11 +349,13 @@ ensure_statoverrides(enum statdb_parse_flags flags)
 		if (fnn->statoverride)
 			ohshit(_("multiple statoverrides present for file '%.250s'"),
 			       thisline);
-		fnn->statoverride = fso;
+		statdb_node_set(fnn, fso);
 
 		/* Moving on... */
 		thisline = nextline;
 	}
 
+	free(loaded_list);
+
 	onerr_abort--;
 }
@@ -40,7 +40,7 @@ if (! -x "@dd") {
     exit(0);
 }
 
-plan tests => 257;
+plan tests => 284;
 
 sub cleanup {
     # On FreeBSD «rm -rf» cannot traverse a directory with mode 000.
@@ -555,6 +555,117 @@ diversions_eq('');
 
 cleanup();
 
+note('Batch mode');
+
+install_diversions('');
+system("touch $testdir/foo");
+
+my $batch = <<"EOF";
+# Comment
+--rename $testdir/foo
+
+--package bash --divert $testdir/bar.bash $testdir/bar
+--add $testdir/baz
+--test --remove $testdir/bar
+--remove $testdir/baz
+EOF
+call_divert(['--quiet', '--batch'], from_string => \$batch,
+            expect_stdout => '', expect_stderr => '');
+ok(-e "$testdir/foo.distrib", 'foo diversion renamed in batch');
+ok(!-e "$testdir/foo", 'foo diversion renamed in batch');
+diversions_eq(<<"EOF");
+$testdir/foo
+$testdir/foo.distrib
+:
+$testdir/bar
+$testdir/bar.bash
+bash
+EOF
+
+$batch = <<"EOF";
+--add $testdir/baz
+--divert $testdir/bar.other --add $testdir/bar
+--add $testdir/quux
+EOF
+call_divert(['--batch', '-'], from_string => \$batch,
+            expect_failure => 1, expect_stderr_like => qr/clashes/);
+diversions_eq(<<"EOF");
+$testdir/foo
+$testdir/foo.distrib
+:
+$testdir/bar
+$testdir/bar.bash
+bash
+$testdir/baz
+$testdir/baz.distrib
+:
+EOF
+
+cleanup();
+
+install_diversions('');
+system("touch $testdir/foo $testdir/bar");
+
+$batch = <<"EOF";
+--rename $testdir/foo
+--rename --remove $testdir/foo
+--rename $testdir/bar
+EOF
+call_divert(['--quiet', '--batch'], from_string => \$batch,
+            expect_stdout => '', expect_stderr => '');
+ok(-e "$testdir/foo", 'foo renamed back in batch');
+ok(!-e "$testdir/foo.distrib", 'foo renamed back in batch');
+ok(-e "$testdir/bar.distrib", 'bar diversion renamed in batch');
+ok(!-e "$testdir/bar", 'bar diversion renamed in batch');
+diversions_eq(<<"EOF");
+$testdir/bar
+$testdir/bar.distrib
+:
+EOF
+
+cleanup();
+
+install_diversions('');
+system("touch $testdir/foo");
+
+$batch = <<"EOF";
+--rename $testdir/foo
+--divert $testdir/foo.other --rename $testdir/foo
+EOF
+call_divert(['--quiet', '--batch'], from_string => \$batch,
+            expect_failure => 1, expect_stderr_like => qr/clashes/);
+ok(-e "$testdir/foo.distrib", 'foo diversion renamed before failing line');
+ok(!-e "$testdir/foo", 'foo diversion renamed before failing line');
+diversions_eq(<<"EOF");
+$testdir/foo
+$testdir/foo.distrib
+:
+EOF
+
+cleanup();
+
+SKIP: {
+    skip 'device /dev/full is not available', 5 if not -c '/dev/full';
+
+    # Files must not be moved aside before the database records them.
+    install_diversions('');
+    system("touch $testdir/foo");
+    system("ln -s /dev/full $admindir/diversions-new");
+
+    $batch = "--rename $testdir/foo\n";
+    call_divert(['--quiet', '--batch'], from_string => \$batch,
+                expect_failure => 1,
+                expect_stderr_like => qr/(write|flush|close).*new/);
+    ok(-e "$testdir/foo", 'foo not renamed if the database is not written');
+    ok(!-e "$testdir/foo.distrib",
+       'foo not renamed if the database is not written');
+
+    system("rm -f $admindir/diversions-new");
+    diversions_eq('');
+}
+
+cleanup();
+
 note('Corrupted divertions db handling');
 
 SKIP: {
@@ -0,0 +1,204 @@
+#!/usr/bin/perl
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+use strict;
+use warnings;
+
+use Test::More;
+
+use File::Spec;
+
+use Dpkg::IPC;
+
+# Cleanup environment from variables that pollute the test runs.
+delete $ENV{DPKG_MAINTSCRIPT_PACKAGE};
+delete $ENV{DPKG_MAINTSCRIPT_ARCH};
+
+my $builddir = $ENV{builddir} || '.';
+my $tmpdir = 't.tmp/dpkg_query';
+my $admindir = File::Spec->rel2abs("$tmpdir/admindir");
+
+my $dpkg = "$builddir/../src/dpkg";
+my $dpkg_query = "$builddir/../src/dpkg-query";
+
+if (! -x $dpkg or ! -x $dpkg_query) {
+    plan skip_all => 'dpkg or dpkg-query not available';
+    exit(0);
+}
+
+my @formats = (
+    undef,
+    '${Package} ${Version} ${Status}\n',
+    '${binary:Package} ${Architecture} ${Multi-Arch}\n',
+    '${db:Status-Abbrev} ${db:Status-Want} ${db:Status-Status}\n',
+);
+my @patterns = (
+    [ ],
+    [ 'pkg-*' ],
+    [ 'pkg-trig', 'pkg-awaited' ],
+    [ 'pkg-multi:amd64' ],
+    [ 'pkg-referenced' ],
+);
+
+# Exact --showformat output, checked against the formatting done for each
+# kind of format node.
+my @showformats = (
+    [ '${Package;-12}|${Version;8}|${Package;5}|${Package;-5}|\n',
+      [ 'pkg-plain', 'pkg-unpacked' ],
+      "pkg-plain   |   1.0-1|pkg-p|pkg-p|\n" .
+      "pkg-unpacked|     0.1|pkg-u|pkg-u|\n" ],
+    [ 'name=${Package}\tver=${Version}\\\\end\q $5 $\r\n',
+      [ 'pkg-plain' ],
+      "name=pkg-plain\tver=1.0-1\\endq \$5 \$\r\n" ],
+    [ '${binary:Package}|${binary:Summary}|${db:Status-Abbrev}|' .
+      '${db:Status-Want} ${db:Status-Status} ${db:Status-Eflag}|' .
+      '${source:Package}|${source:Version}\n',
+      [ 'pkg-plain', 'pkg-multi:i386', 'pkg-unpacked' ],
+      "pkg-multi:i386|dummy|ii |install installed ok|pkg-multi|2:3.4~rc1\n" .
+      "pkg-plain|plain summary|ii |install installed ok|pkg-src|1.0-0\n" .
+      "pkg-unpacked|dummy|iU |install unpacked ok|pkg-unpacked|0.1\n" ],
+    [ '${X-Custom}|${x-custom;-15}|${X-Custom;14}|${X-Custom;3}\n',
+      [ 'pkg-plain' ],
+      "custom value|custom value   |  custom value|cus\n" ],
+    [ '[${X-Missing}][${X-Missing;5}][${Depends;4}][${Depends}]\n',
+      [ 'pkg-multi:amd64', 'pkg-plain' ],
+      "[][][    ][]\n" .
+      "[][][pkg-][pkg-referenced]\n" ],
+);
+
+plan tests => 2 + @formats * @patterns + @showformats;
+
+system("rm -rf $tmpdir && mkdir -p $admindir/updates $admindir/info");
+
+open my $status_fh, '>', "$admindir/status"
+    or die "cannot create $admindir/status";
+print { $status_fh } <<'STATUS';
+Package: pkg-plain
+Status: install ok installed
+Version: 1.0-1
+Architecture: all
+Maintainer: dummy
+Source: pkg-src (1.0-0)
+Depends: pkg-referenced
+X-Custom: custom value
+Description: plain summary
+ Plain long description.
+
+Package: pkg-multi
+Status: install ok installed
+Multi-Arch: same
+Version: 2:3.4~rc1
+Architecture: amd64
+Maintainer: dummy
+Description: dummy
+
+Package: pkg-multi
+Status: install ok installed
+Multi-Arch: same
+Version: 2:3.4~rc1
+Architecture: i386
+Maintainer: dummy
+Description: dummy
+
+Package: pkg-unpacked
+Status: install ok unpacked
+Version: 0.1
+Architecture: all
+Maintainer: dummy
+Description: dummy
+
+Package: pkg-trig
+Status: install ok triggers-pending
+Version: 1.0
+Architecture: all
+Maintainer: dummy
+Triggers-Pending: some-trigger
+Description: dummy
+
+Package: pkg-awaited
+Status: install ok triggers-awaited
+Version: 1.0
+Architecture: all
+Maintainer: dummy
+Triggers-Awaited: pkg-trig
+Description: dummy
+
+Package: pkg-removed
+Status: deinstall ok config-files
+Version: 1.0
+Architecture: all
+Maintainer: dummy
+Conffiles:
+ /etc/pkg-removed.conf 00000000000000000000000000000000
+Description: dummy
+
+STATUS
+close $status_fh;
+system("touch $admindir/available");
+
+sub dpkg_query {
+    my (@args) = @_;
+    my ($stdout, $stderr);
+
+    spawn(exec => [ $dpkg_query, "--admindir=$admindir", @args ],
+          nocheck => 1, to_string => \$stdout, error_to_string => \$stderr);
+
+    return "exit=$?\n$stdout$stderr";
+}
+
+sub dpkg_query_all {
+    my %output;
+
+    foreach my $i (0 .. $#formats) {
+        foreach my $j (0 .. $#patterns) {
+            my @args = ('-W');
+
+            push @args, "--showformat=$formats[$i]" if defined $formats[$i];
+            push @args, @{$patterns[$j]};
+            $output{"$i:$j"} = dpkg_query(@args);
+        }
+    }
+
+    return %output;
+}
+
+# Rewrite the status database, which dumps its snapshot.
+spawn(exec => [ $dpkg, "--admindir=$admindir", '--set-selections' ],
+      from_string => \'', wait_child => 1);
+ok(-s "$admindir/status.snapshot", 'status snapshot written');
+
+system("mv $admindir/status.snapshot $admindir/status.snapshot.keep");
+my %expected = dpkg_query_all();
+system("mv $admindir/status.snapshot.keep $admindir/status.snapshot");
+
+my %output = dpkg_query_all();
+foreach my $i (0 .. $#formats) {
+    foreach my $j (0 .. $#patterns) {
+        my $desc = join ' ', $formats[$i] // 'default',
+                             @{$patterns[$j]};
+
+        is($output{"$i:$j"}, $expected{"$i:$j"},
+           "dpkg-query -W output with snapshot ($desc)");
+    }
+}
+
+ok(-s "$admindir/status.snapshot", 'status snapshot kept by readers');
+
+foreach my $showformat (@showformats) {
+    my ($format, $patterns, $expected) = @{$showformat};
+
+    is(dpkg_query('-W', "--showformat=$format", @{$patterns}),
+       "exit=0\n$expected", "dpkg-query -W --showformat=$format");
+}
@@ -0,0 +1,153 @@
+#!/usr/bin/perl
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+use strict;
+use warnings;
+
+use Test::More;
+
+use File::Spec;
+
+use Dpkg::IPC;
+
+# Cleanup environment from variables that pollute the test runs.
+delete $ENV{DPKG_MAINTSCRIPT_PACKAGE};
+delete $ENV{DPKG_MAINTSCRIPT_ARCH};
+
+my $builddir = $ENV{builddir} || '.';
+my $tmpdir = 't.tmp/dpkg_script_jobs';
+my $admindir = File::Spec->rel2abs("$tmpdir/admindir");
+my $testdir = File::Spec->rel2abs("$tmpdir/testdir");
+
+my $dpkg = File::Spec->rel2abs("$builddir/../src/dpkg");
+my $divert = File::Spec->rel2abs("$builddir/../src/dpkg-divert");
+
+if (! -x $dpkg or ! -x $divert) {
+    plan skip_all => 'dpkg or dpkg-divert not available';
+    exit(0);
+}
+
+plan tests => 5;
+
+my $ndiversions = 10;
+
+sub cleanup {
+    system("rm -rf $tmpdir && mkdir -p $testdir");
+    system("mkdir -p $admindir/updates $admindir/info");
+    system("touch $admindir/diversions");
+}
+
+sub install_package {
+    my ($pkgname, $postinst) = @_;
+
+    open(my $status_fh, '>>', "$admindir/status")
+        or die "cannot open $admindir/status";
+    print { $status_fh } <<"EOF";
+Package: $pkgname
+Status: install ok unpacked
+Version: 1.0
+Architecture: all
+Maintainer: dummy
+Description: dummy
+
+EOF
+    close($status_fh);
+
+    my $script = "$admindir/info/$pkgname.postinst";
+    open(my $script_fh, '>', $script) or die "cannot create $script";
+    print { $script_fh } "#!/bin/sh\nset -e\n$postinst";
+    close($script_fh);
+    chmod 0755, $script;
+}
+
+sub call_dpkg {
+    my ($args, %opts) = @_;
+    my ($output, $error);
+
+    spawn(exec => [ $dpkg, '--admindir', $admindir,
+                    '--force-not-root', '--force-bad-path', @{$args} ],
+          wait_child => 1, nocheck => 1,
+          to_string => \$output, error_to_string => \$error, %opts);
+
+    is($? >> 8, 0, "@{$args} exit code");
+}
+
+sub read_diversions {
+    open(my $db_fh, '<', "$admindir/diversions")
+        or die "cannot open $admindir/diversions";
+    my @contents = <$db_fh>;
+    close($db_fh);
+
+    my @diversions;
+    while (my ($from, $to, $pkgname) = splice @contents, 0, 3) {
+        chomp $from;
+        push @diversions, $from;
+    }
+
+    return sort @diversions;
+}
+
+### Tests
+
+cleanup();
+
+note('Concurrent postinst scripts updating the diversions database');
+
+foreach my $pkgname (qw(pkg-a pkg-b)) {
+    install_package($pkgname, <<"EOF");
+for i in \$(seq 1 $ndiversions); do
+  $divert --quiet --add $testdir/$pkgname-\$i
+done
+EOF
+}
+
+call_dpkg([ '--script-jobs=2', '--configure', '-a' ]);
+
+my @expected = sort map {
+    my $pkgname = $_;
+    map { "$testdir/$pkgname-$_" } 1 .. $ndiversions
+} qw(pkg-a pkg-b);
+my @diversions = read_diversions();
+is_deeply(\@diversions, \@expected, 'diversions from all scripts kept');
+
+note('Postinst scripts using debconf get run in the foreground');
+
+cleanup();
+
+install_package('pkg-debconf', <<"EOF");
+# . /usr/share/debconf/confmodule
+read answer
+echo "\$answer" >$testdir/answer
+EOF
+install_package('pkg-plain', <<"EOF");
+true
+EOF
+
+call_dpkg([ '--script-jobs=2', '--configure', '-a' ],
+          from_string => \"yes\n");
+
+open(my $answer_fh, '<', "$testdir/answer")
+    or die "cannot open $testdir/answer";
+my $answer = <$answer_fh>;
+close($answer_fh);
+is($answer, "yes\n", 'debconf script got the standard input');
+
+my @status = grep { m/^Status:/ } do {
+    open(my $status_fh, '<', "$admindir/status")
+        or die "cannot open $admindir/status";
+    <$status_fh>;
+};
+is_deeply(\@status, [ ("Status: install ok installed\n") x 2 ],
+          'all packages configured');
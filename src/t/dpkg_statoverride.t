@@ -0,0 +1,192 @@
+#!/usr/bin/perl
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+use strict;
+use warnings;
+
+use Test::More;
+
+use File::Spec;
+
+use Dpkg::IPC;
+
+# Cleanup environment from variables that pollute the test runs.
+delete $ENV{DPKG_MAINTSCRIPT_PACKAGE};
+delete $ENV{DPKG_MAINTSCRIPT_ARCH};
+
+my $builddir = $ENV{builddir} || '.';
+my $tmpdir = 't.tmp/dpkg_statoverride';
+my $admindir = File::Spec->rel2abs("$tmpdir/admindir");
+my $testdir = File::Spec->rel2abs("$tmpdir/testdir");
+
+my @dso = ("$builddir/../src/dpkg-statoverride");
+
+if (! -x "@dso") {
+    plan skip_all => 'dpkg-statoverride not available';
+    exit(0);
+}
+
+plan tests => 28;
+
+my $user = getpwuid($<);
+my $group = getgrgid($();
+
+if (not defined $user or not defined $group) {
+    BAIL_OUT('cannot get the current user and group names');
+}
+
+sub cleanup {
+    system("rm -rf $tmpdir && mkdir -p $testdir");
+    system("mkdir -p $admindir/updates");
+}
+
+sub install_statoverrides {
+    my ($txt) = @_;
+    open(my $db_fh, '>', "$admindir/statoverride")
+        or die "cannot create $admindir/statoverride";
+    print { $db_fh } $txt;
+    close($db_fh);
+}
+
+sub call_statoverride {
+    my ($args, %opts) = @_;
+    my ($output, $error);
+
+    spawn(exec => [ @dso, '--admindir', $admindir, @{$args} ],
+          wait_child => 1, nocheck => 1,
+          to_string => \$output, error_to_string => \$error, %opts);
+
+    my $status = $? >> 8;
+    my $exitcode = $opts{expect_exitcode} // 0;
+    is($status, $exitcode, "@{$args} exit code");
+
+    if (defined $opts{expect_stdout}) {
+        is($output, $opts{expect_stdout}, "@{$args} stdout");
+    }
+    if (defined $opts{expect_stderr}) {
+        is($error, $opts{expect_stderr}, "@{$args} stderr");
+    }
+    if (defined $opts{expect_stderr_like}) {
+        like($error, $opts{expect_stderr_like}, "@{$args} stderr");
+    }
+}
+
+sub statoverrides_eq {
+    my ($expected, $desc) = @_;
+
+    open(my $db_fh, '<', "$admindir/statoverride")
+        or die "cannot open $admindir/statoverride";
+    my @contents = <$db_fh>;
+    close($db_fh);
+    my @expected = split /^/, $expected;
+
+    is_deeply([ sort @contents ], [ sort @expected ], $desc);
+}
+
+### Tests
+
+cleanup();
+
+note('Batch mode');
+
+install_statoverrides('');
+system("touch $testdir/foo $testdir/bar $testdir/baz");
+chmod 0644, "$testdir/foo", "$testdir/bar", "$testdir/baz";
+
+my $batch = <<"EOF";
+# Comment
+--add $user $group 0600 $testdir/foo
+
+--update --add $user $group 0640 $testdir/bar
+--add $user $group 4755 $testdir/baz
+--remove $testdir/baz
+EOF
+call_statoverride([ '--batch' ], from_string => \$batch,
+                  expect_stdout => '', expect_stderr => '');
+statoverrides_eq(<<"EOF", 'overrides written by batch');
+$user $group 600 $testdir/foo
+$user $group 640 $testdir/bar
+EOF
+is((stat "$testdir/foo")[2] & 07777, 0644, 'foo not updated without --update');
+is((stat "$testdir/bar")[2] & 07777, 0640, 'bar updated with --update');
+is((stat "$testdir/baz")[2] & 07777, 0644, 'baz not updated');
+
+call_statoverride([ '--batch', '-' ], from_string => \"--list $testdir/b*\n",
+                  expect_stdout => "$user $group 640 $testdir/bar\n",
+                  expect_stderr => '');
+
+note('Batch mode with command line defaults');
+
+$batch = <<"EOF";
+--add $user $group 0755 $testdir/baz
+--remove $testdir/none
+--remove $testdir/foo
+EOF
+call_statoverride([ '--quiet', '--update', '--batch' ],
+                  from_string => \$batch,
+                  expect_exitcode => 2,
+                  expect_stdout => '', expect_stderr => '');
+statoverrides_eq(<<"EOF", 'overrides written by batch with defaults');
+$user $group 640 $testdir/bar
+$user $group 755 $testdir/baz
+EOF
+is((stat "$testdir/baz")[2] & 07777, 0755, 'baz updated with default --update');
+
+$batch = <<"EOF";
+--remove $testdir/none
+--force --remove $testdir/none
+EOF
+call_statoverride([ '--batch' ], from_string => \$batch,
+                  expect_exitcode => 2,
+                  expect_stderr_like => qr/no override present/);
+
+note('Batch mode with a failing command');
+
+$batch = <<"EOF";
+--add $user $group 0600 $testdir/foo
+--add $user $group 0644 $testdir/bar
+--remove $testdir/baz
+EOF
+call_statoverride([ '--batch' ], from_string => \$batch,
+                  expect_exitcode => 2,
+                  expect_stderr_like => qr/override for '\Q$testdir\E\/bar' already exists/);
+statoverrides_eq(<<"EOF", 'overrides from preceding commands kept');
+$user $group 600 $testdir/foo
+$user $group 640 $testdir/bar
+$user $group 755 $testdir/baz
+EOF
+
+call_statoverride([ '--batch' ],
+                  from_string => \"--force --add $user $group 0644 $testdir/bar\n",
+                  expect_stderr_like => qr/already exists, but --force/);
+statoverrides_eq(<<"EOF", 'override replaced with --force');
+$user $group 600 $testdir/foo
+$user $group 644 $testdir/bar
+$user $group 755 $testdir/baz
+EOF
+
+call_statoverride([ '--batch' ],
+                  from_string => \"--add $user $group 0644\n",
+                  expect_exitcode => 2,
+                  expect_stderr_like => qr/needs four arguments/);
+call_statoverride([ '--batch' ],
+                  from_string => \"--unknown $testdir/foo\n",
+                  expect_exitcode => 2,
+                  expect_stderr_like => qr/unknown option/);
+statoverrides_eq(<<"EOF", 'overrides kept on bad usage');
+$user $group 600 $testdir/foo
+$user $group 644 $testdir/bar
+$user $group 755 $testdir/baz
+EOF
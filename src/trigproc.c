@@ -35,6 +35,7 @@
 #include <dpkg/pkg.h>
 #include <dpkg/pkg-queue.h>
 #include <dpkg/triglib.h>
+#include <dpkg/perf.h>
 
 #include "main.h"
 #include "filesdb.h"
@@ -78,6 +79,15 @@
  * new things to the deferred trigproc list.
  *
  *
+ * When a package in the argument queue only needs trigger processing, but
+ * there are still packages in the queue to be configured, we postpone it
+ * to the end of the queue, as configuring these might activate further
+ * triggers for it. All those activations get then coalesced into a single
+ * trigger processing run, which happens either once there is nothing else
+ * left to configure, or when some other package requires it to make
+ * progress (see above).
+ *
+ *
  * Note that ‘we trigproc T’ must involve trigger cycle detection and
  * also automatic setting of t-awaiters to t-pending or installed. In
  * particular, we do cycle detection even for trigger processing in the
@@ -90,12 +100,23 @@
 
 static struct pkg_queue deferred = PKG_QUEUE_INIT;
 
+/** Number of trigger processing runs saved by coalescing activations. */
+static int trigproc_coalesced;
+
 static void
 trigproc_enqueue_deferred(struct pkginfo *pend)
 {
 	if (f_triggers < 0)
 		return;
 	ensure_package_clientdata(pend);
+	if (pend->clientdata->trigprocpostponed == TRIGPROC_POSTPONE_WAITING) {
+		/* Had the package not been postponed, it would have been
+		 * processed already, and would need another run now. */
+		pend->clientdata->trigprocpostponed = TRIGPROC_POSTPONE_COALESCED;
+		trigproc_coalesced++;
+		debug(dbg_triggers, "trigproc_enqueue_deferred pend=%s coalesced",
+		      pkg_name(pend, pnaw_always));
+	}
 	if (pend->clientdata->trigprocdeferred)
 		return;
 	pend->clientdata->trigprocdeferred = pkg_queue_push(&deferred, pend);
@@ -166,6 +187,29 @@ trigproc_run_deferred(void)
 
 		pop_error_context(ehflag_normaltidy);
 	}
+
+	if (trigproc_coalesced) {
+		debug(dbg_triggers, "trigproc_run_deferred coalesced %d runs",
+		      trigproc_coalesced);
+		perf_count("triggers-coalesced", trigproc_coalesced);
+		trigproc_coalesced = 0;
+	}
+}
+
+/**
+ * Postpone trigger processing for a package from the argument queue.
+ *
+ * Any activation noted for the package from now on until it gets
+ * processed will be coalesced into a single trigger processing run.
+ */
+void
+trigproc_postpone(struct pkginfo *pkg)
+{
+	debug(dbg_triggers, "trigproc_postpone %s", pkg_name(pkg, pnaw_always));
+
+	ensure_package_clientdata(pkg);
+	if (pkg->clientdata->trigprocpostponed == TRIGPROC_POSTPONE_NONE)
+		pkg->clientdata->trigprocpostponed = TRIGPROC_POSTPONE_WAITING;
 }
 
 /*
@@ -199,11 +243,17 @@ struct trigcycleperpkg {
 static bool tortoise_advance;
 static struct trigcyclenode *tortoise, *hare;
 
+/* The cycle detection nodes, released when the chain gets reset. */
+static struct nfarena *trigcycle_arena;
+
 void
 trigproc_reset_cycle(void)
 {
 	tortoise_advance = false;
 	tortoise = hare = NULL;
+
+	if (trigcycle_arena)
+		nfarena_reset(trigcycle_arena);
 }
 
 static bool
@@ -264,7 +314,10 @@ check_trigger_cycle(struct pkginfo *processing_now)
 	debug(dbg_triggers, "check_triggers_cycle pnow=%s",
 	      pkg_name(processing_now, pnaw_always));
 
-	tcn = nfmalloc(sizeof(*tcn));
+	if (trigcycle_arena == NULL)
+		trigcycle_arena = nfarena_new("trigcycle");
+
+	tcn = nfarena_alloc(trigcycle_arena, sizeof(*tcn));
 	tcn->pkgs = NULL;
 	tcn->then_processed = processing_now;
 
@@ -272,7 +325,7 @@ check_trigger_cycle(struct pkginfo *processing_now)
 	while ((pkg = pkg_db_iter_next_pkg(it))) {
 		if (!pkg->trigpend_head)
 			continue;
-		tcpp = nfmalloc(sizeof(*tcpp));
+		tcpp = nfarena_alloc(trigcycle_arena, sizeof(*tcpp));
 		tcpp->pkg = pkg;
 		tcpp->then_trigs = pkg->trigpend_head;
 		tcpp->next = tcn->pkgs;
@@ -345,12 +398,8 @@ check_trigger_cycle(struct pkginfo *processing_now)
 	return giveup;
 }
 
-/*
- * Does cycle checking. Doesn't mind if pkg has no triggers pending - in
- * that case does nothing but fix up any stale awaiters.
- */
-void
-trigproc(struct pkginfo *pkg, enum trigproc_type type)
+static void
+trigproc_run(struct pkginfo *pkg, enum trigproc_type type)
 {
 	static struct varbuf namesarg;
 
@@ -363,6 +412,7 @@ trigproc(struct pkginfo *pkg, enum trigproc_type type)
 	if (pkg->clientdata->trigprocdeferred)
 		pkg->clientdata->trigprocdeferred->pkg = NULL;
 	pkg->clientdata->trigprocdeferred = NULL;
+	pkg->clientdata->trigprocpostponed = TRIGPROC_POSTPONE_NONE;
 
 	if (pkg->trigpend_head) {
 		enum dep_check ok;
@@ -453,6 +503,20 @@ trigproc(struct pkginfo *pkg, enum trigproc_type type)
 	}
 }
 
+/*
+ * Does cycle checking. Doesn't mind if pkg has no triggers pending - in
+ * that case does nothing but fix up any stale awaiters.
+ */
+void
+trigproc(struct pkginfo *pkg, enum trigproc_type type)
+{
+	struct perf_phase *phase;
+
+	phase = perf_phase_start("triggers");
+	trigproc_run(pkg, type);
+	perf_phase_stop(phase);
+}
+
 /*========== Transitional global activation. ==========*/
 
 static void
@@ -499,6 +563,7 @@ trig_transitional_activate(enum modstatdb_rw cstatus)
 		      pkg_name(pkg, pnaw_always),
 		      pkg_status_name(pkg));
 		pkg->trigpend_head = NULL;
+		pkg_invalidate_stanza(pkg);
 		trig_parse_ci(pkg_infodb_get_file(pkg, &pkg->installed,
 		                                  TRIGGERSCIFILE),
 		              cstatus >= msdbrw_write ?
@@ -53,6 +53,7 @@
 #include <dpkg/tarfn.h>
 #include <dpkg/options.h>
 #include <dpkg/triglib.h>
+#include <dpkg/perf.h>
 
 #include "filesdb.h"
 #include "file-match.h"
@@ -352,6 +353,7 @@ pkg_infodb_update(struct pkginfo *pkg, char *cidir, char *cidirrest)
   while ((match_node = match_head)) {
     strcpy(cidirrest, match_node->filetype);
 
+    perf_count("rename", 1);
     if (!rename(cidir, match_node->filename)) {
       debug(dbg_scripts, "process_archive info installed %s as %s",
             cidir, match_node->filename);
@@ -410,6 +412,7 @@ pkg_infodb_update(struct pkginfo *pkg, char *cidir, char *cidirrest)
 
     /* Right, install it */
     newinfofilename = pkg_infodb_get_file(pkg, &pkg->available, de->d_name);
+    perf_count("rename", 1);
     if (rename(cidir, newinfofilename))
       ohshite(_("unable to install new info file '%.250s' as '%.250s'"),
               cidir, newinfofilename);
@@ -536,6 +539,7 @@ void process_archive(const char *filename) {
   struct stat stab, oldfs;
   struct pkg_deconf_list *deconpil;
   struct pkginfo *fixbytrigaw;
+  struct perf_phase *phase;
 
   cleanup_pkg_failed= cleanup_conflictor_failed= 0;
 
@@ -549,6 +553,8 @@ void process_archive(const char *filename) {
       return;
   }
 
+  phase = perf_phase_start("archive-control");
+
   /* Verify the package. */
   if (!f_nodebsig)
     deb_verify(filename);
@@ -574,6 +580,8 @@ void process_archive(const char *filename) {
    * XXX: This could be avoided by switching to an internal tar extractor. */
   dir_sync_contents(cidir);
 
+  perf_phase_stop(phase);
+
   strcpy(cidirrest,CONTROLFILE);
 
   if (cipaction->arg_int == act_avail)
@@ -947,6 +955,8 @@ void process_archive(const char *filename) {
    * files get replaced ‘as we go’.
    */
 
+  phase = perf_phase_start("archive-unpack");
+
   m_pipe(p1);
   push_cleanup(cu_closepipe, ehflag_bombout, NULL, 0, 1, (void *)&p1[0]);
   pid = subproc_fork();
@@ -980,7 +990,11 @@ void process_archive(const char *filename) {
   p1[0] = -1;
   subproc_reap(pid, BACKEND " --fsys-tarfile", SUBPROC_NOPIPE);
 
+  perf_phase_stop(phase);
+
+  phase = perf_phase_start("archive-sync");
   tar_deferred_extract(newfileslist, pkg);
+  perf_phase_stop(phase);
 
   if (oldversionstatus == PKG_STAT_HALFINSTALLED ||
       oldversionstatus == PKG_STAT_UNPACKED) {
@@ -1012,7 +1026,7 @@ void process_archive(const char *filename) {
   /* Now we delete all the files that were in the old version of
    * the package only, except (old or new) conffiles, which we leave
    * alone. */
-  reversefilelist_init(&rlistit,pkg->clientdata->files);
+  reversefilelist_init(&rlistit, pkg);
   while ((namenode= reversefilelist_next(&rlistit))) {
     struct filenamenode *usenode;
 
@@ -1262,6 +1276,10 @@ void process_archive(const char *filename) {
    * never even rearranged. Phew! */
   pkg->installed.arbs= pkg->available.arbs;
 
+  /* The package does not get noted until its status changes below, but
+   * any checkpoint meanwhile has to see the new data. */
+  pkg_invalidate_stanza(pkg);
+
   /* In case this was an architecture cross-grade, the in-core pkgset might
    * be in an inconsistent state, with two pkginfo entries having the same
    * architecture, so let's fix that. Note that this does not lose data,
@@ -75,6 +75,7 @@
 #include <limits.h>
 #include <time.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <dirent.h>
 #include <ctype.h>
 #include <string.h>
@@ -142,6 +143,10 @@
 #define HAVE_IOPRIO_SET
 #endif
 
+#if defined(SYS_pidfd_open) && defined(linux)
+#define HAVE_PIDFD_OPEN
+#endif
+
 #define IOPRIO_CLASS_SHIFT 13
 #define IOPRIO_PRIO_VALUE(class, prio) (((class) << IOPRIO_CLASS_SHIFT) | (prio))
 #define IO_SCHED_PRIO_MIN 0
@@ -528,6 +533,18 @@ pid_list_push(struct pid_list **list, pid_t pid)
 	*list = p;
 }
 
+static bool
+pid_list_has(struct pid_list *list, pid_t pid)
+{
+	struct pid_list *p;
+
+	for (p = list; p != NULL; p = p->next)
+		if (p->pid == pid)
+			return true;
+
+	return false;
+}
+
 static void
 pid_list_free(struct pid_list **list)
 {
@@ -1216,36 +1233,96 @@ setup_options(void)
 }
 
 #if defined(OSLinux)
-static const char *
-proc_status_field(pid_t pid, const char *field)
+/*
+ * The contents of the last /proc/<pid>/status file read, with its lines
+ * NUL-terminated, so that all the checks on a pid share a single read.
+ */
+static pid_t proc_status_pid = -1;
+static char *proc_status_buf = NULL;
+static size_t proc_status_size = 0;
+static size_t proc_status_len = 0;
+
+static void
+proc_status_forget(void)
 {
-	static char *line = NULL;
-	static size_t line_size = 0;
+	proc_status_pid = -1;
+}
 
-	FILE *fp;
+static bool
+proc_status_load(pid_t pid)
+{
 	char filename[32];
-	char *value = NULL;
-	ssize_t line_len;
-	size_t field_len = strlen(field);
+	ssize_t nread;
+	size_t i;
+	int fd;
+
+	if (proc_status_pid == pid)
+		return proc_status_len > 0;
+
+	proc_status_pid = pid;
+	proc_status_len = 0;
 
 	sprintf(filename, "/proc/%d/status", pid);
-	fp = fopen(filename, "r");
-	if (!fp)
-		return NULL;
-	while ((line_len = getline(&line, &line_size, fp)) >= 0) {
-		if (strncasecmp(line, field, field_len) == 0) {
-			line[line_len - 1] = '\0';
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return false;
 
-			value = line + field_len;
-			while (isspace(*value))
-				value++;
+	for (;;) {
+		if (proc_status_size - proc_status_len < 1024) {
+			proc_status_size = proc_status_size * 2 + 4096;
+			proc_status_buf = realloc(proc_status_buf,
+			                          proc_status_size);
+			if (proc_status_buf == NULL)
+				fatal("realloc(%zu) failed", proc_status_size);
+		}
 
+		nread = read(fd, proc_status_buf + proc_status_len,
+		             proc_status_size - proc_status_len - 1);
+		if (nread < 0 && errno == EINTR)
+			continue;
+		if (nread < 0) {
+			proc_status_len = 0;
 			break;
 		}
+		if (nread == 0)
+			break;
+		proc_status_len += nread;
+	}
+	close(fd);
+
+	for (i = 0; i < proc_status_len; i++)
+		if (proc_status_buf[i] == '\n')
+			proc_status_buf[i] = '\0';
+	if (proc_status_len > 0)
+		proc_status_buf[proc_status_len] = '\0';
+
+	return proc_status_len > 0;
+}
+
+static const char *
+proc_status_field(pid_t pid, const char *field)
+{
+	const char *line, *end;
+	size_t field_len = strlen(field);
+
+	if (!proc_status_load(pid))
+		return NULL;
+
+	end = proc_status_buf + proc_status_len;
+	for (line = proc_status_buf; line < end; line += strlen(line) + 1) {
+		const char *value;
+
+		if (strncasecmp(line, field, field_len) != 0)
+			continue;
+
+		value = line + field_len;
+		while (isspace(*value))
+			value++;
+
+		return value;
 	}
-	fclose(fp);
 
-	return value;
+	return NULL;
 }
 #endif
 
@@ -1713,14 +1790,20 @@ pid_is_running(pid_t pid)
 static enum status_code
 pid_check(pid_t pid)
 {
-	if (execname && !pid_is_exec(pid, &exec_stat))
-		return STATUS_DEAD;
-	if (match_ppid > 0 && !pid_is_child(pid, match_ppid))
-		return STATUS_DEAD;
+#if defined(OSLinux)
+	proc_status_forget();
+#endif
+
+	/* Check the cheapest conditions first, as most processes will not
+	 * match, and resolving the executable is the most expensive one. */
 	if (userspec && !pid_is_user(pid, user_id))
 		return STATUS_DEAD;
 	if (cmdname && !pid_is_cmd(pid, cmdname))
 		return STATUS_DEAD;
+	if (match_ppid > 0 && !pid_is_child(pid, match_ppid))
+		return STATUS_DEAD;
+	if (execname && !pid_is_exec(pid, &exec_stat))
+		return STATUS_DEAD;
 	if (action != ACTION_STOP && !pid_is_running(pid))
 		return STATUS_DEAD;
 
@@ -1992,12 +2075,29 @@ do_start(int argc, char **argv)
 	fatal("unable to start %s", startas);
 }
 
+/*
+ * Recheck only the processes found by the last search, instead of looking
+ * through all of them again. Any process not matching then cannot be one
+ * we have signaled and are waiting for.
+ */
 static void
-do_stop(int sig_num, int *n_killed, int *n_notkilled)
+do_refindprocs(void)
 {
-	struct pid_list *p;
+	struct pid_list *p, *prev_found;
 
-	do_findprocs();
+	prev_found = found;
+	found = NULL;
+
+	for (p = prev_found; p; p = p->next)
+		pid_check(p->pid);
+
+	pid_list_free(&prev_found);
+}
+
+static void
+do_stop_found(int sig_num, int *n_killed, int *n_notkilled)
+{
+	struct pid_list *p;
 
 	*n_killed = 0;
 	*n_notkilled = 0;
@@ -2025,6 +2125,13 @@ do_stop(int sig_num, int *n_killed, int *n_notkilled)
 	}
 }
 
+static void
+do_stop(int sig_num, int *n_killed, int *n_notkilled)
+{
+	do_findprocs();
+	do_stop_found(sig_num, n_killed, n_notkilled);
+}
+
 static void
 do_stop_summary(int retry_nr)
 {
@@ -2068,12 +2175,118 @@ set_what_stop(const char *str)
  * increases by 1 for each poll to a maximum of 10; so we use up to between
  * 30% and 10% of the machine's resources (assuming a few reasonable things
  * about system performance).
+ *
+ * Only the first poll looks through all processes, the following ones
+ * just recheck the processes it found. Where pidfds are available, we
+ * instead wait on them for the found processes to exit, and only fall
+ * back to polling when they are not.
+ */
+#ifdef HAVE_PIDFD_OPEN
+static bool pidfd_unsupported = false;
+
+/*
+ * Wait for the found processes to exit, by polling on pidfds referring to
+ * them, so that we wake up as soon as the last one is gone, instead of
+ * checking for them at intervals.
+ *
+ * Returns 1 if they have all exited, 0 if the timeout expired, or -1 if
+ * pidfds cannot be used and the caller needs to poll for them instead.
  */
+static int
+do_stop_wait_pidfd(struct timespec *stopat, int *n_killed)
+{
+	struct timespec now, interval;
+	struct pollfd *pfd;
+	struct pid_list *p;
+	pid_t *pfd_pid;
+	int npfd, nalive, i, fd, rc;
+
+	npfd = 0;
+	for (p = found; p; p = p->next)
+		npfd++;
+
+	pfd = xmalloc(sizeof(*pfd) * npfd);
+	pfd_pid = xmalloc(sizeof(*pfd_pid) * npfd);
+
+	npfd = 0;
+	for (p = found; p; p = p->next) {
+		fd = syscall(SYS_pidfd_open, p->pid, 0);
+		if (fd < 0 && errno == ESRCH)
+			continue;
+		if (fd < 0) {
+			if (errno == ENOSYS)
+				pidfd_unsupported = true;
+			for (i = 0; i < npfd; i++)
+				close(pfd[i].fd);
+			free(pfd);
+			free(pfd_pid);
+			return -1;
+		}
+
+		pfd[npfd].fd = fd;
+		pfd[npfd].events = POLLIN;
+		pfd[npfd].revents = 0;
+		pfd_pid[npfd] = p->pid;
+		npfd++;
+	}
+
+	/* The pids might have been reused before we got hold of them, so
+	 * only keep waiting on the ones that still match. */
+	do_refindprocs();
+
+	nalive = 0;
+	for (i = 0; i < npfd; i++) {
+		if (pid_list_has(found, pfd_pid[i])) {
+			nalive++;
+		} else {
+			close(pfd[i].fd);
+			pfd[i].fd = -1;
+		}
+	}
+
+	while (nalive > 0) {
+		timespec_gettime(&now);
+		if (!timespec_cmp(&now, stopat, <))
+			break;
+		timespec_sub(stopat, &now, &interval);
+
+		rc = ppoll(pfd, npfd, &interval, NULL);
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc < 0)
+			fatal("ppoll() failed for pause");
+
+		for (i = 0; i < npfd; i++) {
+			if (pfd[i].fd < 0 || pfd[i].revents == 0)
+				continue;
+
+			close(pfd[i].fd);
+			pfd[i].fd = -1;
+			nalive--;
+		}
+	}
+
+	for (i = 0; i < npfd; i++)
+		if (pfd[i].fd >= 0)
+			close(pfd[i].fd);
+	free(pfd);
+	free(pfd_pid);
+
+	*n_killed = nalive;
+
+	return nalive == 0;
+}
+#endif
+
 static bool
 do_stop_timeout(int timeout, int *n_killed, int *n_notkilled)
 {
 	struct timespec stopat, before, after, interval, maxinterval;
 	int rc, ratio;
+	bool rescan = true;
+#ifdef HAVE_PIDFD_OPEN
+	bool try_pidfd = !pidfd_unsupported;
+#endif
 
 	timespec_gettime(&stopat);
 	stopat.tv_sec += timeout;
@@ -2083,10 +2296,25 @@ do_stop_timeout(int timeout, int *n_killed, int *n_notkilled)
 		if (timespec_cmp(&before, &stopat, >))
 			return false;
 
-		do_stop(0, n_killed, n_notkilled);
+		if (rescan)
+			do_findprocs();
+		else
+			do_refindprocs();
+		rescan = false;
+
+		do_stop_found(0, n_killed, n_notkilled);
 		if (!*n_killed)
 			return true;
 
+#ifdef HAVE_PIDFD_OPEN
+		if (try_pidfd) {
+			rc = do_stop_wait_pidfd(&stopat, n_killed);
+			if (rc >= 0)
+				return rc > 0;
+			try_pidfd = false;
+		}
+#endif
+
 		timespec_gettime(&after);
 
 		if (!timespec_cmp(&after, &stopat, <))
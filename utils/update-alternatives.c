@@ -25,10 +25,12 @@
 #include <compat.h>
 
 #include <sys/types.h>
+#include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -53,6 +55,9 @@
 static const char *altdir = SYSCONFDIR "/alternatives";
 static const char *admdir;
 
+static int altdir_fd = -1;
+static int admdir_fd = -1;
+
 static const char *prog_path = "update-alternatives";
 
 /* Action to perform */
@@ -467,6 +472,81 @@ checked_rm_args(const char *fmt, ...)
 	free(path);
 }
 
+/*
+ * The alternatives and administrative directories get opened once, so that
+ * the files within them can be handled relative to the directory fds.
+ */
+
+static int
+altdir_get_fd(void)
+{
+	if (altdir_fd < 0) {
+		altdir_fd = open(altdir, O_RDONLY | O_DIRECTORY);
+		if (altdir_fd < 0)
+			syserr(_("unable to open directory '%s'"), altdir);
+	}
+
+	return altdir_fd;
+}
+
+static int
+admdir_get_fd(void)
+{
+	if (admdir_fd < 0) {
+		admdir_fd = open(admdir, O_RDONLY | O_DIRECTORY);
+		if (admdir_fd < 0 && errno != ENOENT)
+			syserr(_("unable to open directory '%s'"), admdir);
+	}
+
+	return admdir_fd;
+}
+
+/*
+ * Serialize the database read-modify-write cycle against other instances,
+ * which might be run concurrently from maintainer scripts.
+ */
+static void
+admdir_lock(void)
+{
+	int fd = admdir_get_fd();
+
+	/* Without the directory there is nothing to update concurrently. */
+	if (fd < 0)
+		return;
+
+	while (flock(fd, LOCK_EX) < 0) {
+		if (errno != EINTR)
+			syserr(_("unable to lock directory '%s'"), admdir);
+	}
+}
+
+static void
+checked_symlinkat(const char *filename, int dirfd, const char *dir,
+                  const char *linkname)
+{
+	if (symlinkat(filename, dirfd, linkname))
+		syserr(_("error creating symbolic link '%.255s/%.255s'"),
+		       dir, linkname);
+}
+
+static void
+checked_mvat(int dirfd, const char *dir, const char *src, const char *dst)
+{
+	if (renameat(dirfd, src, dirfd, dst))
+		syserr(_("unable to install '%.250s/%.250s' as '%.250s/%.250s'"),
+		       dir, src, dir, dst);
+}
+
+static void
+checked_rmat(int dirfd, const char *dir, const char *f)
+{
+	if (!unlinkat(dirfd, f, 0))
+		return;
+
+	if (errno != ENOENT)
+		syserr(_("unable to remove '%s/%s'"), dir, f);
+}
+
 /*
  * OBJECTS
  */
@@ -599,6 +679,10 @@ struct commit_operation {
 		OPCODE_MV,
 	} opcode;
 
+	/* The directory the arguments are relative to, or AT_FDCWD. */
+	int dirfd;
+	const char *dir;
+
 	char *arg_a;
 	char *arg_b;
 };
@@ -1233,6 +1317,7 @@ alternative_load(struct alternative *a, enum altdb_flags flags)
 	struct altdb_context ctx;
 	struct stat st;
 	char *status;
+	int dirfd, fd;
 
 	/* Initialize parse context */
 	if (setjmp(ctx.on_error)) {
@@ -1251,13 +1336,19 @@ alternative_load(struct alternative *a, enum altdb_flags flags)
 	ctx.filename = xasprintf("%s/%s", admdir, a->master_name);
 
 	/* Open the alternative file. */
-	ctx.fh = fopen(ctx.filename, "r");
-	if (ctx.fh == NULL) {
+	dirfd = admdir_get_fd();
+	if (dirfd < 0)
+		return false;
+	fd = openat(dirfd, a->master_name, O_RDONLY);
+	if (fd < 0) {
 		if (errno == ENOENT)
 			return false;
 
 		syserr(_("unable to open file '%s'"), ctx.filename);
 	}
+	ctx.fh = fdopen(fd, "r");
+	if (ctx.fh == NULL)
+		syserr(_("unable to open file '%s'"), ctx.filename);
 
 	/* Verify the alternative is not empty. */
 	if (fstat(fileno(ctx.fh), &st) == -1)
@@ -1296,12 +1387,13 @@ alternative_load(struct alternative *a, enum altdb_flags flags)
 }
 
 static void
-alternative_save(struct alternative *a)
+alternative_save_tmp(struct alternative *a)
 {
 	struct altdb_context ctx;
 	struct slave_link *sl, *sl_prev;
 	struct fileset *fs;
-	char *filenew, *file;
+	char *filenew;
+	int fd;
 
 	/* Cleanup unused slaves before writing admin file. */
 	sl_prev = NULL;
@@ -1337,11 +1429,13 @@ alternative_save(struct alternative *a)
 	alternative_sort_choices(a);
 
 	/* Write admin file. */
-	file = xasprintf("%s/%s", admdir, a->master_name);
-	filenew = xasprintf("%s" ALT_TMP_EXT, file);
+	filenew = xasprintf("%s" ALT_TMP_EXT, a->master_name);
 
-	ctx.filename = filenew;
-	ctx.fh = fopen(ctx.filename, "w");
+	ctx.filename = xasprintf("%s/%s", admdir, filenew);
+	fd = openat(admdir_get_fd(), filenew, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0)
+		syserr(_("unable to create file '%s'"), ctx.filename);
+	ctx.fh = fdopen(fd, "w");
 	if (ctx.fh == NULL)
 		syserr(_("unable to create file '%s'"), ctx.filename);
 
@@ -1380,11 +1474,26 @@ alternative_save(struct alternative *a)
 	if (fclose(ctx.fh))
 		syserr(_("unable to close file '%s'"), ctx.filename);
 
-	/* Put in place atomically. */
-	checked_mv(filenew, file);
+	free(ctx.filename);
+	free(filenew);
+}
+
+static void
+alternative_save_commit(struct alternative *a)
+{
+	char *filenew;
 
+	/* Put in place atomically. */
+	filenew = xasprintf("%s" ALT_TMP_EXT, a->master_name);
+	checked_mvat(admdir_get_fd(), admdir, filenew, a->master_name);
 	free(filenew);
-	free(file);
+}
+
+static void
+alternative_save(struct alternative *a)
+{
+	alternative_save_tmp(a);
+	alternative_save_commit(a);
 }
 
 static const char *
@@ -1632,13 +1741,16 @@ alternative_config(struct alternative *a, const char *current_choice)
 }
 
 static void
-alternative_add_commit_op(struct alternative *a, enum opcode opcode,
-                          const char *arg_a, const char *arg_b)
+alternative_add_commit_op_at(struct alternative *a, enum opcode opcode,
+                             int dirfd, const char *dir,
+                             const char *arg_a, const char *arg_b)
 {
 	struct commit_operation *op, *cur;
 
 	op = xmalloc(sizeof(*op));
 	op->opcode = opcode;
+	op->dirfd = dirfd;
+	op->dir = dir;
 	op->arg_a = xstrdup(arg_a);
 	op->arg_b = xstrdup(arg_b);
 	op->next = NULL;
@@ -1653,6 +1765,13 @@ alternative_add_commit_op(struct alternative *a, enum opcode opcode,
 		a->commit_ops = op;
 }
 
+static void
+alternative_add_commit_op(struct alternative *a, enum opcode opcode,
+                          const char *arg_a, const char *arg_b)
+{
+	alternative_add_commit_op_at(a, opcode, AT_FDCWD, NULL, arg_a, arg_b);
+}
+
 static void
 alternative_commit(struct alternative *a)
 {
@@ -1663,10 +1782,17 @@ alternative_commit(struct alternative *a)
 		case OPCODE_NOP:
 			break;
 		case OPCODE_RM:
-			checked_rm(op->arg_a);
+			if (op->dirfd == AT_FDCWD)
+				checked_rm(op->arg_a);
+			else
+				checked_rmat(op->dirfd, op->dir, op->arg_a);
 			break;
 		case OPCODE_MV:
-			checked_mv(op->arg_a, op->arg_b);
+			if (op->dirfd == AT_FDCWD)
+				checked_mv(op->arg_a, op->arg_b);
+			else
+				checked_mvat(op->dirfd, op->dir,
+				             op->arg_a, op->arg_b);
 			break;
 		}
 	}
@@ -1674,6 +1800,25 @@ alternative_commit(struct alternative *a)
 	alternative_commit_operations_free(a);
 }
 
+static void
+alternative_commit_discard(struct alternative *a)
+{
+	struct commit_operation *op;
+
+	/* Remove the temporary links prepared for the pending moves. */
+	for (op = a->commit_ops; op; op = op->next) {
+		if (op->opcode != OPCODE_MV)
+			continue;
+
+		if (op->dirfd == AT_FDCWD)
+			checked_rm(op->arg_a);
+		else
+			checked_rmat(op->dirfd, op->dir, op->arg_a);
+	}
+
+	alternative_commit_operations_free(a);
+}
+
 enum alternative_path_status {
 	ALT_PATH_SYMLINK,
 	ALT_PATH_MISSING,
@@ -1742,15 +1887,18 @@ alternative_prepare_install_single(struct alternative *a, const char *name,
                                    const char *linkname, const char *file)
 {
 	char *fntmp, *fn;
+	int dirfd;
 
 	/* Create link in /etc/alternatives. */
-	fntmp = xasprintf("%s/%s" ALT_TMP_EXT, altdir, name);
-	fn = xasprintf("%s/%s", altdir, name);
-	checked_rm(fntmp);
-	checked_symlink(file, fntmp);
-	alternative_add_commit_op(a, OPCODE_MV, fntmp, fn);
+	dirfd = altdir_get_fd();
+	fntmp = xasprintf("%s" ALT_TMP_EXT, name);
+	checked_rmat(dirfd, altdir, fntmp);
+	checked_symlinkat(file, dirfd, altdir, fntmp);
+	alternative_add_commit_op_at(a, OPCODE_MV, dirfd, altdir, fntmp, name);
 	free(fntmp);
 
+	fn = xasprintf("%s/%s", altdir, name);
+
 	if (alternative_path_needs_update(linkname, fn)) {
 		/* Create alternative link. */
 		fntmp = xasprintf("%s" ALT_TMP_EXT, linkname);
@@ -2045,6 +2193,33 @@ alternative_map_load_tree(struct alternative_map *alt_map_links,
 	altdb_free_namelist(table, count);
 }
 
+/*
+ * Alternatives with their database writes and link changes deferred, when
+ * updating them in bulk.
+ */
+static struct alternative_map *alt_map_bulk = NULL;
+
+static void
+alternative_map_commit(struct alternative_map *am)
+{
+	struct alternative_map *cur;
+
+	/* Write all the database files before putting any of them in place,
+	 * and then replace all symlinks in one pass. */
+	for (cur = am; cur && cur->item; cur = cur->next) {
+		if (cur->item->modified) {
+			debug("%s is modified and will be saved",
+			      cur->item->master_name);
+			alternative_save_tmp(cur->item);
+		}
+	}
+	for (cur = am; cur && cur->item; cur = cur->next)
+		if (cur->item->modified)
+			alternative_save_commit(cur->item);
+	for (cur = am; cur && cur->item; cur = cur->next)
+		alternative_commit(cur->item);
+}
+
 static void
 alternative_map_free(struct alternative_map *am)
 {
@@ -2272,6 +2447,15 @@ alternative_update(struct alternative *a,
 			alternative_prepare_install(a, current_choice);
 	}
 
+	/* Defer the administrative file and symlinks in bulk mode. */
+	if (alt_map_bulk) {
+		if (alternative_map_find(alt_map_bulk, a->master_name) == NULL) {
+			alternative_ref(a);
+			alternative_map_add(alt_map_bulk, a->master_name, a);
+		}
+		return;
+	}
+
 	/* Save administrative file if needed. */
 	if (a->modified) {
 		debug("%s is modified and will be saved", a->master_name);
@@ -2352,6 +2536,11 @@ alternative_set_selection(struct alternative_map *all, const char *name,
 		if (new_choice) {
 			const char *current_choice;
 
+			/* The links on disk have not been touched yet, so
+			 * prepare the changes again from scratch. */
+			if (a->commit_ops)
+				alternative_commit_discard(a);
+
 			current_choice = alternative_get_current(a);
 			alternative_select_mode(a, current_choice);
 
@@ -2370,6 +2559,8 @@ alternative_set_selections(FILE *input, const char *desc)
 	alt_map_obj = alternative_map_new(NULL, NULL);
 	alternative_map_load_names(alt_map_obj);
 
+	alt_map_bulk = alternative_map_new(NULL, NULL);
+
 	for (;;) {
 		char line[1024], *res, *name, *status, *choice;
 		size_t len, i;
@@ -2430,6 +2621,10 @@ alternative_set_selections(FILE *input, const char *desc)
 		alternative_set_selection(alt_map_obj, name, status, choice);
 	}
 
+	alternative_map_commit(alt_map_bulk);
+	alternative_map_free(alt_map_bulk);
+	alt_map_bulk = NULL;
+
 	alternative_map_free(alt_map_obj);
 }
 
@@ -2741,6 +2936,9 @@ main(int argc, char **argv)
 	if (strcmp(action, "install") == 0)
 		alternative_check_install_args(inst_alt, fileset);
 
+	if (modifies_sys)
+		admdir_lock();
+
 	if (strcmp(action, "display") == 0 ||
 	    strcmp(action, "query") == 0 ||
 	    strcmp(action, "list") == 0 ||